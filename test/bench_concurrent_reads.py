@@ -0,0 +1,64 @@
+"""Throughput of window reads from one concurrent_image_resource, against
+the number of threads reading it. Not part of the test suite; run as
+
+    python bench_concurrent_reads.py [--size 4096] [--window 256] [--seconds 2]
+"""
+import argparse
+import os
+import tempfile
+import threading
+import time
+
+import numpy as np
+
+from vxl import vil
+
+
+def throughput(resource, n_threads, window, seconds):
+  ni, nj = resource.ni(), resource.nj()
+  counts = [0] * n_threads
+  stop = threading.Event()
+
+  def read(index):
+    rng = np.random.RandomState(index)
+    while not stop.is_set():
+      i0, j0 = rng.randint(0, ni - window + 1), rng.randint(0, nj - window + 1)
+      resource.get_copy_view_byte(i0, window, j0, window)
+      counts[index] += 1
+
+  threads = [threading.Thread(target=read, args=(i,)) for i in range(n_threads)]
+  start = time.perf_counter()
+  for thread in threads:
+    thread.start()
+  time.sleep(seconds)
+  stop.set()
+  for thread in threads:
+    thread.join()
+  return sum(counts) / (time.perf_counter() - start)
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+  parser.add_argument("--size", type=int, default=4096, help="width and height of the test image")
+  parser.add_argument("--window", type=int, default=256, help="width and height of each window read")
+  parser.add_argument("--seconds", type=float, default=2.0, help="time spent at each thread count")
+  parser.add_argument("--max-threads", type=int, default=os.cpu_count() or 1)
+  args = parser.parse_args()
+
+  with tempfile.TemporaryDirectory() as tempdir:
+    filename = os.path.join(tempdir, "bench.tif")
+    a = np.random.RandomState(0).randint(0, 256, size=(args.size, args.size, 3)).astype(np.uint8)
+    vil.save_image_view(vil.image_view_byte(a), filename)
+
+    resource = vil.concurrent_image_resource(filename, max_handles=args.max_threads)
+    n_threads, base = 1, None
+    while n_threads <= args.max_threads:
+      rate = throughput(resource, n_threads, args.window, args.seconds)
+      base = base or rate
+      print("{:3d} threads: {:10.1f} windows/s  ({:.2f}x)".format(n_threads, rate, rate / base))
+      n_threads *= 2
+    print("open handles:", resource.n_open_handles)
+
+
+if __name__ == "__main__":
+  main()
@@ -0,0 +1,1158 @@
+import multiprocessing
+import os
+import pickle
+import tempfile
+import threading
+import unittest
+
+try:
+  import numpy as np
+except:
+  np = None
+
+from vxl import vil
+
+
+class VilImageViewBase(object):
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_construct_numpy(self):
+    a = np.arange(24, dtype=self.dtype).reshape(4, 3, 2)
+    img = self.cls(a)
+
+    self.assertEqual(img.shape, (4, 3, 2))
+    self.assertEqual(len(img), 24)
+    self.assertEqual(img[(1, 2, 1)], a[1, 2, 1])
+    self.assertEqual(img[(3, 0, 0)], a[3, 0, 0])
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_construct_other_dtype(self):
+    other = np.float32 if self.dtype == np.float64 else np.float64
+    a = np.arange(24, dtype=other).reshape(4, 3, 2)
+    # a converted view would not share the array's memory
+    with self.assertRaises(TypeError):
+      self.cls(a)
+
+    img = self.cls(a, copy=True)
+    np.testing.assert_array_equal(np.asarray(img), a.astype(self.dtype))
+    np.asarray(img)[0, 0, 0] = 5
+    self.assertEqual(a[0, 0, 0], 0)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_negative_index(self):
+    a = np.arange(24, dtype=self.dtype).reshape(4, 3, 2)
+    img = self.cls(a)
+
+    self.assertEqual(img[-1, -1, -1], a[-1, -1, -1])
+    self.assertEqual(img[-4, 0, -2], a[0, 0, 0])
+    with self.assertRaises(IndexError):
+      img[4, 0, 0]
+    with self.assertRaises(IndexError):
+      img[0, -4, 0]
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_slice_shares_memory(self):
+    a = np.arange(60, dtype=self.dtype).reshape(6, 10)
+    img = self.cls(a)
+
+    for key in [(slice(1, 4), slice(2, 9, 3)), (slice(None, None, -2),), (2, slice(None))]:
+      view = img[key]
+      expected = a[key].reshape(view.shape[:2])
+      np.testing.assert_array_equal(np.array(view).reshape(view.shape[:2]), expected)
+
+    chip = img[1:3, 4:6]
+    a[2, 5] = 1
+    self.assertEqual(chip[1, 1], 1)
+    # a single pixel of a one plane view, and the plane index of a multi plane view
+    self.assertEqual(img[2, 5], 1)
+    planes = self.cls(np.arange(24, dtype=self.dtype).reshape(4, 3, 2))[:, :, 1]
+    self.assertEqual(planes.shape, (4, 3, 1))
+
+    crop = img.crop(4, 2, 1, 2)
+    self.assertEqual(crop.shape, (2, 2, 1))
+    self.assertEqual(crop[1, 1], 1)
+    with self.assertRaises(IndexError):
+      img.crop(9, 2, 0, 1)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_sample_and_scatter(self):
+    a = np.arange(60, dtype=self.dtype).reshape(6, 10)
+    img = self.cls(a)
+    points = np.array([[3, 2], [9, 5], [-1, 0], [2.6, 1.4], [10, 0]])
+
+    values = img.sample(points, fill=-1)
+    np.testing.assert_array_equal(values, [23, 59, -1, 13, -1])
+    values = img.sample(points[:2], interp="bilinear")
+    np.testing.assert_array_equal(values, [23, 59])
+    values = img.sample(np.array([[2.5, 1.5]]), interp="bicubic")
+    self.assertAlmostEqual(values[0], 17.5)
+
+    img.scatter(np.array([[0, 0], [1, 0], [1, 0], [20, 20]]), np.array([5, 6, 7, 8]))
+    np.testing.assert_array_equal(a[0, :3], [5, 7, 2])
+    img.scatter(np.array([[0, 0], [0, 0]]), np.array([1, 2]), mode="add")
+    self.assertEqual(a[0, 0], 8)
+
+    with self.assertRaises(ValueError):
+      img.sample(np.zeros((3, 3)))
+    with self.assertRaises(ValueError):
+      img.sample(points, interp="lanczos")
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_construct_numpy_shares_memory(self):
+    a = np.zeros((5, 4), dtype=self.dtype)
+    img = self.cls(a)
+    a[2, 3] = 7
+
+    self.assertEqual(img[(2, 3, 0)], 7)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_construct_numpy_keeps_array_alive(self):
+    a = np.full((5, 4), 3, dtype=self.dtype)
+    img = self.cls(a)
+    del a
+
+    self.assertEqual(img[(4, 3, 0)], 3)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_construct_numpy_copy(self):
+    a = np.zeros((5, 4), dtype=self.dtype)
+    img = self.cls(a, copy=True)
+    a[2, 3] = 7
+
+    self.assertEqual(img[(2, 3, 0)], 0)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_construct_numpy_strided(self):
+    a = np.arange(60, dtype=self.dtype).reshape(6, 10)
+    b = a[::2, ::-3]
+    img = self.cls(b)
+
+    self.assertEqual(img.shape, (3, 4, 1))
+    for r in range(3):
+      for c in range(4):
+        self.assertEqual(img[(r, c, 0)], b[r, c])
+    np.testing.assert_array_equal(np.array(img), b)
+
+
+class VilStretch(unittest.TestCase):
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_stretch_to_byte(self):
+    a = np.array([[0, 10, 20, 30, 40, 50, 60, 70, 80, 90]], dtype=np.float32)
+    img = vil.image_view_float(a)
+    out = vil.stretch_image(img, 10, 61, "byte")
+
+    expected = np.clip(5 * (a - 10), 0, 255).astype(np.uint8)
+    np.testing.assert_array_equal(np.array(out), expected)
+    # input is not modified
+    np.testing.assert_array_equal(np.array(img), a)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_stretch_to_short_saturates(self):
+    a = np.array([[0, 1000, 5000, 9000]], dtype=np.uint16)
+    out = vil.stretch_image(vil.image_view_uint16(a), 1000, 5000, "short")
+
+    np.testing.assert_array_equal(np.array(out), [[0, 0, 65535, 65535]])
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_stretch_to_float(self):
+    a = np.arange(24, dtype=np.int32).reshape(4, 3, 2)
+    out = vil.stretch_image(vil.image_view_int(a), 0, 23, "float")
+
+    np.testing.assert_allclose(np.array(out), a / 23.0, rtol=1e-6)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_stretch_per_plane(self):
+    a = np.array([[[10, 100], [20, 200]]], dtype=np.float32)
+    out = vil.stretch_image(vil.image_view_float(a), [10, 100], [20, 200], "float")
+
+    np.testing.assert_allclose(np.array(out), [[[0, 0], [1, 1]]])
+    with self.assertRaises(ValueError):
+      vil.stretch_image(vil.image_view_float(a), [10, 100], [20, 50], "float")
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_percentile_limits(self):
+    a = np.random.RandomState(3).randint(0, 256, size=(200, 300, 2)).astype(np.uint8)
+    min_limits, max_limits = vil.percentile_limits(vil.image_view_byte(a), 5, 95)
+    for p in range(2):
+      lo, hi = np.percentile(a[:, :, p], [5, 95])
+      self.assertLessEqual(abs(min_limits[p] - lo), 1)
+      self.assertLessEqual(abs(max_limits[p] - hi), 1)
+
+    f = np.random.RandomState(4).normal(size=(400, 300)).astype(np.float32)
+    with tempfile.TemporaryDirectory() as tempdir:
+      filename = os.path.join(tempdir, "percentile.tif")
+      vil.save_image_view(vil.image_view_float(f), filename)
+      resource = vil.load_image_resource(filename)
+
+      (lo,), (hi,) = vil.percentile_limits(resource, 2, 98, sample_step=2)
+      expected = np.percentile(f[::2, ::2], [2, 98])
+      self.assertAlmostEqual(lo, expected[0], delta=0.01)
+      self.assertAlmostEqual(hi, expected[1], delta=0.01)
+
+      out = vil.auto_stretch(resource, "byte")
+      self.assertIsInstance(out, vil.image_view_byte)
+      self.assertEqual(np.array(out).shape[:2], f.shape)
+
+      limits = vil.percentile_limits(resource, 2, 98)
+      expected = np.array(vil.stretch_image(vil.image_view_float(f), limits[0], limits[1], "byte"))
+      np.testing.assert_allclose(np.array(out).astype(int), expected, atol=1)
+
+      # other pixel types, stretched tile by tile into a file
+      rgb = np.random.RandomState(5).randint(0, 256, size=(120, 90, 3)).astype(np.uint8)
+      for name, a in (("rgb", vil.convert(vil.image_view_byte(rgb), "rgb_byte")),
+                      ("int16", vil.image_view_int16((f * 1000).astype(np.int16))),
+                      ("double", vil.image_view_double(f.astype(np.float64)))):
+        vil.save_image_view(a, os.path.join(tempdir, name + ".tif"))
+        resource = vil.load_image_resource(os.path.join(tempdir, name + ".tif"))
+        stretched = vil.auto_stretch(resource, "short", filename=os.path.join(tempdir, name + "_stretched.tif"))
+        self.assertEqual((stretched.ni(), stretched.nj()), (resource.ni(), resource.nj()))
+        self.assertEqual(stretched.pixel_format(), vil.VIL_PIXEL_FORMAT_UINT_16)
+        out = np.array(vil.load(os.path.join(tempdir, name + "_stretched.tif")))
+        self.assertEqual(out.min(), 0)
+        self.assertEqual(out.max(), 65535)
+
+
+class VilParallel(unittest.TestCase):
+  def tearDown(self):
+    vil.set_num_threads(0)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_sum_independent_of_threads(self):
+    a = np.random.RandomState(0).rand(1000, 700).astype(np.float32)
+    img = vil.image_view_float(a)
+
+    vil.set_num_threads(1)
+    self.assertEqual(vil.get_num_threads(), 1)
+    serial = vil.img_sum(img)
+    vil.set_num_threads(4)
+    self.assertEqual(vil.get_num_threads(), 4)
+    self.assertEqual(vil.img_sum(img), serial)
+    self.assertAlmostEqual(serial, a.sum(dtype=np.float64), places=2)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_range_and_truncate(self):
+    a = np.arange(-500, 500, dtype=np.int32).reshape(40, 25)
+    img = vil.image_view_int(a)
+    vil.set_num_threads(3)
+
+    self.assertEqual(vil.image_range(img), (-500, 499))
+    vil.truncate_image_range(img, -10, 20)
+    self.assertEqual(vil.image_range(img), (-10, 20))
+
+
+class VilStats(unittest.TestCase):
+  def tearDown(self):
+    vil.set_num_threads(0)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_image_stats(self):
+    a = np.random.RandomState(1).randint(0, 1000, size=(300, 200, 3)).astype(np.uint16)
+    img = vil.image_view_uint16(a)
+
+    stats = vil.image_stats(img)
+    self.assertEqual(len(stats), 3)
+    for p, s in enumerate(stats):
+      plane = a[:, :, p].astype(np.float64)
+      self.assertEqual(s.count, plane.size)
+      self.assertEqual(s.sum, plane.sum())
+      self.assertEqual(s.sum_sq, (plane * plane).sum())
+      self.assertEqual((s.min, s.max), (plane.min(), plane.max()))
+      self.assertAlmostEqual(s.variance, plane.var(), places=6)
+
+    # masked, a single plane and a fixed histogram
+    m = (np.arange(200) % 2).astype(np.uint8)[np.newaxis, :].repeat(300, axis=0)
+    s, = vil.image_stats(img, planes=1, mask=vil.image_view_byte(m), bins=4, range=(0, 1000))
+    plane = a[:, :, 1][m > 0]
+    self.assertEqual(s.count, plane.size)
+    self.assertEqual(s.sum, plane.sum())
+    self.assertEqual(s.histogram, list(np.histogram(plane, bins=4, range=(0, 1000))[0]))
+
+    # independent of the number of threads
+    vil.set_num_threads(1)
+    serial = vil.image_stats(img, bins=16)
+    vil.set_num_threads(4)
+    for s, t in zip(serial, vil.image_stats(img, bins=16)):
+      self.assertEqual((s.sum, s.sum_sq, s.histogram), (t.sum, t.sum_sq, t.histogram))
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_variance_with_large_offset(self):
+    # sum_sq / count - mean**2 would lose most of the digits here
+    a = (1e4 + np.random.RandomState(2).standard_normal((200, 3000))).astype(np.float32)
+    vil.set_num_threads(4)
+    s, = vil.image_stats(vil.image_view_float(a))
+    self.assertAlmostEqual(s.variance, a.astype(np.float64).var(), delta=1e-9)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_nan_skipped(self):
+    a = np.array([[1, np.nan], [3, 5]], dtype=np.float32)
+    s, = vil.image_stats(vil.image_view_float(a), bins=2)
+    self.assertEqual(s.count, 3)
+    self.assertEqual(s.mean, 3)
+    self.assertEqual(s.histogram_range, (1, 5))
+    self.assertEqual(s.histogram, [1, 2])
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_resource_stats(self):
+    a = np.random.RandomState(2).rand(150, 130).astype(np.float32)
+    with tempfile.TemporaryDirectory() as tempdir:
+      filename = os.path.join(tempdir, "stats.tif")
+      vil.save_image_view(vil.image_view_float(a), filename)
+      resource = vil.load_image_resource(filename)
+
+      streamed, = vil.image_stats(resource, bins=10, block_ni=64, block_nj=32)
+      whole, = vil.image_stats(vil.image_view_float(a), bins=10)
+      self.assertEqual(streamed.count, whole.count)
+      self.assertAlmostEqual(streamed.sum, whole.sum, places=6)
+      self.assertEqual((streamed.min, streamed.max), (whole.min, whole.max))
+      self.assertEqual(streamed.histogram, whole.histogram)
+
+
+class VilIntegral(unittest.TestCase):
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_tables(self):
+    a = np.random.RandomState(16).randint(0, 65536, size=(120, 90, 2)).astype(np.uint16)
+    integral = vil.integral_image(vil.image_view_uint16(a), squared=True)
+    self.assertEqual((integral.ni(), integral.nj(), integral.nplanes()), (90, 120, 2))
+    self.assertTrue(integral.squared)
+
+    expected = np.zeros((121, 91, 2), dtype=np.int64)
+    expected[1:, 1:] = a.astype(np.int64).cumsum(0).cumsum(1)
+    self.assertEqual(integral.sums.dtype, np.int64)
+    np.testing.assert_array_equal(integral.sums, expected)
+    squares = a.astype(np.uint64) ** 2
+    np.testing.assert_array_equal(integral.squares[1:, 1:], squares.cumsum(0).cumsum(1))
+
+    plain = vil.integral_image(vil.image_view_float(a[:, :, 0].astype(np.float32)))
+    self.assertFalse(plain.squared)
+    self.assertIsNone(plain.squares)
+    self.assertEqual(plain.sums.shape, (121, 91))
+    self.assertEqual(plain.sums.dtype, np.float64)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_box_queries(self):
+    rng = np.random.RandomState(17)
+    a = rng.rand(200, 150).astype(np.float32) * 100
+    integral = vil.integral_image(vil.image_view_float(a), squared=True)
+
+    i0, j0 = rng.randint(0, 150, 5000), rng.randint(0, 200, 5000)
+    boxes = np.stack([i0, rng.randint(0, 151 - i0), j0, rng.randint(0, 201 - j0)], axis=1)
+    boxes[0] = [10, 0, 10, 5]
+    sums, means, variances = integral.box_sum(boxes), integral.box_mean(boxes), integral.box_variance(boxes)
+    self.assertEqual(sums.shape, (5000,))
+    self.assertEqual(sums[0], 0)
+    self.assertTrue(np.isnan(means[0]) and np.isnan(variances[0]))
+    for k in range(1, 5000, 37):
+      i0, ni, j0, nj = boxes[k]
+      box = a[j0:j0 + nj, i0:i0 + ni].astype(np.float64)
+      self.assertAlmostEqual(sums[k], box.sum(), delta=1e-6 * max(1, box.sum()))
+      if box.size:
+        self.assertAlmostEqual(means[k], box.mean(), delta=1e-6 * max(1, box.mean()))
+        self.assertAlmostEqual(variances[k], box.var(), delta=1e-4 * max(1, box.var()))
+
+    rgb = rng.randint(0, 256, size=(30, 40, 3)).astype(np.uint8)
+    means = vil.integral_image(vil.image_view_byte(rgb)).box_mean([[5, 10, 2, 20], [0, 40, 0, 30]])
+    self.assertEqual(means.shape, (2, 3))
+    np.testing.assert_allclose(means[1], rgb.reshape(-1, 3).mean(axis=0))
+
+    with self.assertRaises(IndexError):
+      integral.box_sum([[140, 20, 0, 5]])
+    with self.assertRaises(ValueError):
+      integral.box_sum([[0, 1, 0]])
+    with self.assertRaises(ValueError):
+      vil.integral_image(vil.image_view_float(a)).box_variance([[0, 1, 0, 1]])
+
+
+class VilFilter(unittest.TestCase):
+  def tearDown(self):
+    vil.set_num_threads(0)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_convolve(self):
+    a = np.random.RandomState(3).rand(70, 600, 2).astype(np.float32)
+    img = vil.image_view_float(a)
+    ki, kj = [1.0, 2.0, 4.0], [0.5, 0.25]
+
+    # reference: edges replicated, kernels flipped, centred on len // 2
+    padded = np.pad(a.astype(np.float64), ((1, 0), (1, 1), (0, 0)), mode="edge")
+    expected = np.zeros(a.shape)
+    for b, wj in enumerate(kj[::-1]):
+      for c, wi in enumerate(ki[::-1]):
+        expected += wj * wi * padded[b:b + 70, c:c + 600]
+
+    vil.set_num_threads(3)
+    out = vil.convolve(img, ki, kj)
+    np.testing.assert_allclose(np.array(out), expected, rtol=1e-5)
+
+    # written into a given view, which may be the image itself
+    vil.convolve(img, ki, kj, out=img)
+    np.testing.assert_allclose(np.array(img), expected, rtol=1e-5)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_blur_and_box(self):
+    a = np.full((40, 30), 100, dtype=np.uint8)
+    a[20, 15] = 200
+    img = vil.image_view_byte(a)
+
+    blurred = vil.gaussian_blur(img, 1.5)
+    self.assertIsInstance(blurred, vil.image_view_byte)
+    b = np.array(blurred)
+    self.assertEqual(b[0, 0], 100)
+    self.assertTrue(100 < b[20, 15] < 200)
+    self.assertAlmostEqual(vil.img_sum(vil.gaussian_blur(img, 1.5, out=vil.image_view_float(40, 30, 1))),
+                           a.sum(dtype=np.float64), places=0)
+
+    boxed = np.array(vil.box_filter(img, 3))
+    self.assertEqual(boxed[19, 14], round(100 + 100 / 9.0))
+    self.assertEqual(boxed[17, 15], 100)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_gradient(self):
+    j, i = np.mgrid[0:20, 0:30]
+    img = vil.image_view_int((3 * i - 2 * j).astype(np.int32))
+
+    for kind in ("central", "sobel"):
+      gi, gj = vil.gradient(img, kind)
+      gi, gj = np.array(gi), np.array(gj)
+      self.assertTrue(np.all(gi[1:-1, 1:-1] == 3))
+      self.assertTrue(np.all(gj[1:-1, 1:-1] == -2))
+      self.assertEqual(gi[5, 0], 1.5)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_other_types(self):
+    j, i = np.mgrid[0:20, 0:30]
+    ramp = (3 * i + 2 * j).astype(np.float64)
+    for img in (vil.image_view_int16(ramp.astype(np.int16)), vil.image_view_double(ramp)):
+      out = vil.box_filter(img, 3)
+      self.assertIsInstance(out, type(img))
+      np.testing.assert_allclose(np.array(out)[1:-1, 1:-1], ramp[1:-1, 1:-1], atol=1e-3)
+
+    # colours are filtered as planes of their components
+    rgb = vil.convert(vil.image_view_double(np.dstack([ramp, 2 * j, 100 + 0 * j])), "rgb_byte")
+    np.testing.assert_array_equal(np.array(vil.convert(vil.box_filter(rgb, 3), "byte"))[1:-1, 1:-1],
+                                  np.array(vil.convert(rgb, "byte"))[1:-1, 1:-1])
+    gi, gj = vil.gradient(rgb, "central")
+    self.assertEqual(gi.nplanes(), 3)
+    np.testing.assert_allclose(np.array(gi)[1:-1, 1:-1], np.broadcast_to([3, 0, 0], (18, 28, 3)))
+
+    # double images are summed in double, so small steps on a large offset survive
+    d = 1e4 + np.random.RandomState(4).rand(20, 30) / 256
+    k = [0.25, 0.5, 0.25]
+    padded = np.pad(d, 1, mode="edge")
+    expected = sum(k[b] * k[c] * padded[b:b + 20, c:c + 30] for b in range(3) for c in range(3))
+    np.testing.assert_allclose(np.array(vil.convolve(vil.image_view_double(d), k)), expected, rtol=1e-12)
+
+    with self.assertRaises(TypeError):
+      vil.convolve(vil.image_view_double(ramp), [1.0], out=vil.image_view_int(30, 20, 1))
+
+
+class VilWarp(unittest.TestCase):
+  def tearDown(self):
+    vil.set_num_threads(0)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_warp_callable(self):
+    j, i = np.mgrid[0:120, 0:160]
+    a = np.stack([0.5 * i + 2 * j, 3 * i - j], axis=-1).astype(np.float32)
+    img = vil.image_view_float(a)
+
+    def mapping(points):
+      return np.stack([0.7 * points[:, 0] + 0.2 * points[:, 1] + 10,
+                       -0.1 * points[:, 0] + 0.9 * points[:, 1] + 5], axis=-1)
+
+    vil.set_num_threads(3)
+    out = np.array(vil.warp(img, (90, 200), mapping, interp="bicubic", fill=-1, tile_size=32))
+    self.assertEqual(out.shape, (90, 200, 2))
+
+    dj, di = np.mgrid[0:90, 0:200]
+    x, y = mapping(np.stack([di.ravel(), dj.ravel()], axis=-1)).T
+    x, y = x.reshape(90, 200), y.reshape(90, 200)
+    inside = (x >= 1) & (x <= 157) & (y >= 1) & (y <= 117)
+    outside = (x < -0.6) | (y < -0.6) | (x > 159.6) | (y > 119.6)
+    np.testing.assert_allclose(out[inside][:, 0], (0.5 * x + 2 * y)[inside], atol=1e-3)
+    np.testing.assert_allclose(out[inside][:, 1], (3 * x - y)[inside], atol=1e-3)
+    self.assertTrue(np.all(out[outside] == -1))
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_warp_partly_mapped(self):
+    a = np.arange(100 * 120, dtype=np.float32).reshape(100, 120)
+
+    def mapping(points):
+      # a shift, with no answer right of column 70
+      positions = points + [3.0, 2.0]
+      positions[points[:, 0] > 70] = np.nan
+      return positions
+
+    out = np.array(vil.warp(vil.image_view_float(a), (90, 110), mapping, interp="nearest",
+                            fill=-1, grid_step=32)).reshape(90, 110)
+    # pixels up to the edge of the mapping are warped, not blanked with their cell
+    np.testing.assert_array_equal(out[:, :71], a[2:92, 3:74])
+    self.assertTrue(np.all(out[:, 71:] == -1))
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_warp_grid_to_file(self):
+    a = np.random.RandomState(4).randint(0, 255, size=(64, 80)).astype(np.uint8)
+    # flip left to right with a dense grid
+    j, i = np.mgrid[0:64, 0:80]
+    grid = np.stack([79 - i, j], axis=-1).astype(np.float64)
+
+    with tempfile.TemporaryDirectory() as tempdir:
+      filename = os.path.join(tempdir, "warped.tif")
+      resource = vil.warp(vil.image_view_byte(a), (64, 80), grid, interp="nearest",
+                          filename=filename, tile_size=32)
+      self.assertEqual((resource.ni(), resource.nj()), (80, 64))
+      np.testing.assert_array_equal(np.array(vil.load(filename)), a[:, ::-1])
+
+
+class VilPipeline(unittest.TestCase):
+  def tearDown(self):
+    vil.set_num_threads(0)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_pointwise(self):
+    a = np.random.RandomState(5).randint(0, 4000, size=(300, 500, 2)).astype(np.uint16)
+    b = np.random.RandomState(6).rand(300, 500, 2).astype(np.float32)
+
+    p = vil.pipeline(vil.image_view_uint16(a)).crop(10, 400, 20, 250)
+    q = (p.convert("float") * 0.5 + [1, 2]).truncate(0, 1500) - vil.pipeline(vil.image_view_float(b)).crop(0, 400, 0, 250)
+    self.assertEqual((q.ni(), q.nj(), q.nplanes()), (400, 250, 2))
+
+    vil.set_num_threads(3)
+    out = np.array(q.evaluate(tile_size=64))
+    expected = np.clip(a[20:270, 10:410] * 0.5 + np.array([1, 2]), 0, 1500) - b[:250, :400]
+    np.testing.assert_allclose(out, expected, rtol=1e-5, atol=1e-4)
+
+    # stretch_image a window at a time, which works in float rather than double
+    stretched = np.array(vil.pipeline(vil.image_view_uint16(a)).stretch(100, 3000, "byte").evaluate())
+    direct = np.array(vil.stretch_image(vil.image_view_uint16(a), 100, 3000, "byte"))
+    self.assertLessEqual(np.abs(stretched.astype(int) - direct).max(), 1)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_fused_steps_saturate(self):
+    a = np.array([[200, 3, 1, 255]], np.uint8)
+    # each step rounds and saturates to byte, even when fused with the next
+    doubled = np.array(vil.pipeline(vil.image_view_byte(a)).scale(2).convert("float").evaluate())
+    np.testing.assert_array_equal(doubled, [[255, 6, 2, 255]])
+    halved = np.array(vil.pipeline(vil.image_view_byte(a)).scale(0.5).scale(2).evaluate())
+    np.testing.assert_array_equal(halved, [[200, 4, 2, 255]])
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_convert_types(self):
+    a = np.array([[[-40.5, 60.25, 300.0], [20.5, 1e5, 0.0]]])
+    p = vil.pipeline(vil.image_view_double(a))
+    # the vil_types of vil.convert
+    self.assertIsInstance(p.convert("int16").evaluate(), vil.image_view_int16)
+    np.testing.assert_array_equal(np.array(p.convert("int16").evaluate()), [[[-40, 60, 300], [21, 32767, 0]]])
+    np.testing.assert_array_equal(np.array(p.convert("double").evaluate()), a)
+
+    rgb = p.convert("rgb_byte").evaluate()
+    self.assertIsInstance(rgb, vil.image_view_rgb_byte)
+    np.testing.assert_array_equal(np.array(vil.convert(rgb, "byte")), [[[0, 60, 255], [21, 255, 0]]])
+    with self.assertRaises(ValueError):
+      vil.pipeline(vil.image_view_double(a[:, :, :2])).convert("rgb_byte")
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_filter_to_file(self):
+    a = np.random.RandomState(7).rand(150, 130).astype(np.float32)
+    kernel = vil.gaussian_kernel(1.5)
+    p = vil.pipeline(vil.image_view_float(a)).convolve(kernel)
+    whole = np.array(vil.convolve(vil.image_view_float(a), kernel))
+
+    with tempfile.TemporaryDirectory() as tempdir:
+      filename = os.path.join(tempdir, "pipeline.tif")
+      resource = p.write(filename, tile_size=32)
+      self.assertEqual((resource.ni(), resource.nj()), (130, 150))
+      np.testing.assert_allclose(np.array(vil.load(filename)), whole, rtol=1e-6)
+      # windows pulled straight from the pipeline match too
+      np.testing.assert_allclose(np.array(p.get_view_float(40, 20, 100, 30)), whole[100:130, 40:60], rtol=1e-6)
+
+
+class VilConvert(unittest.TestCase):
+  def tearDown(self):
+    vil.set_num_threads(0)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_every_pair(self):
+    types = {"byte": (vil.image_view_byte, np.uint8), "short": (vil.image_view_uint16, np.uint16),
+             "int16": (vil.image_view_int16, np.int16), "int": (vil.image_view_int, np.int32),
+             "float": (vil.image_view_float, np.float32), "double": (vil.image_view_double, np.float64)}
+    values = np.array([0, 1, 2.5, 3.5, -2.5, 254.6, 255.5, 300, -300, 32767.5, 65535.4, 70000, -40000])
+    vil.set_num_threads(3)
+    for src_type, (src_cls, src_dtype) in types.items():
+      if np.issubdtype(src_dtype, np.integer):
+        info = np.iinfo(src_dtype)
+        src = np.clip(np.round(values), info.min, info.max).astype(src_dtype)
+      else:
+        src = values.astype(src_dtype)
+      # strided columns, as well as several planes
+      a = np.tile(src, (20, 3)).reshape(20, -1)[:, ::2]
+      a = np.dstack([a, a[::-1]])
+      for dst_type, (dst_cls, dst_dtype) in types.items():
+        out = vil.convert(src_cls(a), dst_type)
+        self.assertIsInstance(out, dst_cls)
+        if np.issubdtype(dst_dtype, np.integer):
+          info = np.iinfo(dst_dtype)
+          expected = np.clip(np.rint(a.astype(np.float64)), info.min, info.max)
+        else:
+          expected = a
+        np.testing.assert_array_equal(np.array(out), expected.astype(dst_dtype))
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_modes(self):
+    a = np.array([[-1.5, 0.5, 1.7, 255.5, 300.0, np.nan]], dtype=np.float32)
+    np.testing.assert_array_equal(np.array(vil.convert(vil.image_view_float(a), "byte")),
+                                  [[0, 0, 2, 255, 255, 0]])
+    np.testing.assert_array_equal(np.array(vil.convert(vil.image_view_float(a[:, :4]), "int16", rounding="truncate")),
+                                  [[-1, 0, 1, 255]])
+    # without saturation integers wrap around
+    b = np.array([[-1, 256, 70000]], dtype=np.int32)
+    np.testing.assert_array_equal(np.array(vil.convert(vil.image_view_int(b), "byte", saturate=False)),
+                                  [[255, 0, 112]])
+    # and floating point values beyond int32 are clamped to it first
+    f = np.array([[1e10, -1e10, np.nan, 70000.4]], dtype=np.float64)
+    np.testing.assert_array_equal(np.array(vil.convert(vil.image_view_double(f), "int", saturate=False)),
+                                  [[2147483647, -2147483648, 0, 70000]])
+    with self.assertRaises(ValueError):
+      vil.convert(vil.image_view_float(a), "byte", rounding="up")
+    with self.assertRaises(ValueError):
+      vil.convert(vil.image_view_float(a), "complex")
+    self.assertIn(vil.convert_kernel_isa(), ("avx2", "sse2"))
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_rgb(self):
+    a = np.random.RandomState(8).rand(30, 40, 3) * 300
+    rgb = vil.convert(vil.image_view_double(a), "rgb_byte")
+    self.assertIsInstance(rgb, vil.image_view_rgb_byte)
+    expected = np.clip(np.rint(a), 0, 255).astype(np.uint8)
+    np.testing.assert_array_equal(np.array(vil.convert(rgb, "int16")), expected)
+    with self.assertRaises(ValueError):
+      vil.convert(vil.image_view_double(a[:, :, :2]), "rgb_byte")
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_resource_views(self):
+    a = np.linspace(-10, 300, 12 * 16).reshape(12, 16).astype(np.float32)
+    resource = vil.pipeline(vil.image_view_float(a))
+    np.testing.assert_array_equal(np.array(resource.get_view_byte()), np.clip(np.rint(a), 0, 255))
+    np.testing.assert_array_equal(np.array(resource.get_copy_view_int16(2, 5, 3, 4)), np.rint(a[3:7, 2:7]))
+    np.testing.assert_array_equal(np.array(resource.get_view_double()), a)
+
+
+def _write_shared(view, value):
+  # run in a child process, on a view of its parent's shared memory
+  np.asarray(view)[0, 0, 0] = value
+
+
+class VilSharedMemory(unittest.TestCase):
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_other_processes(self):
+    for method in ("spawn", "fork"):
+      if method not in multiprocessing.get_all_start_methods():
+        continue
+      with self.subTest(method=method):
+        img = vil.shared_image_view(20, 10, 1, "short")
+        window = img[2:5, 3:8]
+        # spawn pickles the view, fork inherits the mapping
+        child = multiprocessing.get_context(method).Process(target=_write_shared, args=(window, 1234))
+        child.start()
+        child.join(60)
+        self.assertEqual(child.exitcode, 0)
+        self.assertEqual(np.asarray(img)[2, 3, 0], 1234)
+
+        # the name belongs to this process, and goes with its last view
+        state = pickle.dumps(img)
+        pickle.loads(state)
+        del img, window
+        with self.assertRaises(RuntimeError):
+          pickle.loads(state)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_persist(self):
+    img = vil.shared_copy(vil.image_view_int16(np.zeros((10, 20), dtype=np.int16)), persist=True)
+    # the name outlives this process's views, as a view pickled late by
+    # multiprocessing needs
+    state = pickle.dumps(img[2:5, 3:8])
+    del img
+    window = pickle.loads(state)
+    with multiprocessing.get_context("spawn").Pool(1) as pool:
+      pool.apply_async(_write_shared, (window, 1234)).get(60)
+    self.assertEqual(np.asarray(window)[0, 0, 0], 1234)
+
+    # until it is unlinked, from any process
+    vil.unlink_shared(window)
+    with self.assertRaises(RuntimeError):
+      pickle.loads(state)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_pickle_maps_the_same_pixels(self):
+    img = vil.shared_image_view(40, 30, 2, "short")
+    self.assertIsInstance(img, vil.image_view_uint16)
+    self.assertIsNotNone(vil.shared_memory_name(img))
+    a = np.asarray(img)
+    a[...] = np.arange(40 * 30 * 2).reshape(30, 40, 2)
+
+    window = img[3:10, 5:15]
+    state = pickle.dumps(window)
+    self.assertLess(len(state), 1000)
+    other = pickle.loads(state)
+    self.assertEqual(vil.shared_memory_name(other), vil.shared_memory_name(img))
+    np.testing.assert_array_equal(np.array(other), a[3:10, 5:15])
+    # writes through either view are seen by the other
+    np.asarray(other)[0, 0, 1] = 7
+    self.assertEqual(a[3, 5, 1], 7)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_copy_and_unlink(self):
+    a = np.random.RandomState(9).rand(20, 25, 3)
+    img = vil.shared_copy(vil.image_view_double(a))
+    np.testing.assert_array_equal(np.array(img), a)
+    rgb = vil.shared_copy(vil.convert(img, "rgb_byte"))
+    self.assertIsInstance(pickle.loads(pickle.dumps(rgb)), vil.image_view_rgb_byte)
+
+    state = pickle.dumps(img)
+    vil.unlink_shared(img)
+    with self.assertRaises(RuntimeError):
+      pickle.loads(state)
+    # the mapping outlives the name
+    np.testing.assert_array_equal(np.array(img), a)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_pickle_copies_other_views(self):
+    a = np.arange(60, dtype=np.float32).reshape(5, 4, 3)
+    img = vil.image_view_float(a)
+    self.assertIsNone(vil.shared_memory_name(img))
+    np.testing.assert_array_equal(np.array(pickle.loads(pickle.dumps(img[::-1, 1:]))), a[::-1, 1:])
+    with self.assertRaises(ValueError):
+      vil.unlink_shared(img)
+
+
+class VilDiskView(unittest.TestCase):
+  def setUp(self):
+    self.tempdir = tempfile.TemporaryDirectory()
+
+  def tearDown(self):
+    self.tempdir.cleanup()
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_disk_view(self):
+    img = vil.disk_image_view(300, 200, 2, "short", directory=self.tempdir.name)
+    self.assertIsInstance(img, vil.image_view_uint16)
+    self.assertTrue(vil.on_disk(img))
+    # the file has no name, so nothing is left in the directory
+    self.assertEqual(os.listdir(self.tempdir.name), [])
+
+    a = np.asarray(img)
+    a[...] = np.random.RandomState(11).randint(0, 4000, size=(200, 300, 2))
+    self.assertEqual(vil.img_sum(img, 1), a[:, :, 1].sum())
+
+    # results of the same size follow the input onto disk
+    stretched = vil.stretch_image(img, 100, 3000, "byte")
+    self.assertTrue(vil.on_disk(stretched))
+    np.testing.assert_array_equal(np.array(stretched),
+                                  np.array(vil.stretch_image(vil.image_view_uint16(a.copy()), 100, 3000, "byte")))
+    converted = vil.convert(img, "float")
+    self.assertTrue(vil.on_disk(converted))
+    np.testing.assert_array_equal(np.array(converted), a)
+    self.assertFalse(vil.on_disk(vil.convert(vil.image_view_uint16(a.copy()), "float")))
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_disk_copy(self):
+    a = np.random.RandomState(12).rand(50, 70, 3).astype(np.float32)
+    copy = vil.disk_copy(vil.image_view_float(a), directory=self.tempdir.name)
+    self.assertTrue(vil.on_disk(copy))
+    np.testing.assert_array_equal(np.array(copy), a)
+
+    filename = os.path.join(self.tempdir.name, "source.tif")
+    vil.save_image_view(vil.image_view_float(a), filename)
+    copy = vil.disk_copy(vil.load_image_resource(filename))
+    np.testing.assert_array_equal(np.array(copy), a)
+
+
+class VilConcurrentResource(unittest.TestCase):
+  def setUp(self):
+    self.tempdir = tempfile.TemporaryDirectory()
+
+  def tearDown(self):
+    self.tempdir.cleanup()
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_concurrent_reads(self):
+    a = np.random.RandomState(13).randint(0, 60000, size=(300, 400)).astype(np.uint16)
+    filename = os.path.join(self.tempdir.name, "shared.tif")
+    vil.save_image_view(vil.image_view_uint16(a), filename)
+
+    resource = vil.concurrent_image_resource(filename, max_handles=4)
+    self.assertEqual((resource.ni(), resource.nj(), resource.nplanes()), (400, 300, 1))
+    self.assertEqual(resource.max_handles, 4)
+    self.assertEqual(resource.n_open_handles, 1)
+
+    failures = []
+    def read(seed):
+      rng = np.random.RandomState(seed)
+      try:
+        for _ in range(50):
+          i0, j0 = rng.randint(0, 350), rng.randint(0, 250)
+          n_i, n_j = rng.randint(1, 400 - i0), rng.randint(1, 300 - j0)
+          view = resource.get_copy_view_short(i0, n_i, j0, n_j)
+          if not np.array_equal(np.array(view), a[j0:j0 + n_j, i0:i0 + n_i]):
+            failures.append((i0, n_i, j0, n_j))
+      except Exception as e:
+        failures.append(e)
+
+    threads = [threading.Thread(target=read, args=(seed,)) for seed in range(16)]
+    for thread in threads:
+      thread.start()
+    for thread in threads:
+      thread.join()
+    self.assertEqual(failures, [])
+    self.assertLessEqual(resource.n_open_handles, 4)
+    np.testing.assert_array_equal(np.array(resource.get_view_short()), a)
+
+  def test_missing_file(self):
+    with self.assertRaises(RuntimeError):
+      vil.concurrent_image_resource(os.path.join(self.tempdir.name, "missing.tif"))
+
+
+class VilTileResource(unittest.TestCase):
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_read_tiles(self):
+    a = np.random.RandomState(15).rand(100, 130, 2).astype(np.float32)
+
+    class Tiles(vil.tile_image_resource):
+      def __init__(self):
+        vil.tile_image_resource.__init__(self, 130, 100, 2, "float", block_ni=32, block_nj=32,
+                                         file_format="test")
+        self.calls = []
+
+      def read_tiles(self, windows):
+        self.calls.append(len(windows))
+        return [a[j0:j0 + nj, i0:i0 + ni] for i0, ni, j0, nj in windows]
+
+    tiles = Tiles()
+    self.assertEqual(tiles.shape, (100, 130, 2))
+    self.assertEqual(tiles.file_format(), "test")
+    self.assertEqual((tiles.block_ni, tiles.block_nj), (32, 32))
+    self.assertEqual(tiles.calls, [])
+
+    np.testing.assert_array_equal(np.array(tiles.get_view_float(5, 20, 7, 30)), a[7:37, 5:25])
+    self.assertEqual(tiles.calls, [1])
+
+    windows = [[0, 40, 0, 40], [20, 40, 10, 40], [100, 30, 70, 30]]
+    stack = tiles.get_views(windows, stack=True)
+    for chip, (i0, ni, j0, nj) in zip(stack, windows):
+      np.testing.assert_array_equal(chip, a[j0:j0 + nj, i0:i0 + ni])
+    # the blocks in one batch: 2 x 2 shared by the first two windows, 2 x 2 for the last
+    self.assertEqual(tiles.calls, [1, 8])
+
+    # tiles are adopted without a copy, so views share the arrays returned
+    view = tiles.get_view_float(32, 32, 0, 32)
+    copy = tiles.get_copy_view_float(32, 32, 0, 32)
+    a[0, 32, 0] = -1
+    self.assertEqual(np.array(view)[0, 0, 0], -1)
+    # but copies don't
+    self.assertNotEqual(np.array(copy)[0, 0, 0], -1)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_bad_tiles(self):
+    class Tiles(vil.tile_image_resource):
+      def __init__(self, tile):
+        vil.tile_image_resource.__init__(self, 20, 10)
+        self.tile = tile
+
+      def read_tiles(self, windows):
+        return [self.tile for _ in windows]
+
+    with self.assertRaises(RuntimeError):
+      Tiles(np.zeros((3, 3), dtype=np.uint8)).get_view_byte()
+    view = Tiles(vil.image_view_byte(np.ones((10, 20), dtype=np.uint8))).get_view_byte()
+    np.testing.assert_array_equal(np.array(view), 1)
+
+
+class VilLoad(unittest.TestCase):
+  def setUp(self):
+    self.tempdir = tempfile.TemporaryDirectory()
+
+  def tearDown(self):
+    self.tempdir.cleanup()
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_load_native(self):
+    a = np.array([[0, 1000], [40000, 65535]], dtype=np.uint16)
+    filename = os.path.join(self.tempdir.name, "native.tif")
+    vil.save_image_view(vil.image_view_uint16(a), filename)
+
+    img = vil.load_native(filename)
+    self.assertIsInstance(img, vil.image_view_uint16)
+    np.testing.assert_array_equal(np.array(img), a)
+
+    img = vil.load(filename)
+    self.assertIsInstance(img, vil.image_view_uint16)
+
+    stretched = vil.convert_stretch_range(img, "byte")
+    self.assertIsInstance(stretched, vil.image_view_byte)
+    self.assertEqual(vil.image_range(stretched), (0, 255))
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_encode_decode(self):
+    a = np.array([[0, 1000, 7], [40000, 65535, 3]], dtype=np.uint16)
+    data = vil.encode(vil.image_view_uint16(a), "tiff")
+    self.assertIsInstance(data, bytes)
+    img = vil.decode(data)
+    self.assertIsInstance(img, vil.image_view_uint16)
+    np.testing.assert_array_equal(np.array(img), a)
+    self.assertIsInstance(vil.decode(data, "byte"), vil.image_view_byte)
+
+    # the same bytes as saving to a file
+    filename = os.path.join(self.tempdir.name, "encoded.tif")
+    with open(filename, "wb") as fid:
+      fid.write(data)
+    np.testing.assert_array_equal(np.array(vil.load(filename)), a)
+
+    rgb = np.random.RandomState(10).randint(0, 256, size=(20, 30, 3)).astype(np.uint8)
+    resource = vil.decode(vil.encode(vil.image_view_byte(rgb), "pnm"), as_resource=True)
+    self.assertEqual((resource.ni(), resource.nj(), resource.nplanes()), (30, 20, 3))
+    np.testing.assert_array_equal(np.array(resource.get_view_byte()), rgb)
+
+  def test_encode_decode_errors(self):
+    img = vil.image_view_byte(4, 3)
+    with self.assertRaises(ValueError):
+      vil.encode(img, "tiff", {"speed": 3})
+    with self.assertRaises(ValueError):
+      vil.encode(img, "tiff", {"quality": 90})
+    with self.assertRaises(ValueError):
+      vil.encode(img, "jpeg", {"quality": 0})
+    with self.assertRaises(RuntimeError):
+      vil.decode(b"not an image")
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_load_many(self):
+    filenames = []
+    for k in range(5):
+      filename = os.path.join(self.tempdir.name, "many{}.tif".format(k))
+      vil.save_image_view(vil.image_view_uint16(np.full((3, 4), 100 * k, dtype=np.uint16)), filename)
+      filenames.append(filename)
+    filenames.insert(2, os.path.join(self.tempdir.name, "missing.tif"))
+
+    for num_threads in [0, 1, 3]:
+      images, errors = vil.load_many(filenames, num_threads=num_threads)
+      self.assertEqual(len(images), len(filenames))
+      self.assertIsNone(images[2])
+      self.assertIsNotNone(errors[2])
+      for k, (img, error) in enumerate(zip(images[:2] + images[3:], errors[:2] + errors[3:])):
+        self.assertIsNone(error)
+        self.assertIsInstance(img, vil.image_view_uint16)
+        self.assertTrue((np.array(img) == 100 * k).all())
+
+    images, errors = vil.load_many(filenames[:2], "float")
+    self.assertIsInstance(images[0], vil.image_view_float)
+    with self.assertRaises(ValueError):
+      vil.load_many(filenames, "complex")
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_async_writer(self):
+    a = np.arange(64 * 48, dtype=np.uint16).reshape(48, 64)
+    img = vil.image_view_uint16(a)
+    filenames = [os.path.join(self.tempdir.name, "async{}.tif".format(k)) for k in range(6)]
+
+    # a limit of one image at a time still gets everything written
+    with vil.async_writer(num_threads=2, max_bytes=a.nbytes) as writer:
+      futures = [writer.save(img, filename) for filename in filenames]
+    for future in futures:
+      self.assertTrue(future.done())
+      future.result()
+      np.testing.assert_array_equal(np.array(vil.load_native(future.filename)), a)
+
+    writer = vil.async_writer()
+    bad = writer.save(img, os.path.join(self.tempdir.name, "missing", "bad.tif"))
+    good = writer.save(img, filenames[0])
+    self.assertTrue(bad.wait(30))
+    with self.assertRaises(RuntimeError):
+      bad.result()
+    good.result()
+    with self.assertRaises(RuntimeError):
+      writer.flush()
+    # failures are only reported by one flush
+    writer.flush()
+    writer.close()
+    self.assertEqual(writer.pending, 0)
+    with self.assertRaises(RuntimeError):
+      writer.save(img, filenames[0])
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_build_pyramid(self):
+    a = np.random.RandomState(5).randint(0, 255, size=(200, 300)).astype(np.uint8)
+    filename = os.path.join(self.tempdir.name, "base.tif")
+    vil.save_image_view(vil.image_view_byte(a), filename)
+    directory = os.path.join(self.tempdir.name, "pyramid")
+
+    pyramid = vil.build_pyramid(vil.load_image_resource(filename), directory, kernel="box", tile_size=64)
+    # 300 -> 150 -> 75 -> 38, the first to fit in one tile
+    self.assertEqual(pyramid.nlevels(), 4)
+    np.testing.assert_array_equal(np.array(pyramid.get_resource(0).get_view_byte()), a)
+
+    view, scale = pyramid.get_view_at_scale(0.5)
+    self.assertAlmostEqual(scale, 0.5)
+    nj, ni = np.array(view).shape[:2]
+    self.assertEqual((ni, nj), (150, 100))
+    expected = (a.astype(np.float64).reshape(100, 2, 150, 2).mean(axis=(1, 3)) + 0.5).astype(np.uint8)
+    np.testing.assert_array_equal(np.array(view).reshape(100, 150), expected)
+
+    with self.assertRaises(ValueError):
+      vil.build_pyramid(vil.load_image_resource(filename), directory, kernel="lanczos")
+
+    # a shallower rebuild doesn't pick up the deeper levels of the last one
+    pyramid = vil.build_pyramid(vil.load_image_resource(filename), directory, n_levels=2, tile_size=64)
+    self.assertEqual(pyramid.nlevels(), 2)
+    self.assertEqual(sorted(os.listdir(directory)), ["level_0.tif", "level_1.tif"])
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_resource_blocks(self):
+    a = np.arange(70 * 50, dtype=np.float32).reshape(50, 70)
+    filename = os.path.join(self.tempdir.name, "blocks.tif")
+    vil.save_image_view(vil.image_view_float(a), filename)
+    resource = vil.load_image_resource(filename)
+
+    for read_ahead in [0, 3]:
+      blocks = resource.blocks(32, 16, overlap=2, read_ahead=read_ahead)
+      # sizes may be rounded up to the block size of the file
+      self.assertGreaterEqual(blocks.block_ni, 32)
+      self.assertGreaterEqual(blocks.block_nj, 16)
+      self.assertEqual(len(blocks), blocks.n_block_i * blocks.n_block_j)
+      count = 0
+      for i0, j0, view in blocks:
+        nj, ni, _ = view.shape
+        np.testing.assert_array_equal(np.array(view), a[j0:j0 + nj, i0:i0 + ni])
+        # other windows while the next blocks are decoded in the background
+        window = blocks.get_copy_view(60 - i0 // 2, 10, 40 - j0 // 2, 5)
+        np.testing.assert_array_equal(np.array(window), a[40 - j0 // 2:45 - j0 // 2, 60 - i0 // 2:70 - i0 // 2])
+        count += 1
+      self.assertEqual(count, len(blocks))
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_cached_resource(self):
+    a = np.arange(64 * 48, dtype=np.uint16).reshape(48, 64)
+    filename = os.path.join(self.tempdir.name, "cached.tif")
+    vil.save_image_view(vil.image_view_uint16(a), filename)
+
+    cached = vil.cached_image_resource(vil.load_image_resource(filename),
+                                       max_bytes=4 * 16 * 16 * 2,
+                                       block_ni=16, block_nj=16)
+    self.assertEqual(cached.shape, (48, 64, 1))
+
+    view = cached.get_view_short(10, 20, 5, 10)
+    np.testing.assert_array_equal(np.array(view), a[5:15, 10:30])
+    self.assertEqual(cached.misses, 2)
+    self.assertEqual(cached.hits, 0)
+
+    view = cached.get_view_short(12, 8, 6, 8)
+    np.testing.assert_array_equal(np.array(view), a[6:14, 12:20])
+    self.assertEqual(cached.misses, 2)
+    self.assertEqual(cached.hits, 2)
+
+    cached.get_view_short(0, 64, 32, 16)
+    self.assertEqual(cached.misses, 6)
+    self.assertEqual(cached.evictions, 2)
+    self.assertEqual(cached.n_cached_blocks, 4)
+    self.assertLessEqual(cached.bytes, cached.max_bytes)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_get_views(self):
+    a = np.random.RandomState(14).randint(0, 1000, size=(90, 120, 3)).astype(np.uint16)
+    filename = os.path.join(self.tempdir.name, "chips.tif")
+    vil.save_image_view(vil.image_view_uint16(a), filename)
+    windows = np.array([[10, 20, 5, 16], [15, 20, 8, 16], [100, 20, 74, 16], [0, 20, 0, 16]])
+
+    for resource in (vil.load_image_resource(filename), vil.load_mmap_image_resource(filename),
+                     vil.concurrent_image_resource(filename, max_handles=3)):
+      views = resource.get_views(windows)
+      self.assertEqual(len(views), 4)
+      for view, (i0, ni, j0, nj) in zip(views, windows):
+        self.assertIsInstance(view, vil.image_view_uint16)
+        np.testing.assert_array_equal(np.array(view), a[j0:j0 + nj, i0:i0 + ni])
+
+      stack = resource.get_views(windows, stack=True)
+      self.assertEqual(stack.shape, (4, 16, 20, 3))
+      for chip, (i0, ni, j0, nj) in zip(stack, windows):
+        np.testing.assert_array_equal(chip, a[j0:j0 + nj, i0:i0 + ni])
+
+    resource = vil.load_image_resource(filename)
+    stack = resource.get_views(windows, "byte", stack=True)
+    self.assertEqual(stack.dtype, np.uint8)
+    np.testing.assert_array_equal(stack[1], np.minimum(a[8:24, 15:35], 255))
+    views = resource.get_views([[0, 7, 0, 3], [50, 1, 60, 30]], "float")
+    self.assertIsInstance(views[1], vil.image_view_float)
+    np.testing.assert_array_equal(np.array(views[1]), a[60:90, 50:51])
+    self.assertEqual(resource.get_views(np.zeros((0, 4), dtype=int)), [])
+
+    with self.assertRaises(IndexError):
+      resource.get_views([[110, 20, 0, 5]])
+    with self.assertRaises(ValueError):
+      resource.get_views([[0, 5, 0, 5, 1]])
+    with self.assertRaises(ValueError):
+      resource.get_views([[0, 5, 0, 5], [0, 6, 0, 5]], stack=True)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_mmap_tiff(self):
+    a = np.arange(40 * 30, dtype=np.uint16).reshape(30, 40)
+    filename = os.path.join(self.tempdir.name, "mmap.tif")
+    vil.save_image_view(vil.image_view_uint16(a), filename)
+
+    resource = vil.load_mmap_image_resource(filename)
+    self.assertEqual(resource.shape, (30, 40, 1))
+    np.testing.assert_array_equal(np.array(resource.get_view_short(5, 10, 3, 7)), a[3:10, 5:15])
+    np.testing.assert_array_equal(np.array(resource.get_copy_view_short()), a)
+
+  @unittest.skipUnless(np, "Numpy not found")
+  def test_mmap_raw(self):
+    a = np.arange(4 * 5 * 3, dtype=np.float32).reshape(4, 5, 3)
+    filename = os.path.join(self.tempdir.name, "mmap.raw")
+    with open(filename, "wb") as fid:
+      fid.write(b"\0" * 16)
+      fid.write(a.tobytes())
+
+    resource = vil.mmap_raw_image_resource(filename, 5, 4, 3, vil.VIL_PIXEL_FORMAT_FLOAT,
+                                           offset=16, interleaved=True)
+    np.testing.assert_array_equal(np.array(resource.get_view_float()), a)
+
+
+class VilImageViewByte(VilImageViewBase, unittest.TestCase):
+  def __init__(self, *args, **kwargs):
+    self.cls = vil.image_view_byte
+    self.dtype = np.uint8 if np else None
+    super().__init__(*args, **kwargs)
+
+
+class VilImageViewUint16(VilImageViewBase, unittest.TestCase):
+  def __init__(self, *args, **kwargs):
+    self.cls = vil.image_view_uint16
+    self.dtype = np.uint16 if np else None
+    super().__init__(*args, **kwargs)
+
+
+class VilImageViewFloat(VilImageViewBase, unittest.TestCase):
+  def __init__(self, *args, **kwargs):
+    self.cls = vil.image_view_float
+    self.dtype = np.float32 if np else None
+    super().__init__(*args, **kwargs)
+
+
+class VilImageViewInt(VilImageViewBase, unittest.TestCase):
+  def __init__(self, *args, **kwargs):
+    self.cls = vil.image_view_int
+    self.dtype = np.int32 if np else None
+    super().__init__(*args, **kwargs)
+
+
+class VilImageViewInt16(VilImageViewBase, unittest.TestCase):
+  def __init__(self, *args, **kwargs):
+    self.cls = vil.image_view_int16
+    self.dtype = np.int16 if np else None
+    super().__init__(*args, **kwargs)
+
+
+class VilImageViewDouble(VilImageViewBase, unittest.TestCase):
+  def __init__(self, *args, **kwargs):
+    self.cls = vil.image_view_double
+    self.dtype = np.float64 if np else None
+    super().__init__(*args, **kwargs)
+
+
+if __name__ == '__main__':
+  unittest.main()
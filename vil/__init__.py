@@ -1,7 +1,7 @@
 from ._vil import *
 
 
-def load(filename, vil_type):
+def load(filename, vil_type=None):
 
   # Relative imports, don't pollute vxl.vil import space
   from ._vil import _load_byte, _load_short, _load_float, _load_int
@@ -12,10 +12,9 @@ def load(filename, vil_type):
   # base_sptr, native_type = _load(filename)
   # print("DONE LOADING FROM PYTHON")
 
-  # if vil_type is None:
-  #   vil_type = native_type
-
-  if vil_type == "byte":
+  if vil_type is None:
+    return load_native(filename)
+  elif vil_type == "byte":
     return _load_byte(filename)
     # return _convert_base_sptr_to_byte(base_sptr)
   elif vil_type == "short":
@@ -31,12 +30,79 @@ def load(filename, vil_type):
     raise ValueError("Unknown vil_type <{}>".format(vil_type))
 
 
+def load_many(filenames, vil_type=None, num_threads=0):
+  """
+  Load several images at once, decoding them concurrently.
+
+  Parameters
+  ----------
+  filenames : list of string
+    The image files to load
+  vil_type : string (optional)
+    One of "byte", "short", "float" or "int", as for load. By default each
+    image keeps the pixel format of its file.
+  num_threads : int (optional)
+    Number of decoding threads. 0 uses the threads set by set_num_threads.
+
+  Returns
+  -------
+  (images, errors)
+    Two lists in the order of filenames. Where a file could not be loaded
+    its image is None and its error is the reason, otherwise the error is None.
+  """
+
+  # Relative imports, don't pollute vxl.vil import space
+  from ._vil import _load_many
+
+  return _load_many(list(filenames), vil_type or "", num_threads)
+
+
+def convert_stretch_range(image_view, vil_type):
+  """
+  Convert an image view to another pixel type, stretching its full range
+  of values onto the range of the new type (as load(filename, vil_type) does).
+
+  Parameters
+  ----------
+  image_view : image_view_*
+    The view to convert, e.g. as returned by load_native
+  vil_type : string
+    One of "byte", "short", "float" or "int"
+
+  Returns
+  -------
+  New image_view_* of the requested type
+  """
+
+  # Relative imports, don't pollute vxl.vil import space
+  from ._vil import (_convert_stretch_range_to_byte, _convert_stretch_range_to_short,
+                     _convert_stretch_range_to_float, _convert_stretch_range_to_int)
+
+  if vil_type == "byte":
+    return _convert_stretch_range_to_byte(image_view)
+  elif vil_type == "short":
+    return _convert_stretch_range_to_short(image_view)
+  elif vil_type == "float":
+    return _convert_stretch_range_to_float(image_view)
+  elif vil_type == "int":
+    return _convert_stretch_range_to_int(image_view)
+  else:
+    raise ValueError("Unknown vil_type <{}>".format(vil_type))
+
+
 def stretch_image(image_view, min_limit, max_limit, out_type):
 
   # Relative imports, don't pollute vxl.vil import space
   from ._vil import _stretch_image_to_byte, _stretch_image_to_short, _stretch_image_to_float
 
-  if (min_limit >= max_limit):
+  # limits are either scalars, or sequences with one limit per plane
+  try:
+    min_limits, max_limits = list(min_limit), list(max_limit)
+  except TypeError:
+    min_limits, max_limits = [min_limit], [max_limit]
+
+  if (len(min_limits) != len(max_limits) or
+      any(lo >= hi for lo, hi in zip(min_limits, max_limits))):
     raise ValueError("vxl.vil.stretch_image: invalid stretch limits")
 
   # if copy:
@@ -48,11 +114,356 @@ def stretch_image(image_view, min_limit, max_limit, out_type):
   #   image_view = image_view_input
 
   if out_type == "byte":
-    return _stretch_image_to_byte(image_view, min_limit, max_limit)
+    return _stretch_image_to_byte(image_view, min_limits, max_limits)
   elif out_type == "short":
-    return _stretch_image_to_short(image_view, min_limit, max_limit)
+    return _stretch_image_to_short(image_view, min_limits, max_limits)
   elif out_type == "float":
-    return _stretch_image_to_float(image_view, min_limit, max_limit)
+    return _stretch_image_to_float(image_view, min_limits, max_limits)
   else:
     raise ValueError("vxl.vil.stretch_image: unknown out_type {}".format(out_type))
 
+
+
+def percentile_limits(image, low=2.0, high=98.0, bins=4096, sample_step=0):
+  """
+  Per plane stretch limits at the given percentiles, from a histogram of the
+  image rather than a sort. An image_resource is read block by block, so
+  memory stays bounded however big the image is.
+
+  Parameters
+  ----------
+  image : image_view_* or image_resource
+    The image to measure
+  low, high : float (optional)
+    Percentiles of the lower and upper limits
+  bins : int (optional)
+    Number of histogram bins spanning the range of the image. Byte and
+    16 bit images always use one bin per value.
+  sample_step : int (optional)
+    Only sample every sample_step-th pixel of every sample_step-th row of an
+    image_resource. 0 picks a step sampling about 16 million pixels.
+
+  Returns
+  -------
+  (min_limits, max_limits)
+    Lists with one limit per plane
+  """
+
+  # Relative imports, don't pollute vxl.vil import space
+  from ._vil import image_stats, image_resource
+  import math
+
+  # one bin per value for small integer types, exact and in a single pass
+  pixel_format = image.pixel_format()
+  if pixel_format in (VIL_PIXEL_FORMAT_BYTE, VIL_PIXEL_FORMAT_RGB_BYTE, VIL_PIXEL_FORMAT_RGBA_BYTE):
+    bins, value_range = 256, (0, 256)
+  elif pixel_format in (VIL_PIXEL_FORMAT_UINT_16, VIL_PIXEL_FORMAT_RGB_UINT_16, VIL_PIXEL_FORMAT_RGBA_UINT_16):
+    bins, value_range = 65536, (0, 65536)
+  else:
+    value_range = None
+
+  if isinstance(image, image_resource):
+    if sample_step <= 0:
+      sample_step = max(1, int(math.sqrt(image.ni() * image.nj() / float(1 << 24))))
+    stats = image_stats(image, bins=bins, range=value_range, sample_step=sample_step)
+  else:
+    stats = image_stats(image, bins=bins, range=value_range)
+
+  return [s.percentile(low) for s in stats], [s.percentile(high) for s in stats]
+
+
+def auto_stretch(image, out_type="byte", low=2.0, high=98.0, bins=4096, sample_step=0, filename=None):
+  """
+  Stretch an image between per plane percentile limits, see percentile_limits.
+
+  Parameters
+  ----------
+  image : image_view_* or image_resource
+    The image to stretch. An image_resource of any pixel type is read in
+    tiles, both to find its limits and to stretch it, so only the output is
+    ever held in memory; compound pixels (e.g. RGB) are stretched per
+    component.
+  out_type : string (optional)
+    One of "byte", "short" or "float"
+  low, high, bins, sample_step : (optional)
+    As for percentile_limits
+  filename : string (optional)
+    For an image_resource, write the stretched image tile by tile to this
+    tiled TIFF instead, keeping memory bounded however big the image is
+
+  Returns
+  -------
+  New image_view_* of out_type, or the image_resource of filename
+  """
+
+  # Relative imports, don't pollute vxl.vil import space
+  from ._vil import image_resource, pipeline
+
+  min_limits, max_limits = percentile_limits(image, low, high, bins, sample_step)
+  # a plane of a single value still needs a non empty range
+  max_limits = [hi if hi > lo else lo + 1 for lo, hi in zip(min_limits, max_limits)]
+
+  if isinstance(image, image_resource):
+    if out_type not in ("byte", "short", "float"):
+      raise ValueError("vxl.vil.auto_stretch: unknown out_type {}".format(out_type))
+    stretched = pipeline(image).stretch(min_limits, max_limits, out_type)
+    if filename is not None:
+      return stretched.write(filename)
+    return stretched.evaluate()
+  if filename is not None:
+    raise ValueError("vxl.vil.auto_stretch: filename is only for an image_resource")
+
+  return stretch_image(image, min_limits, max_limits, out_type)
+
+
+def _filter_image(image, kernel_i, kernel_j, out, out_type):
+  # Relative imports, don't pollute vxl.vil import space
+  from ._vil import _separable_filter, image_view_float, image_view_rgb_byte
+
+  if out is None:
+    view_type = image_view_float if out_type == "float" else type(image)
+    nplanes = image.nplanes()
+    if view_type is image_view_float and isinstance(image, image_view_rgb_byte):
+      # colours are filtered as planes of their components
+      nplanes *= 3
+    out = view_type(image.ni(), image.nj(), nplanes)
+  elif type(out) not in (type(image), image_view_float):
+    raise TypeError("vxl.vil: can't filter a {} into a {}, out must be of the image's type "
+                    "or image_view_float".format(type(image).__name__, type(out).__name__))
+  _separable_filter(image, [float(k) for k in kernel_i], [float(k) for k in kernel_j], out)
+  return out
+
+
+def convolve(image, kernel_i, kernel_j=None, out=None):
+  """
+  Convolve an image with a separable kernel, replicating its edges. Rows
+  are convolved with kernel_i and columns with kernel_j, each centred on
+  element len(kernel) // 2. The image is filtered in cache sized tiles on
+  the threads set by set_num_threads.
+
+  Parameters
+  ----------
+  image : image_view_*
+    The image to filter, every plane separately
+  kernel_i : sequence of float
+    The kernel along i (x)
+  kernel_j : sequence of float (optional)
+    The kernel along j (y), kernel_i by default. [1] filters along i only.
+  out : image_view_* (optional)
+    View of the size of image to write the result into, either of the
+    image's type (rounded and saturated) or image_view_float. May be image
+    itself. A new view of the image's type by default. An
+    image_view_rgb_byte is filtered as planes of its components, so an
+    image_view_float out needs three planes for each of its planes.
+
+  Returns
+  -------
+  out
+  """
+
+  if kernel_j is None:
+    kernel_j = kernel_i
+  return _filter_image(image, list(kernel_i)[::-1], list(kernel_j)[::-1], out, None)
+
+
+def gaussian_kernel(sigma, truncate=3.0):
+  """
+  Normalised 1D Gaussian kernel of standard deviation sigma, with
+  2 * ceil(truncate * sigma) + 1 taps.
+  """
+
+  import math
+
+  if sigma <= 0:
+    raise ValueError("vxl.vil.gaussian_kernel: sigma must be positive")
+  radius = int(math.ceil(truncate * sigma))
+  kernel = [math.exp(-0.5 * (x / float(sigma)) ** 2) for x in range(-radius, radius + 1)]
+  total = sum(kernel)
+  return [k / total for k in kernel]
+
+
+def gaussian_blur(image, sigma, sigma_j=None, out=None, truncate=3.0):
+  """
+  Gaussian smoothing of every plane of an image, see convolve.
+
+  Parameters
+  ----------
+  image : image_view_*
+    The image to smooth
+  sigma : float
+    Standard deviation in pixels along i, and along j unless sigma_j is given
+  sigma_j : float (optional)
+    Standard deviation in pixels along j
+  out : image_view_* (optional)
+    As for convolve
+  truncate : float (optional)
+    The kernels stop at truncate standard deviations
+
+  Returns
+  -------
+  out
+  """
+
+  kernel_i = gaussian_kernel(sigma, truncate)
+  kernel_j = kernel_i if sigma_j is None else gaussian_kernel(sigma_j, truncate)
+  return _filter_image(image, kernel_i, kernel_j, out, None)
+
+
+def box_filter(image, size, size_j=None, out=None):
+  """
+  Mean over a size x size_j window (size_j defaults to size) around each
+  pixel, see convolve. Even sizes reach one pixel further back than forward.
+
+  Returns
+  -------
+  out
+  """
+
+  if size_j is None:
+    size_j = size
+  if size < 1 or size_j < 1:
+    raise ValueError("vxl.vil.box_filter: size must be at least 1")
+  return _filter_image(image, [1.0 / size] * size, [1.0 / size_j] * size_j, out, None)
+
+
+def gradient(image, kind="sobel", out_i=None, out_j=None):
+  """
+  Derivatives of every plane of an image along i and j, in grey levels per
+  pixel, with edges replicated.
+
+  Parameters
+  ----------
+  image : image_view_*
+    The image to differentiate
+  kind : string (optional)
+    "central" for (f(x+1) - f(x-1)) / 2, or "sobel" to also smooth across
+    the derivative with [1 2 1] / 4
+  out_i, out_j : image_view_float (optional)
+    Views of the size of image to write the derivatives into
+
+  Returns
+  -------
+  (out_i, out_j)
+    New image_view_float views unless given, with three planes for each
+    plane of an image_view_rgb_byte
+  """
+
+  derivative = [-0.5, 0.0, 0.5]
+  if kind == "central":
+    smooth = [1.0]
+  elif kind == "sobel":
+    smooth = [0.25, 0.5, 0.25]
+  else:
+    raise ValueError("vxl.vil.gradient: unknown kind {}".format(kind))
+
+  return (_filter_image(image, derivative, smooth, out_i, "float"),
+          _filter_image(image, smooth, derivative, out_j, "float"))
+
+
+def _mapping_grid(mapping, ni, nj, step):
+  # nodes every step pixels, the last row and column reaching past the image
+  import numpy as np
+
+  gi = np.arange(0, step * ((ni - 1 + step - 1) // step) + 1, step, dtype=np.float64)
+  gj = np.arange(0, step * ((nj - 1 + step - 1) // step) + 1, step, dtype=np.float64)
+  points = np.stack(np.meshgrid(gi, gj), axis=-1).reshape(-1, 2)
+  positions = np.asarray(mapping(points), dtype=np.float64)
+  return positions.reshape(len(gj), len(gi), 2)
+
+
+def _exact_cells(mapping, grid, step):
+  # cells with some but not all nodes mapped can't be interpolated, as a
+  # NaN node would blank the whole cell, so the mapping is evaluated at
+  # every one of their pixels instead
+  import numpy as np
+
+  no_cells = np.zeros((0, 2), dtype=np.int64), np.zeros((0, step + 1, step + 1, 2))
+  if step == 1 or grid.shape[0] < 2 or grid.shape[1] < 2:
+    return no_cells
+  finite = np.isfinite(grid).all(axis=-1).astype(int)
+  corners = finite[:-1, :-1] + finite[1:, :-1] + finite[:-1, 1:] + finite[1:, 1:]
+  gj, gi = np.nonzero((corners > 0) & (corners < 4))
+  if gi.size == 0:
+    return no_cells
+  di, dj = np.meshgrid(np.arange(step + 1), np.arange(step + 1))
+  pixels = np.stack([(gi[:, None, None] * step + di).ravel(), (gj[:, None, None] * step + dj).ravel()], axis=-1)
+  positions = np.asarray(mapping(pixels.astype(np.float64)), dtype=np.float64)
+  return np.stack([gi, gj], axis=-1), positions.reshape(gi.size, step + 1, step + 1, 2)
+
+
+def _grid_error(mapping, grid, step):
+  # largest distance between the mapping and the grid at the cell centres,
+  # skipping cells with NaN nodes, which _exact_cells takes care of
+  import numpy as np
+
+  if step == 1 or grid.shape[0] < 2 or grid.shape[1] < 2:
+    return 0.0
+  nj, ni = grid.shape[0] - 1, grid.shape[1] - 1
+  ci = (np.arange(ni, dtype=np.float64) + 0.5) * step
+  cj = (np.arange(nj, dtype=np.float64) + 0.5) * step
+  centres = np.stack(np.meshgrid(ci, cj), axis=-1).reshape(-1, 2)
+  exact = np.asarray(mapping(centres), dtype=np.float64).reshape(nj, ni, 2)
+  blended = 0.25 * (grid[:-1, :-1] + grid[1:, :-1] + grid[:-1, 1:] + grid[1:, 1:])
+  error = np.sqrt(((exact - blended) ** 2).sum(axis=-1))
+  error = error[np.isfinite(error)]
+  return float(error.max()) if error.size else 0.0
+
+
+def warp(src, dst_shape, mapping, interp="bilinear", fill=0, max_error=0.125, grid_step=64,
+         filename=None, tile_size=256, file_format="tiff"):
+  """
+  Resample an image onto a new pixel grid.
+
+  Parameters
+  ----------
+  src : image_resource or image_view_*
+    The image to resample. A resource is read a tile's footprint at a time.
+  dst_shape : (nj, ni)
+    Rows and columns of the output
+  mapping : callable or array
+    Either a callable taking an N x 2 array of output (i, j) pixels and
+    returning their N x 2 (i, j) positions in src (NaN where there is
+    none), such as vxl.vpgl.camera_mapping; or an nj x ni x 2 array
+    holding the position in src of every output pixel.
+  interp : string (optional)
+    "nearest", "bilinear" or "bicubic"
+  fill : float (optional)
+    Value of output pixels falling outside src
+  max_error : float (optional)
+    A callable mapping is evaluated every grid_step pixels and
+    interpolated in between; the step is halved until that is within
+    max_error source pixels of the mapping at the centres of the cells.
+    Cells only partly mapped (some nodes NaN) are evaluated at every pixel.
+  grid_step : int (optional)
+    The first step tried
+  filename : string (optional)
+    Write the output to this tiled file tile by tile, instead of memory
+  tile_size, file_format : (optional)
+    Tile size and format of the file
+
+  Returns
+  -------
+  A new image_view_* of the component type of src, or the image_resource
+  of the file
+  """
+
+  # Relative imports, don't pollute vxl.vil import space
+  from ._vil import _warp
+  import numpy as np
+
+  nj, ni = dst_shape
+  if callable(mapping):
+    step = max(1, int(grid_step))
+    grid = _mapping_grid(mapping, ni, nj, step)
+    while step > 1 and _grid_error(mapping, grid, step) > max_error:
+      step //= 2
+      grid = _mapping_grid(mapping, ni, nj, step)
+    cells, cell_positions = _exact_cells(mapping, grid, step)
+  else:
+    step, grid = 1, np.asarray(mapping, dtype=np.float64)
+    if grid.shape != (nj, ni, 2):
+      raise ValueError("vxl.vil.warp: a mapping array must have shape {}".format((nj, ni, 2)))
+    cells, cell_positions = np.zeros((0, 2), dtype=np.int64), np.zeros((0, 2, 2, 2))
+
+  return _warp(src, np.ascontiguousarray(grid), step, ni, nj, interp, fill,
+               filename or "", tile_size, file_format, cells, cell_positions)
@@ -1,12 +1,25 @@
 #include "pyvil.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <tuple>
+#include <vector>
 #include <vil/vil_convert.h>
 #include <vil/vil_crop.h>
+#include <vil/vil_file_format.h>
 #include <vil/vil_image_view.h>
 #include <vil/vil_image_view_base.h>
 #include <vil/vil_load.h>
 #include <vil/vil_math.h>
+#include <vil/vil_memory_chunk.h>
+#include <vil/vil_new.h>
 #include <vil/vil_pixel_format.h>
+#include <vil/vil_pyramid_image_resource.h>
 #include <vil/vil_save.h>
 
 #include <pybind11/pybind11.h>
@@ -14,6 +27,26 @@
 #include <pybind11/numpy.h>
 
 #include "pyvxl_holder_types.h"
+#include "pyvil_async_writer.h"
+#include "pyvil_block_iterator.h"
+#include "pyvil_cached_resource.h"
+#include "pyvil_codec.h"
+#include "pyvil_concurrent_resource.h"
+#include "pyvil_convert.h"
+#include "pyvil_disk_view.h"
+#include "pyvil_filter.h"
+#include "pyvil_integral.h"
+#include "pyvil_mmap_resource.h"
+#include "pyvil_parallel.h"
+#include "pyvil_pipeline.h"
+#include "pyvil_pyramid.h"
+#include "pyvil_sample.h"
+#include "pyvil_shared_memory.h"
+#include "pyvil_stats.h"
+#include "pyvil_stretch.h"
+#include "pyvil_tile_resource.h"
+#include "pyvil_warp.h"
+#include "pyvil_window_reader.h"
 
 namespace py = pybind11;
 
@@ -216,9 +249,52 @@ public:
 };
 
 
+/* A vil_memory_chunk which does not own its memory, but instead refers to the
+ * data of a numpy array. The array is kept alive for as long as any view
+ * still holds a reference to the chunk */
+class numpy_memory_chunk : public vil_memory_chunk {
+public:
+  numpy_memory_chunk(py::array const& array, vil_pixel_format pixel_format)
+    : vil_memory_chunk(), array_(array)
+  {
+    data_ = array_.mutable_data();
+    size_ = array_.nbytes();
+    pixel_format_ = pixel_format;
+  }
+
+  ~numpy_memory_chunk() override
+  {
+    // the memory belongs to numpy, don't let the base class delete it
+    data_ = nullptr;
+
+    // the last view may be released from a thread not holding the GIL
+    py::gil_scoped_acquire acquire;
+    array_.release().dec_ref();
+  }
+
+private:
+  py::array array_;
+};
+
+
 template <class T>
-vil_image_view<T>* image_from_buffer(py::array_t<T> b)
+vil_image_view<T>* image_from_buffer(py::object buffer, bool copy)
 {
+  // converting to another dtype always copies, which would silently detach
+  // the view from the caller's array, so it has to be asked for
+  py::array a = py::array::ensure(buffer);
+  if (!a) {
+    throw py::type_error("Expecting a numpy array or an object with the buffer protocol");
+  }
+  if (!copy && !py::isinstance<py::array_t<T> >(a)) {
+    throw py::type_error("Buffer has dtype " + std::string(py::str(a.dtype())) +
+                         " rather than " + std::string(py::str(py::dtype::of<T>())) +
+                         "; pass copy=True to convert it");
+  }
+  py::array_t<T> b = py::array_t<T>::ensure(a);
+  if (!b) {
+    throw py::type_error("Cannot convert the buffer to " + std::string(py::str(py::dtype::of<T>())));
+  }
   py::buffer_info info = b.request();
   if (info.format != py::format_descriptor<T>::format()) {
     throw std::runtime_error("Incompatible scalar type");
@@ -236,18 +312,42 @@ vil_image_view<T>* image_from_buffer(py::array_t<T> b)
     num_planes = info.shape[2];
   }
 
-  // in-place constructor
-  vil_image_view<T> *img = new vil_image_view<T>(num_cols, num_rows, num_planes);
-  size_t row_stride = info.strides[0]/sizeof(T);
-  size_t col_stride = info.strides[1]/sizeof(T);
-  size_t plane_stride = 0;
+  // vil steps are in units of T, so numpy byte strides must divide evenly,
+  // and the data must be writable since vil views are always mutable
+  bool representable = b.writeable() &&
+    (reinterpret_cast<std::uintptr_t>(info.ptr) % alignof(T) == 0);
+  for (auto stride : info.strides) {
+    representable = representable && (stride % static_cast<py::ssize_t>(sizeof(T)) == 0);
+  }
+
+  const std::ptrdiff_t row_stride = info.strides[0] / static_cast<std::ptrdiff_t>(sizeof(T));
+  const std::ptrdiff_t col_stride = info.strides[1] / static_cast<std::ptrdiff_t>(sizeof(T));
+  std::ptrdiff_t plane_stride = row_stride * static_cast<std::ptrdiff_t>(num_rows);
   if (info.ndim == 3) {
-    plane_stride = info.strides[2]/sizeof(T);
+    plane_stride = info.strides[2] / static_cast<std::ptrdiff_t>(sizeof(T));
   }
+
+  if (!copy && representable) {
+    // zero-copy view directly over the numpy memory
+    vil_memory_chunk_sptr chunk = new numpy_memory_chunk(
+        b, vil_pixel_format_component_format(vil_pixel_format_of(T())));
+    return new vil_image_view<T>(chunk, static_cast<T*>(info.ptr),
+                                 num_cols, num_rows, num_planes,
+                                 col_stride, row_stride, plane_stride);
+  }
+
+  // in-place constructor
+  vil_image_view<T> *img = new vil_image_view<T>(num_cols, num_rows, num_planes);
+  const char* data = static_cast<const char*>(info.ptr);
   for (size_t r=0; r<num_rows; ++r) {
     for (size_t c=0; c<num_cols; ++c) {
       for (size_t p=0; p<num_planes; ++p) {
-        (*img)(c,r,p) = *(static_cast<T*>(info.ptr) + r*row_stride + c*col_stride + p*plane_stride);
+        py::ssize_t offset = static_cast<py::ssize_t>(r)*info.strides[0] +
+                             static_cast<py::ssize_t>(c)*info.strides[1];
+        if (info.ndim == 3) {
+          offset += static_cast<py::ssize_t>(p)*info.strides[2];
+        }
+        std::memcpy(&(*img)(c,r,p), data + offset, sizeof(T));
       }
     }
   }
@@ -256,14 +356,260 @@ vil_image_view<T>* image_from_buffer(py::array_t<T> b)
 }
 
 
+// A tile returned to read_tiles as a view of T: an image view is shared, and
+// anything else with the buffer protocol is adopted without a copy when its
+// type and strides allow
+template <class T>
+struct adopt_tile_op {
+  static vil_image_view_base_sptr run(py::handle tile, image_window const& window, unsigned nplanes)
+  {
+    vil_image_view<T> view;
+    if (py::isinstance<vil_image_view_base>(tile)) {
+      view = tile.cast<vil_image_view_base const&>();
+    }
+    else {
+      std::unique_ptr<vil_image_view<T> > adopted(image_from_buffer<T>(tile.cast<py::array_t<T> >(), false));
+      view = *adopted;
+    }
+    if (view.ni() != window.ni || view.nj() != window.nj || view.nplanes() != nplanes) {
+      throw std::runtime_error("read_tiles: a tile is not the size of its window");
+    }
+    return new vil_image_view<T>(view);
+  }
+};
+
+/* Trampoline for tile_image_resource. Only read_tiles calls back into
+ * Python, once for every window of a read; the size and format of the image
+ * are answered in C++. */
+class PyTileImageResource : public tile_image_resource {
+public:
+  using tile_image_resource::tile_image_resource;
+
+  std::vector<vil_image_view_base_sptr> read_tiles(std::vector<image_window> const& windows) const override
+  {
+    // vil may read from a thread not holding the GIL
+    py::gil_scoped_acquire acquire;
+    py::function read = py::get_overload(static_cast<tile_image_resource const*>(this), "read_tiles");
+    if (!read) {
+      throw std::runtime_error("tile_image_resource: read_tiles is not implemented, "
+                               "or the Python object is gone");
+    }
+
+    py::array_t<long long> w({static_cast<py::ssize_t>(windows.size()), py::ssize_t(4)});
+    long long* p = w.mutable_data();
+    for (image_window const& window : windows) {
+      *p++ = window.i0;
+      *p++ = window.ni;
+      *p++ = window.j0;
+      *p++ = window.nj;
+    }
+    py::sequence tiles = read(w);
+    if (tiles.size() != windows.size()) {
+      throw std::runtime_error("read_tiles: expected one tile per window");
+    }
+
+    const unsigned nplanes = this->nplanes() * vil_pixel_format_num_components(pixel_format());
+    std::vector<vil_image_view_base_sptr> views;
+    views.reserve(windows.size());
+    for (std::size_t k = 0; k < windows.size(); ++k) {
+      views.push_back(dispatch_component_type<adopt_tile_op>(pixel_format(), py::object(tiles[k]),
+                                                                   windows[k], nplanes));
+    }
+    return views;
+  }
+};
+
+
+// One axis of an index into a view: a single position, or a slice
+struct index_range {
+  std::ptrdiff_t start, step;
+  std::size_t n;
+  bool scalar;
+};
+
+index_range index_axis(py::handle key, std::size_t size)
+{
+  if (py::isinstance<py::slice>(key)) {
+    size_t start, stop, step, n;
+    if (!py::reinterpret_borrow<py::slice>(key).compute(size, &start, &stop, &step, &n)) {
+      throw py::error_already_set();
+    }
+    // a negative step comes back wrapped around, so cast it back
+    return index_range{static_cast<std::ptrdiff_t>(start), static_cast<std::ptrdiff_t>(step), n, false};
+  }
+
+  // negative positions count back from the end, as in numpy
+  std::ptrdiff_t i = key.cast<std::ptrdiff_t>();
+  if (i < 0) {
+    i += static_cast<std::ptrdiff_t>(size);
+  }
+  if (i < 0 || i >= static_cast<std::ptrdiff_t>(size)) {
+    throw py::index_error("image view index out of range");
+  }
+  return index_range{i, 1, 1, true};
+}
+
+/* img[y, x, p] with each of y, x and p either an int or a slice, in the
+ * order of the numpy shape. Missing trailing indices select everything.
+ * Indexing a single pixel (with p optional for a one plane view) returns
+ * its value; anything else returns a view sharing img's memory, with the
+ * origin and steps adjusted as vil_crop does, so nothing is copied. */
 template<class T>
-T image_getitem(vil_image_view<T> const& img, std::tuple<size_t, size_t, size_t> pos)
+py::object image_getitem(vil_image_view<T> const& img, py::object const& key)
 {
-  // TODO: wrap around
-  size_t img_y = std::get<0>(pos);
-  size_t img_x = std::get<1>(pos);
-  size_t img_p = std::get<2>(pos);
-  return img(img_x, img_y, img_p);
+  py::tuple keys = py::isinstance<py::tuple>(key) ? py::reinterpret_borrow<py::tuple>(key)
+                                                  : py::make_tuple(key);
+  if (keys.size() > 3) {
+    throw py::index_error("too many indices for an image view");
+  }
+
+  const std::size_t sizes[3] = {img.nj(), img.ni(), img.nplanes()};
+  index_range r[3];
+  bool all_scalar = true;
+  for (std::size_t k = 0; k < 3; ++k) {
+    if (k < keys.size()) {
+      r[k] = index_axis(keys[k], sizes[k]);
+      all_scalar = all_scalar && r[k].scalar;
+    }
+    else {
+      r[k] = index_range{0, 1, sizes[k], false};
+    }
+  }
+  const index_range& rj = r[0];
+  const index_range& ri = r[1];
+  const index_range& rp = r[2];
+
+  if (all_scalar && (keys.size() == 3 || img.nplanes() == 1)) {
+    return py::cast(img(ri.start, rj.start, rp.start));
+  }
+  if (ri.n == 0 || rj.n == 0 || rp.n == 0) {
+    return py::cast(vil_image_view<T>());
+  }
+  return py::cast(vil_image_view<T>(img.memory_chunk(), &img(ri.start, rj.start, rp.start),
+                                    ri.n, rj.n, rp.n,
+                                    img.istep() * ri.step, img.jstep() * rj.step,
+                                    img.planestep() * rp.step));
+}
+
+template<class T>
+vil_image_view<T> image_crop(vil_image_view<T> const& img, unsigned i0, unsigned n_i, unsigned j0, unsigned n_j)
+{
+  if (std::size_t(i0) + n_i > img.ni() || std::size_t(j0) + n_j > img.nj()) {
+    throw std::out_of_range("crop: window is outside the image");
+  }
+  return vil_crop(img, i0, n_i, j0, n_j);
+}
+
+// Views in shared memory pickle as where their pixels are, so unpickling
+// maps the same pixels; any other view pickles a copy of its pixels
+template<class T>
+py::tuple image_getstate(vil_image_view<T> const& img)
+{
+  shared_view_state s;
+  if (shared_view_state_of(img, s)) {
+    return py::make_tuple("shared", s.name, s.offset, s.ni, s.nj, s.nplanes, s.istep, s.jstep, s.planestep);
+  }
+  std::string pixels(std::size_t(img.ni()) * img.nj() * img.nplanes() * sizeof(T), '\0');
+  char* out = &pixels[0];
+  for (unsigned p = 0; p < img.nplanes(); ++p) {
+    for (unsigned j = 0; j < img.nj(); ++j) {
+      if (img.istep() == 1) {
+        std::memcpy(out, &img(0, j, p), img.ni() * sizeof(T));
+        out += img.ni() * sizeof(T);
+        continue;
+      }
+      for (unsigned i = 0; i < img.ni(); ++i, out += sizeof(T)) {
+        std::memcpy(out, &img(i, j, p), sizeof(T));
+      }
+    }
+  }
+  return py::make_tuple("copy", img.ni(), img.nj(), img.nplanes(), py::bytes(pixels));
+}
+
+template<class T>
+vil_image_view<T> image_setstate(py::tuple const& state)
+{
+  const std::string kind = state.size() > 0 ? state[0].cast<std::string>() : std::string();
+  if (kind == "shared" && state.size() == 9) {
+    shared_view_state s{state[1].cast<std::string>(), state[2].cast<std::size_t>(),
+                        state[3].cast<unsigned>(), state[4].cast<unsigned>(), state[5].cast<unsigned>(),
+                        state[6].cast<std::ptrdiff_t>(), state[7].cast<std::ptrdiff_t>(),
+                        state[8].cast<std::ptrdiff_t>()};
+    return vil_image_view<T>(open_shared_view(s, vil_pixel_format_of(T())));
+  }
+  if (kind == "copy" && state.size() == 5) {
+    vil_image_view<T> img(state[1].cast<unsigned>(), state[2].cast<unsigned>(), state[3].cast<unsigned>());
+    const std::string pixels = state[4].cast<std::string>();
+    if (pixels.size() != std::size_t(img.ni()) * img.nj() * img.nplanes() * sizeof(T)) {
+      throw std::runtime_error("Can't unpickle image view: wrong number of pixels");
+    }
+    if (!pixels.empty()) {
+      std::memcpy(img.top_left_ptr(), pixels.data(), pixels.size());
+    }
+    return img;
+  }
+  throw std::runtime_error("Can't unpickle image view: unknown state");
+}
+
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> point_array;
+
+std::size_t check_points(point_array const& points, char const* name)
+{
+  if (points.ndim() != 2 || points.shape(1) != 2) {
+    throw std::invalid_argument(std::string(name) + ": points must be an N x 2 array of (i, j)");
+  }
+  return points.shape(0);
+}
+
+template<class T>
+py::array_t<double> image_sample(vil_image_view<T> const& img, point_array const& points,
+                                 std::string const& interp, double fill)
+{
+  const std::size_t n = check_points(points, "sample");
+  const interpolation mode = interpolation_from_name(interp);
+
+  // one value per point for a single plane, like numpy indexing
+  const unsigned nplanes = img.nplanes() * vil_pixel_format_num_components(img.pixel_format());
+  std::vector<py::ssize_t> shape {static_cast<py::ssize_t>(n)};
+  if (nplanes > 1) {
+    shape.push_back(nplanes);
+  }
+  py::array_t<double> values(shape);
+  double const* p = points.data();
+  double* dest = values.mutable_data();
+  {
+    py::gil_scoped_release release;
+    // compound pixels (e.g. RGB) are sampled as planes of their components
+    sample_points(vil_image_view<typename pixel_component<T>::type>(img), p, n, mode, fill, dest);
+  }
+  return values;
+}
+
+template<class T>
+void image_scatter(vil_image_view<T>& img, point_array const& points, point_array const& values,
+                   std::string const& mode_name)
+{
+  const std::size_t n = check_points(points, "scatter");
+  const scatter_mode mode = scatter_mode_from_name(mode_name);
+
+  // compound pixels (e.g. RGB) are written as planes of their components
+  vil_image_view<typename pixel_component<T>::type> planes(img);
+  unsigned value_planes;
+  if (values.ndim() == 1 && static_cast<std::size_t>(values.shape(0)) == n) {
+    value_planes = 1;
+  }
+  else if (values.ndim() == 2 && static_cast<std::size_t>(values.shape(0)) == n &&
+           static_cast<std::size_t>(values.shape(1)) == planes.nplanes()) {
+    value_planes = planes.nplanes();
+  }
+  else {
+    throw std::invalid_argument("scatter: values must have one entry per point, or one per point and plane");
+  }
+
+  double const* p = points.data();
+  double const* v = values.data();
+  py::gil_scoped_release release;
+  scatter_points(planes, p, n, v, value_planes, mode);
 }
 
 template<class T>
@@ -294,13 +640,14 @@ py::buffer_info get_image_buffer(vil_image_view<T> &img)
 {
   size_t nbytes = sizeof(T);
   int ndim = 2;
-  std::vector<size_t> img_shape {img.nj(), img.ni()};
-  std::vector<size_t> img_stride {static_cast<size_t>(img.jstep()) * nbytes,
-                                  static_cast<size_t>(img.istep()) * nbytes};
+  std::vector<py::ssize_t> img_shape {img.nj(), img.ni()};
+  // steps are negative in views of slices with a negative step
+  std::vector<py::ssize_t> img_stride {img.jstep() * static_cast<py::ssize_t>(nbytes),
+                                       img.istep() * static_cast<py::ssize_t>(nbytes)};
   if (img.nplanes() > 1) {
     ndim = 3;
     img_shape.push_back(img.nplanes());
-    img_stride.push_back(static_cast<size_t>(img.planestep()) * nbytes);
+    img_stride.push_back(img.planestep() * static_cast<py::ssize_t>(nbytes));
   }
   return py::buffer_info(img.top_left_ptr(), sizeof(T),
                          py::format_descriptor<T>::format(),
@@ -314,12 +661,29 @@ void wrap_vil_image_view(py::module &m, std::string const& class_name)
     .def(py::init<>())
     .def(py::init<unsigned int,unsigned int>())
     .def(py::init<unsigned int,unsigned int,unsigned int>())
-    .def(py::init(&image_from_buffer<T>))
+    .def(py::init(&image_from_buffer<T>), py::arg("buffer"), py::arg("copy") = false,
+         "Wrap a numpy array without copying its pixels, unless copy is True, "
+         "the array is read only or its strides cannot be represented by a vil "
+         "view. An array of another dtype raises TypeError unless copy is True, "
+         "in which case it is converted.")
     .def("__len__", image_len<T>)
-    .def("__getitem__", image_getitem<T>)
+    .def("__getitem__", image_getitem<T>,
+         "img[y, x, p] with ints or slices. A single pixel returns its value, "
+         "anything else a view sharing the memory of img.")
+    .def("sample", image_sample<T>, py::arg("points"), py::arg("interp") = "nearest",
+         py::arg("fill") = std::numeric_limits<double>::quiet_NaN(),
+         "Values of every plane at an N x 2 array of (i, j) points, interpolated \"nearest\", "
+         "\"bilinear\" or \"bicubic\". Points outside the image get fill.")
+    .def("scatter", image_scatter<T>, py::arg("points"), py::arg("values"), py::arg("mode") = "set",
+         "Set (mode \"set\") or add to (mode \"add\") the pixels nearest an N x 2 array of (i, j) "
+         "points. values has one value per point, or one per point and plane. "
+         "Points outside the image are skipped, and later points win.")
+    .def("crop", image_crop<T>, py::arg("i0"), py::arg("ni"), py::arg("j0"), py::arg("nj"),
+         "The window of ni x nj pixels from (i0, j0), sharing the memory of the view")
     .def_property_readonly("shape", &image_view_shape<T>)
     .def_buffer(get_image_buffer<T>)
-    .def("deep_copy", &vil_image_view<T>::deep_copy);
+    .def("deep_copy", &vil_image_view<T>::deep_copy)
+    .def(py::pickle(&image_getstate<T>, &image_setstate<T>));
 }
 
 vil_image_view<unsigned char> load_byte(std::string filename)
@@ -342,141 +706,1004 @@ vil_image_view<int> load_int(std::string filename)
   return vil_convert_stretch_range(int(), vil_load(filename.c_str()));
 }
 
-vil_image_resource_sptr vil_load_image_resource_wrapper(std::string const& filename)
+// Cast a view to the wrapped image_view_* class for pixel format F
+template <vil_pixel_format F>
+py::object native_view(vil_image_view_base_sptr const& base)
 {
-  return vil_load_image_resource(filename.c_str());
+  using pixel_type = typename vil_pixel_format_type_of<F>::type;
+  return py::cast(vil_image_view<pixel_type>(base));
 }
 
+using native_view_function = py::object (*)(vil_image_view_base_sptr const&);
+
+struct native_view_entry {
+  vil_pixel_format format;
+  native_view_function make_view;
+};
+
+// Compile time table of the pixel formats which have a wrapped view type
+constexpr native_view_entry native_view_table[] = {
+  {VIL_PIXEL_FORMAT_BYTE, &native_view<VIL_PIXEL_FORMAT_BYTE>},
+  {VIL_PIXEL_FORMAT_UINT_16, &native_view<VIL_PIXEL_FORMAT_UINT_16>},
+  {VIL_PIXEL_FORMAT_FLOAT, &native_view<VIL_PIXEL_FORMAT_FLOAT>},
+  {VIL_PIXEL_FORMAT_INT_32, &native_view<VIL_PIXEL_FORMAT_INT_32>},
+  {VIL_PIXEL_FORMAT_INT_16, &native_view<VIL_PIXEL_FORMAT_INT_16>},
+  {VIL_PIXEL_FORMAT_DOUBLE, &native_view<VIL_PIXEL_FORMAT_DOUBLE>},
+  {VIL_PIXEL_FORMAT_RGB_BYTE, &native_view<VIL_PIXEL_FORMAT_RGB_BYTE>},
+};
+
+py::object as_native_view(vil_image_view_base_sptr const& base, std::string const& name)
+{
+  for (auto const& entry : native_view_table) {
+    if (entry.format == base->pixel_format()) {
+      return entry.make_view(base);
+    }
+  }
+  std::ostringstream buffer;
+  buffer << "No image view type wraps pixel format " << base->pixel_format()
+         << " of " << name;
+  throw std::runtime_error(buffer.str());
+}
+
+// base as a view of T, converted with rounding and saturation when its
+// pixels are of another type. Compound pixels of T's type are seen as planes.
 template <class T>
-void vil_save_wrapper(vil_image_view<T> const& img, std::string const& filename)
+vil_image_view<T> view_as(vil_image_view_base_sptr const& base)
 {
-  bool result = vil_save(img, filename.c_str());
+  const vil_pixel_format format = vil_pixel_format_of(T());
+  if (!base || base->pixel_format() == format ||
+      vil_pixel_format_component_format(base->pixel_format()) == format) {
+    return base ? vil_image_view<T>(*base) : vil_image_view<T>();
+  }
+  py::gil_scoped_release release;
+  return vil_image_view<T>(convert_view(*base, format, conversion_rounding::nearest, true));
+}
 
-  if ( !result ) {
-    std::ostringstream buffer;
-    buffer << "Failed to save image to " << filename << std::endl;
-    throw std::runtime_error(buffer.str());
+// A window of r. Resources safe to read from several threads at once are
+// read without the GIL, any other keeps it, which serialises their reads.
+vil_image_view_base_sptr read_window(vil_image_resource const& r, unsigned i0, unsigned n_i,
+                                     unsigned j0, unsigned n_j, bool copy)
+{
+  if (reads_concurrently(r)) {
+    py::gil_scoped_release release;
+    return copy ? r.get_copy_view(i0, n_i, j0, n_j) : r.get_view(i0, n_i, j0, n_j);
   }
+  return copy ? r.get_copy_view(i0, n_i, j0, n_j) : r.get_view(i0, n_i, j0, n_j);
 }
 
 template <class T>
-double vil_image_sum_wrapper(vil_image_view<T> const& image, unsigned p = 0)
+vil_image_view<T> resource_view(vil_image_resource const& r)
 {
-  // compute the sum of elements in plane p of image
+  return view_as<T>(read_window(r, 0, r.ni(), 0, r.nj(), false));
+}
 
-  // store result in reference
-  double sum = 0.0;
-  vil_math_sum(sum, image, p);
+template <class T>
+vil_image_view<T> resource_window(vil_image_resource const& r, unsigned i0, unsigned n_i, unsigned j0, unsigned n_j)
+{
+  return view_as<T>(read_window(r, i0, n_i, j0, n_j, false));
+}
 
-  return sum;
+template <class T>
+vil_image_view<T> resource_copy_view(vil_image_resource const& r)
+{
+  return view_as<T>(read_window(r, 0, r.ni(), 0, r.nj(), true));
 }
 
 template <class T>
-vil_image_view<unsigned char> vil_stretch_image_to_byte_wrapper(vil_image_view<T> const& image, float min_limit, float max_limit)
+vil_image_view<T> resource_copy_window(vil_image_resource const& r, unsigned i0, unsigned n_i, unsigned j0, unsigned n_j)
 {
-  // convert input image to float
-  vil_image_view<float> fimage;
+  return view_as<T>(read_window(r, i0, n_i, j0, n_j, true));
+}
 
-  // if the src imagery is already of type float then vil_convert_cast simply does a
-  // shallow copy. so as not to modify the original imagery, make a deep copy
-  if( vil_pixel_format_component_format(image.pixel_format()) ==
-      VIL_PIXEL_FORMAT_FLOAT) {
-    fimage.deep_copy(image);
+py::object load_native(std::string const& filename)
+{
+  // decode without the GIL, and without converting the pixels
+  vil_image_view_base_sptr base;
+  {
+    py::gil_scoped_release release;
+    base = vil_load(filename.c_str());
   }
-  else {
-    vil_convert_cast(image, fimage);
+  if (!base) {
+    throw std::runtime_error("Failed to load image " + filename);
   }
+  return as_native_view(base, filename);
+}
 
-  unsigned ni = fimage.ni(), nj = fimage.nj(), np = fimage.nplanes();
+// Stretch a freshly loaded image to vil_type, as load_byte etc. do. An
+// empty vil_type keeps the native pixel format.
+vil_image_view_base_sptr convert_loaded(vil_image_view_base_sptr const& base, std::string const& vil_type)
+{
+  if (vil_type.empty()) {
+    return base;
+  }
+  else if (vil_type == "byte") {
+    return vil_convert_stretch_range(vxl_byte(), base);
+  }
+  else if (vil_type == "short") {
+    return vil_convert_stretch_range(vxl_uint_16(), base);
+  }
+  else if (vil_type == "float") {
+    return vil_convert_stretch_range(float(), base);
+  }
+  else if (vil_type == "int") {
+    return vil_convert_stretch_range(int(), base);
+  }
+  throw std::invalid_argument("Unknown vil_type <" + vil_type + ">");
+}
 
-  // stretch out float image to cover full [0,255] range
-  float scale = 255.0f / (max_limit - min_limit);
-  for(unsigned j = 0; j<nj; ++j)
-    for(unsigned i = 0; i<ni; ++i)
-      for(unsigned p = 0; p<np; ++p){
-        float v = scale * (fimage(i,j,p) - min_limit);
-        if(v > 255.0f) v = 255.0f; if(v < 0.0f) v = 0.0f;
-        fimage(i,j,p) = v;
+py::tuple load_many(std::vector<std::string> const& filenames, std::string const& vil_type,
+                    unsigned num_threads)
+{
+  // check vil_type up front, rather than failing every file
+  if (!vil_type.empty() && vil_type != "byte" && vil_type != "short" &&
+      vil_type != "float" && vil_type != "int") {
+    throw std::invalid_argument("Unknown vil_type <" + vil_type + ">");
+  }
+
+  std::vector<vil_image_view_base_sptr> images(filenames.size());
+  std::vector<std::string> errors(filenames.size());
+  {
+    py::gil_scoped_release release;
+
+    // populate the file format registry before several threads look at it
+    vil_file_format::all();
+
+    std::shared_ptr<thread_pool> pool = num_threads ? std::make_shared<thread_pool>(num_threads)
+                                                    : default_thread_pool();
+    pool->run(filenames.size(), [&](std::size_t k) {
+      try {
+        vil_image_view_base_sptr base = vil_load(filenames[k].c_str());
+        if (!base) {
+          throw std::runtime_error("Failed to load image " + filenames[k]);
+        }
+        images[k] = convert_loaded(base, vil_type);
+      }
+      catch (std::exception const& e) {
+        errors[k] = e.what();
       }
+    });
+  }
 
-  // convert to byte image
-  vil_image_view<unsigned char> byte_image;
-  vil_convert_cast(fimage, byte_image);
+  py::list views, messages;
+  for (std::size_t k = 0; k < filenames.size(); ++k) {
+    // a pixel type without a view class fails that file, not the batch
+    py::object view = py::none();
+    if (images[k]) {
+      try {
+        view = as_native_view(images[k], filenames[k]);
+      }
+      catch (std::exception const& e) {
+        errors[k] = e.what();
+      }
+    }
+    views.append(view);
+    if (view.is_none()) {
+      messages.append(errors[k]);
+    }
+    else {
+      messages.append(py::none());
+    }
+  }
+  return py::make_tuple(views, messages);
+}
 
-  return byte_image;
+py::bytes encode_wrapper(vil_image_view_base const& view, std::string const& file_format, py::object const& options)
+{
+  encode_options settings;
+  if (!options.is_none()) {
+    for (auto item : options.cast<py::dict>()) {
+      const std::string key = item.first.cast<std::string>();
+      if (key == "quality") {
+        settings.jpeg_quality = item.second.cast<int>();
+      }
+      else {
+        throw std::invalid_argument("encode: unknown option " + key);
+      }
+    }
+  }
+  std::string data;
+  {
+    py::gil_scoped_release release;
+    data = encode_view(view, file_format, settings);
+  }
+  return py::bytes(data);
 }
 
-template <class T>
-vil_image_view<unsigned short int> vil_stretch_image_to_short_wrapper(vil_image_view<T> const& image, float min_limit, float max_limit)
+py::object decode_wrapper(std::string const& data, py::object const& vil_type, bool as_resource)
+{
+  if (as_resource) {
+    if (!vil_type.is_none()) {
+      throw std::invalid_argument("decode: vil_type can't be given with as_resource");
+    }
+    vil_image_resource_sptr resource;
+    {
+      py::gil_scoped_release release;
+      resource = decode_resource(data);
+    }
+    return py::cast(resource);
+  }
+  const std::string type = vil_type.is_none() ? std::string() : vil_type.cast<std::string>();
+  vil_image_view_base_sptr view;
+  {
+    py::gil_scoped_release release;
+    view = convert_loaded(decode_view(data), type);
+  }
+  return as_native_view(view, "the decoded image");
+}
+
+vil_pyramid_image_resource_sptr load_pyramid_resource(std::string const& directory_or_file)
+{
+  vil_pyramid_image_resource_sptr pyramid;
+  {
+    py::gil_scoped_release release;
+    pyramid = vil_load_pyramid_resource(directory_or_file.c_str(), false);
+  }
+  if (!pyramid) {
+    throw std::runtime_error("Failed to load pyramid image " + directory_or_file);
+  }
+  return pyramid;
+}
+
+vil_pyramid_image_resource_sptr build_pyramid_wrapper(vil_image_resource_sptr const& source,
+                                                      std::string const& directory, unsigned n_levels,
+                                                      std::string const& kernel, unsigned tile_size,
+                                                      std::string const& file_format)
+{
+  pyramid_kernel k;
+  if (kernel == "box") {
+    k = pyramid_kernel::box;
+  }
+  else if (kernel == "gaussian") {
+    k = pyramid_kernel::gaussian;
+  }
+  else {
+    throw std::invalid_argument("Unknown pyramid kernel <" + kernel + ">");
+  }
+
+  {
+    py::gil_scoped_release release;
+    build_pyramid(source, directory, n_levels, k, tile_size, file_format);
+  }
+  return load_pyramid_resource(directory);
+}
+
+typedef py::array_t<long long, py::array::c_style | py::array::forcecast> cell_array;
+
+// Warp source through a grid of source positions, sampled every step
+// pixels, into a new view, or into a tiled file when filename is given.
+// cells is an N x 2 array of (gi, gj) cells of the grid known exactly, with
+// the position of each of their pixels in the N x (step + 1) x (step + 1)
+// x 2 array cell_positions. The arrays are borrowed, not copied.
+py::object warp_wrapper(vil_image_resource_sptr const& source, point_array const& grid, unsigned step,
+                        unsigned ni, unsigned nj, std::string const& interp, double fill,
+                        std::string const& filename, unsigned tile_size, std::string const& file_format,
+                        cell_array const& cells, point_array const& cell_positions)
 {
-  // convert input image to float
-  vil_image_view<float> fimage;
+  if (!source) {
+    throw std::invalid_argument("warp: null image resource");
+  }
+  if (grid.ndim() != 3 || grid.shape(2) != 2) {
+    throw std::invalid_argument("warp: grid must be an nj x ni x 2 array of (i, j)");
+  }
+  warp_grid g;
+  g.nj = static_cast<unsigned>(grid.shape(0));
+  g.ni = static_cast<unsigned>(grid.shape(1));
+  g.step = step;
+  g.coords = grid.data();
+
+  const py::ssize_t cell_size = py::ssize_t(step) + 1;
+  if (cells.ndim() != 2 || cells.shape(1) != 2 || cell_positions.ndim() != 4 ||
+      cell_positions.shape(0) != cells.shape(0) || cell_positions.shape(1) != cell_size ||
+      cell_positions.shape(2) != cell_size || cell_positions.shape(3) != 2) {
+    throw std::invalid_argument("warp: need N x 2 cells and N x (step + 1) x (step + 1) x 2 cell positions");
+  }
+  for (py::ssize_t k = 0; k < cells.shape(0); ++k) {
+    const long long gi = cells.at(k, 0), gj = cells.at(k, 1);
+    if (gi < 0 || gj < 0 || gi + 1 >= g.ni || gj + 1 >= g.nj) {
+      throw std::invalid_argument("warp: cell outside the grid");
+    }
+    g.exact_cells[std::size_t(gj) * g.ni + std::size_t(gi)] = cell_positions.data(k);
+  }
+  const interpolation mode = interpolation_from_name(interp);
 
-  // if the src imagery is already of type float then vil_convert_cast simply does a
-  // shallow copy. so as not to modify the original imagery, make a deep copy
-  if( vil_pixel_format_component_format(image.pixel_format()) ==
-      VIL_PIXEL_FORMAT_FLOAT) {
-    fimage.deep_copy(image);
+  const vil_pixel_format format = vil_pixel_format_component_format(source->pixel_format());
+  const unsigned nplanes = source->nplanes() * vil_pixel_format_num_components(source->pixel_format());
+  vil_image_resource_sptr output;
+  if (filename.empty()) {
+    output = vil_new_image_resource(ni, nj, nplanes, format);
   }
   else {
-    vil_convert_cast(image, fimage);
+    output = vil_new_blocked_image_resource(filename.c_str(), ni, nj, nplanes, format,
+                                            tile_size, tile_size, file_format.c_str()).ptr();
+  }
+  if (!output) {
+    throw std::runtime_error("warp: failed to create the output image " + filename);
+  }
+
+  {
+    py::gil_scoped_release release;
+    warp_resource(source, g, mode, fill, output, tile_size);
+  }
+  if (filename.empty()) {
+    return as_native_view(output->get_view(), "warp output");
+  }
+  return py::cast(output);
+}
+
+py::object warp_view_wrapper(vil_image_view_base const& source, point_array const& grid, unsigned step,
+                             unsigned ni, unsigned nj, std::string const& interp, double fill,
+                             std::string const& filename, unsigned tile_size, std::string const& file_format,
+                             cell_array const& cells, point_array const& cell_positions)
+{
+  return warp_wrapper(vil_new_image_resource_of_view(source), grid, step, ni, nj, interp, fill,
+                      filename, tile_size, file_format, cells, cell_positions);
+}
+
+vil_pixel_format pipeline_format(std::string const& vil_type)
+{
+  if (vil_type == "byte") {
+    return VIL_PIXEL_FORMAT_BYTE;
+  }
+  else if (vil_type == "short") {
+    return VIL_PIXEL_FORMAT_UINT_16;
+  }
+  else if (vil_type == "float") {
+    return VIL_PIXEL_FORMAT_FLOAT;
+  }
+  else if (vil_type == "int") {
+    return VIL_PIXEL_FORMAT_INT_32;
+  }
+  throw std::invalid_argument("Unknown vil_type <" + vil_type + ">");
+}
+
+vil_pixel_format pipeline_format_of(pipeline_node_sptr const& node)
+{
+  return vil_pixel_format_component_format(node->pixel_format());
+}
+
+// A number, or a sequence of one number per plane
+std::vector<double> pipeline_values(py::object const& value)
+{
+  if (py::isinstance<py::sequence>(value)) {
+    return value.cast<std::vector<double> >();
   }
+  return std::vector<double>(1, value.cast<double>());
+}
 
-  unsigned ni = fimage.ni(), nj = fimage.nj(), np = fimage.nplanes();
+// The pixel format of a vil_type of vil.convert
+vil_pixel_format conversion_format(std::string const& vil_type)
+{
+  if (vil_type == "int16") {
+    return VIL_PIXEL_FORMAT_INT_16;
+  }
+  else if (vil_type == "double") {
+    return VIL_PIXEL_FORMAT_DOUBLE;
+  }
+  else if (vil_type == "rgb_byte") {
+    return VIL_PIXEL_FORMAT_RGB_BYTE;
+  }
+  return pipeline_format(vil_type);
+}
+
+typedef py::array_t<long long, py::array::c_style | py::array::forcecast> window_array;
 
-  float scale = 65536.0f / (max_limit - min_limit);
-  for(unsigned j = 0; j<nj; ++j)
-    for(unsigned i = 0; i<ni; ++i)
-      for(unsigned p = 0; p<np; ++p){
-        float v = scale * (fimage(i,j,p) - min_limit);
-        if(v > 65536.0f) v= 65536.0f; if(v < 0.0f) v = 0.0f;
-        fimage(i,j,p) = v;
+// windows as (i0, ni, j0, nj), checked for a function called name
+std::vector<image_window> check_windows(window_array const& windows, std::string const& name)
+{
+  if (windows.ndim() != 2 || windows.shape(1) != 4) {
+    throw std::invalid_argument(name + ": windows must be an N x 4 array of (i0, ni, j0, nj)");
+  }
+  const std::size_t n = windows.shape(0);
+  long long const* p = windows.data();
+  std::vector<image_window> result(n);
+  for (std::size_t k = 0; k < n; ++k, p += 4) {
+    for (unsigned c = 0; c < 4; ++c) {
+      if (p[c] < 0 || p[c] > std::numeric_limits<unsigned>::max()) {
+        throw std::out_of_range(name + ": window " + std::to_string(k) + " is not within the image");
       }
+    }
+    result[k] = image_window{unsigned(p[0]), unsigned(p[1]), unsigned(p[2]), unsigned(p[3])};
+  }
+  return result;
+}
 
-  // convert to short image
-  vil_image_view<unsigned short int> short_image;
-  vil_convert_cast(fimage, short_image);
+// A view of n windows of ni x nj stacked top to bottom, and a view of each
+// window within it in windows
+template <class T>
+struct window_stack_op {
+  static vil_image_view_base_sptr run(std::size_t n, unsigned ni, unsigned nj, unsigned nplanes,
+                                      std::vector<vil_image_view_base_sptr>& windows)
+  {
+    vil_image_view<T> stack(ni, static_cast<unsigned>(n * nj), nplanes);
+    for (std::size_t k = 0; k < n; ++k) {
+      windows.push_back(new vil_image_view<T>(vil_crop(stack, 0, ni, static_cast<unsigned>(k * nj), nj)));
+    }
+    return new vil_image_view<T>(stack);
+  }
+};
 
-  return short_image;
+// A stack of n windows as an n x nj x ni (x nplanes) numpy array sharing
+// its memory, which owner keeps alive
+template <class T>
+struct window_stack_array_op {
+  static py::array run(vil_image_view_base const& base, std::size_t n, py::object const& owner)
+  {
+    vil_image_view<T> stack(base);
+    const std::size_t nj = n ? stack.nj() / n : 0;
+    const py::ssize_t size = sizeof(T);
+    std::vector<py::ssize_t> shape {py::ssize_t(n), py::ssize_t(nj), stack.ni()};
+    std::vector<py::ssize_t> strides {py::ssize_t(nj) * stack.jstep() * size, stack.jstep() * size,
+                                      stack.istep() * size};
+    if (stack.nplanes() > 1) {
+      shape.push_back(stack.nplanes());
+      strides.push_back(stack.planestep() * size);
+    }
+    return py::array_t<T>(shape, strides, stack.top_left_ptr(), owner);
+  }
+};
+
+py::object resource_get_views(vil_image_resource const& r, window_array const& windows,
+                              py::object const& vil_type, bool stack)
+{
+  const std::vector<image_window> w = check_windows(windows, "get_views");
+  const vil_pixel_format native = vil_pixel_format_component_format(r.pixel_format());
+  const vil_pixel_format format = vil_type.is_none() ? native : conversion_format(vil_type.cast<std::string>());
+  if (vil_pixel_format_num_components(format) != 1) {
+    throw std::invalid_argument("get_views: vil_type must have one component per pixel");
+  }
+  // resources which can't be read from several threads keep the GIL, as in read_window
+  const bool concurrent = reads_concurrently(r);
+
+  if (!stack) {
+    std::vector<vil_image_view_base_sptr> views;
+    if (concurrent) {
+      py::gil_scoped_release release;
+      views = read_windows(r, w);
+    }
+    else {
+      views = read_windows(r, w);
+    }
+    if (format != native) {
+      py::gil_scoped_release release;
+      for (auto& view : views) {
+        view = convert_view(*view, format, conversion_rounding::nearest, true);
+      }
+    }
+    py::list result;
+    for (auto const& view : views) {
+      result.append(as_native_view(view, "the window"));
+    }
+    return result;
+  }
+
+  const unsigned ni = w.empty() ? 0 : w[0].ni, nj = w.empty() ? 0 : w[0].nj;
+  for (image_window const& window : w) {
+    if (window.ni != ni || window.nj != nj) {
+      throw std::invalid_argument("get_views: only windows of the same size can be stacked");
+    }
+  }
+  if (std::size_t(nj) * w.size() > std::numeric_limits<unsigned>::max()) {
+    throw std::invalid_argument("get_views: too many windows to stack");
+  }
+  const unsigned nplanes = r.nplanes() * vil_pixel_format_num_components(r.pixel_format());
+  std::vector<vil_image_view_base_sptr> slots;
+  vil_image_view_base_sptr all = dispatch_component_type<window_stack_op>(native, w.size(), ni, nj, nplanes, slots);
+  if (concurrent) {
+    py::gil_scoped_release release;
+    read_windows(r, w, slots);
+  }
+  else {
+    read_windows(r, w, slots);
+  }
+  slots.clear();
+  if (format != native) {
+    py::gil_scoped_release release;
+    all = convert_view(*all, format, conversion_rounding::nearest, true);
+  }
+  return dispatch_component_type<window_stack_array_op>(format, *all, w.size(),
+                                                        as_native_view(all, "the stacked windows"));
 }
 
+// The pixels of a view as an nj x ni (x nplanes) numpy array sharing its
+// memory, which owner keeps alive
 template <class T>
-vil_image_view<float> vil_stretch_image_to_float_wrapper(vil_image_view<T> const& image, float min_limit, float max_limit)
+struct view_array_op {
+  static py::array run(vil_image_view_base const& base, py::object const& owner)
+  {
+    vil_image_view<T> view(base);
+    const py::ssize_t size = sizeof(T);
+    std::vector<py::ssize_t> shape {view.nj(), view.ni()};
+    std::vector<py::ssize_t> strides {view.jstep() * size, view.istep() * size};
+    if (view.nplanes() > 1) {
+      shape.push_back(view.nplanes());
+      strides.push_back(view.planestep() * size);
+    }
+    return py::array_t<T>(shape, strides, view.top_left_ptr(), owner);
+  }
+};
+
+py::object integral_table(py::object const& self, bool squares)
 {
+  integral_image const& image = self.cast<integral_image const&>();
+  vil_image_view_base_sptr table = squares ? image.squares() : image.sums();
+  if (!table) {
+    return py::none();
+  }
+  return dispatch_component_type<view_array_op>(table->pixel_format(), *table, self);
+}
 
-  // convert input image to float
-  vil_image_view<float> fimage;
+py::array_t<double> box_statistics_wrapper(integral_image const& image, window_array const& boxes,
+                                           box_statistic statistic, std::string const& name)
+{
+  const std::vector<image_window> b = check_windows(boxes, name);
+  std::vector<py::ssize_t> shape {static_cast<py::ssize_t>(b.size())};
+  if (image.nplanes() > 1) {
+    shape.push_back(image.nplanes());
+  }
+  py::array_t<double> result(shape);
+  double* out = result.mutable_data();
+  {
+    py::gil_scoped_release release;
+    box_statistics(image, b, statistic, out);
+  }
+  return result;
+}
 
-  // if the src imagery is already of type float then vil_convert_cast simply does a
-  // shallow copy. so as not to modify the original imagery, make a deep copy
-  if( vil_pixel_format_component_format(image.pixel_format()) ==
-      VIL_PIXEL_FORMAT_FLOAT) {
-    fimage.deep_copy(image);
+py::object convert_wrapper(vil_image_view_base const& view, std::string const& vil_type,
+                           std::string const& rounding, bool saturate)
+{
+  conversion_rounding mode;
+  if (rounding == "nearest") {
+    mode = conversion_rounding::nearest;
+  }
+  else if (rounding == "truncate") {
+    mode = conversion_rounding::truncate;
+  }
+  else {
+    throw std::invalid_argument("convert: rounding must be \"nearest\" or \"truncate\"");
+  }
+  const vil_pixel_format format = conversion_format(vil_type);
+  vil_image_view_base_sptr result;
+  {
+    py::gil_scoped_release release;
+    result = convert_view(view, format, mode, saturate);
+  }
+  return as_native_view(result, "the converted image");
+}
+
+py::object shared_image_view_wrapper(unsigned ni, unsigned nj, unsigned nplanes, std::string const& vil_type,
+                                     bool persist)
+{
+  return as_native_view(new_shared_view(ni, nj, nplanes, conversion_format(vil_type), persist), "the shared image");
+}
+
+py::object shared_copy_wrapper(vil_image_view_base const& view, bool persist)
+{
+  vil_image_view_base_sptr result;
+  {
+    py::gil_scoped_release release;
+    result = shared_copy(view, persist);
+  }
+  return as_native_view(result, "the shared image");
+}
+
+py::object disk_image_view_wrapper(unsigned ni, unsigned nj, unsigned nplanes, std::string const& vil_type,
+                                   std::string const& directory)
+{
+  return as_native_view(new_disk_view(ni, nj, nplanes, conversion_format(vil_type), directory), "the disk image");
+}
+
+py::object disk_copy_wrapper(vil_image_resource_sptr const& resource, std::string const& directory)
+{
+  vil_image_view_base_sptr result;
+  {
+    py::gil_scoped_release release;
+    result = disk_copy(resource, directory);
+  }
+  return as_native_view(result, "the disk image");
+}
+
+py::object disk_copy_view_wrapper(vil_image_view_base const& view, std::string const& directory)
+{
+  return disk_copy_wrapper(vil_new_image_resource_of_view(view), directory);
+}
+
+py::object shared_memory_name(vil_image_view_base const& view)
+{
+  shared_memory_chunk* chunk = shared_chunk_of(view);
+  return chunk ? py::object(py::str(chunk->owner().name())) : py::object(py::none());
+}
+
+void unlink_shared(vil_image_view_base const& view)
+{
+  shared_memory_chunk* chunk = shared_chunk_of(view);
+  if (!chunk) {
+    throw std::invalid_argument("unlink_shared: the image isn't in shared memory");
+  }
+  chunk->owner().unlink();
+}
+
+pipeline_node_sptr pipeline_op(pipeline_node_sptr const& input, pointwise_op::kind_t kind,
+                               std::vector<double> const& a, std::vector<double> const& b)
+{
+  return pipeline_pointwise::append(input, {pointwise_op{kind, a, b, VIL_PIXEL_FORMAT_UNKNOWN}},
+                                   pipeline_format_of(input));
+}
+
+pipeline_node_sptr pipeline_stretch(pipeline_node_sptr const& input, py::object const& min_limit,
+                                    py::object const& max_limit, std::string const& out_type)
+{
+  std::vector<double> lo = pipeline_values(min_limit), hi = pipeline_values(max_limit);
+  if (lo.size() != hi.size()) {
+    throw std::invalid_argument("stretch: need one pair of limits, or one per plane");
+  }
+  // as stretch_image: scaled onto the output range, clamped, and truncated
+  double scale, max_value;
+  const vil_pixel_format format = pipeline_format(out_type);
+  if (format == VIL_PIXEL_FORMAT_BYTE) {
+    scale = max_value = 255.0;
+  }
+  else if (format == VIL_PIXEL_FORMAT_UINT_16) {
+    scale = 65536.0;
+    max_value = 65535.0;
+  }
+  else if (format == VIL_PIXEL_FORMAT_FLOAT) {
+    scale = max_value = 1.0;
   }
   else {
-    vil_convert_cast(image, fimage);
+    throw std::invalid_argument("stretch: unknown out_type " + out_type);
+  }
+  std::vector<double> a, b;
+  for (std::size_t p = 0; p < lo.size(); ++p) {
+    if (!(lo[p] < hi[p])) {
+      throw std::invalid_argument("stretch: invalid stretch limits");
+    }
+    a.push_back(scale / (hi[p] - lo[p]));
+    b.push_back(-lo[p] * a.back());
+  }
+  // one step, so nothing is rounded before the truncation
+  std::vector<pointwise_op> ops {pointwise_op{pointwise_op::affine, a, b, VIL_PIXEL_FORMAT_UNKNOWN},
+                                 pointwise_op{pointwise_op::clamp, {0.0}, {max_value}, VIL_PIXEL_FORMAT_UNKNOWN}};
+  if (format != VIL_PIXEL_FORMAT_FLOAT) {
+    ops.push_back(pointwise_op{pointwise_op::floor, {0.0}, {0.0}, VIL_PIXEL_FORMAT_UNKNOWN});
+  }
+  return pipeline_pointwise::append(input, ops, format);
+}
+
+pipeline_node_sptr pipeline_convolve(pipeline_node_sptr const& input, std::vector<float> kernel_i,
+                                     py::object const& kernel_j)
+{
+  std::vector<float> kj = kernel_j.is_none() ? kernel_i : kernel_j.cast<std::vector<float> >();
+  // flipped, as vil.convolve
+  std::reverse(kernel_i.begin(), kernel_i.end());
+  std::reverse(kj.begin(), kj.end());
+  return new pipeline_filter(input, kernel_i, kj);
+}
+
+pipeline_node_sptr pipeline_arithmetic(pipeline_node_sptr const& input, py::object const& other,
+                                       pointwise_combine how, bool reverse)
+{
+  if (py::isinstance<pipeline_node>(other)) {
+    pipeline_node_sptr b = other.cast<pipeline_node_sptr>();
+    return reverse ? pipeline_pointwise::combine(b, input, how, pipeline_format_of(b))
+                   : pipeline_pointwise::combine(input, b, how, pipeline_format_of(input));
+  }
+  std::vector<double> v = pipeline_values(other);
+  std::vector<double> a(1, 1.0), b(1, 0.0);
+  switch (how) {
+    case pointwise_combine::add:
+      b = v;
+      break;
+    case pointwise_combine::subtract:
+      // v - x or x - v
+      if (reverse) {
+        a[0] = -1.0;
+        b = v;
+      }
+      else {
+        for (double& x : v) {
+          x = -x;
+        }
+        b = v;
+      }
+      break;
+    case pointwise_combine::multiply:
+      a = v;
+      break;
+    case pointwise_combine::none:
+      break;
+  }
+  return pipeline_op(input, pointwise_op::affine, a, b);
+}
+
+vil_image_resource_sptr pipeline_write(pipeline_node_sptr const& pipeline, std::string const& filename,
+                                       unsigned tile_size, std::string const& file_format)
+{
+  vil_image_resource_sptr output =
+    vil_new_blocked_image_resource(filename.c_str(), pipeline->ni(), pipeline->nj(), pipeline->nplanes(),
+                                   pipeline->pixel_format(), tile_size, tile_size, file_format.c_str()).ptr();
+  if (!output) {
+    throw std::runtime_error("pipeline: failed to create " + filename);
+  }
+  py::gil_scoped_release release;
+  evaluate_pipeline(pipeline.ptr(), output, tile_size);
+  return output;
+}
+
+py::object pipeline_evaluate(pipeline_node_sptr const& pipeline, unsigned tile_size)
+{
+  vil_image_resource_sptr output =
+    vil_new_image_resource(pipeline->ni(), pipeline->nj(), pipeline->nplanes(), pipeline->pixel_format());
+  {
+    py::gil_scoped_release release;
+    evaluate_pipeline(pipeline.ptr(), output, tile_size);
+  }
+  return as_native_view(output->get_view(), "pipeline output");
+}
+
+py::tuple pyramid_view_at_scale(vil_pyramid_image_resource const& pyramid, float scale,
+                                unsigned i0, unsigned n_i, unsigned j0, unsigned n_j)
+{
+  if (n_i == 0 && i0 < pyramid.ni()) {
+    n_i = pyramid.ni() - i0;
+  }
+  if (n_j == 0 && j0 < pyramid.nj()) {
+    n_j = pyramid.nj() - j0;
   }
 
-  unsigned ni = fimage.ni(), nj = fimage.nj(), np = fimage.nplanes();
+  float actual_scale = 0.0f;
+  vil_image_view_base_sptr base;
+  {
+    py::gil_scoped_release release;
+    base = pyramid.get_copy_view(i0, n_i, j0, n_j, scale, actual_scale);
+  }
+  if (!base) {
+    throw std::runtime_error("Failed to read the pyramid at the requested scale");
+  }
+  return py::make_tuple(as_native_view(base, "pyramid level"), actual_scale);
+}
 
-  float scale = 1.0f / (max_limit - min_limit);
-  for(unsigned j = 0; j<nj; ++j)
-    for(unsigned i = 0; i<ni; ++i)
-      for(unsigned p = 0; p<np; ++p){
-        float v = scale * (fimage(i,j,p) - min_limit);
-        if(v > 1.0f) v = 1.0f; if(v < 0.0f) v=0.0f;
-        fimage(i,j,p) = v;
+/* The block iterator as seen from Python. Decoding may call back into a
+ * Python image_resource, so the GIL is released while waiting for the read
+ * ahead thread to finish */
+class py_block_iterator : public image_block_iterator {
+public:
+  using image_block_iterator::image_block_iterator;
+
+  ~py_block_iterator() override
+  {
+    py::gil_scoped_release release;
+    stop();
+  }
+
+  py::tuple next_block()
+  {
+    block b;
+    bool more;
+    {
+      py::gil_scoped_release release;
+      more = next(b);
+    }
+    if (!more) {
+      throw py::stop_iteration();
+    }
+    return py::make_tuple(b.i0, b.j0, as_native_view(b.view, "image block"));
+  }
+
+  py::object read_window(unsigned i0, unsigned n_i, unsigned j0, unsigned n_j) const
+  {
+    vil_image_view_base_sptr view;
+    {
+      py::gil_scoped_release release;
+      view = read(i0, n_i, j0, n_j);
+    }
+    if (!view) {
+      throw std::runtime_error("image_block_iterator: failed to read window");
+    }
+    return as_native_view(view, "image window");
+  }
+};
+
+template <class outT, class T>
+vil_image_view<outT> vil_convert_stretch_range_wrapper(vil_image_view<T> const& img)
+{
+  vil_image_view_base_sptr base = new vil_image_view<T>(img);
+  return vil_convert_stretch_range(outT(), base);
+}
+
+vil_image_resource_sptr vil_load_image_resource_wrapper(std::string const& filename)
+{
+  return vil_load_image_resource(filename.c_str());
+}
+
+template <class T>
+void vil_save_wrapper(vil_image_view<T> const& img, std::string const& filename)
+{
+  bool result = vil_save(img, filename.c_str());
+
+  if ( !result ) {
+    std::ostringstream buffer;
+    buffer << "Failed to save image to " << filename << std::endl;
+    throw std::runtime_error(buffer.str());
+  }
+}
+
+template <class T>
+double vil_image_sum_wrapper(vil_image_view<T> const& image, unsigned p = 0)
+{
+  // compute the sum of elements in plane p of image
+  if (p >= image.nplanes()) {
+    throw std::out_of_range("img_sum: plane index out of range");
+  }
+
+  // partial sums of each band of rows are added up in order, so the
+  // result doesn't depend on the number of threads
+  return parallel_reduce_rows(image.ni(), image.nj(), 0.0,
+    [&](unsigned j0, unsigned j1) {
+      double sum = 0.0;
+      for (unsigned j = j0; j < j1; ++j) {
+        T const* row = &image(0, j, p);
+        for (unsigned i = 0; i < image.ni(); ++i) {
+          sum += row[i*image.istep()];
+        }
       }
+      return sum;
+    },
+    [](double a, double b) { return a + b; });
+}
 
-  return fimage;
+template <class outT, class T>
+vil_image_view<outT> vil_stretch_image_wrapper(vil_image_view<T> const& image,
+                                               std::vector<float> const& min_limits,
+                                               std::vector<float> const& max_limits)
+{
+  // limits are a single pair, or one pair per plane
+  if (min_limits.size() != max_limits.size() ||
+      (min_limits.size() != 1 && min_limits.size() != image.nplanes())) {
+    throw std::invalid_argument("stretch_image: need one pair of limits, or one per plane");
+  }
+
+  // stretch straight from the input type into the output type in a single
+  // pass, leaving the input imagery untouched
+  vil_image_view<outT> out(new_view_like(image, image.ni(), image.nj(), image.nplanes(),
+                                         vil_pixel_format_of(outT())));
+  parallel_for_rows(image.ni(), image.nj(), [&](unsigned j0, unsigned j1) {
+    stretch_rows(image, out, j0, j1, min_limits, max_limits);
+  });
+  return out;
 }
 
 
 template <class T>
 std::tuple<T, T> vil_image_range_wrapper(vil_image_view<T> const& img) {
-  T min_val, max_val;
-  vil_math_value_range(img, min_val, max_val);
-  return std::make_tuple(min_val, max_val);
+  if (img.size() == 0) {
+    return std::make_tuple(T(0), T(0));
+  }
+
+  using range = std::tuple<T, T>;
+  T first = img(0, 0, 0);
+  return parallel_reduce_rows(img.ni(), img.nj(), range(first, first),
+    [&](unsigned j0, unsigned j1) {
+      T min_val = first, max_val = first;
+      for (unsigned p = 0; p < img.nplanes(); ++p) {
+        for (unsigned j = j0; j < j1; ++j) {
+          T const* row = &img(0, j, p);
+          for (unsigned i = 0; i < img.ni(); ++i) {
+            T v = row[i*img.istep()];
+            if (v < min_val) min_val = v;
+            if (v > max_val) max_val = v;
+          }
+        }
+      }
+      return range(min_val, max_val);
+    },
+    [](range const& a, range const& b) {
+      return range(std::min(std::get<0>(a), std::get<0>(b)),
+                   std::max(std::get<1>(a), std::get<1>(b)));
+    });
+}
+
+// Plane indices from None (every plane), an int or a sequence of ints
+std::vector<unsigned> stats_planes(py::object const& planes)
+{
+  if (planes.is_none()) {
+    return std::vector<unsigned>();
+  }
+  if (py::isinstance<py::int_>(planes)) {
+    return std::vector<unsigned>(1, planes.cast<unsigned>());
+  }
+  return planes.cast<std::vector<unsigned> >();
+}
+
+// Histogram bins from the arguments of image_stats. auto_range is set when
+// the range has to come from a first pass over the image.
+histogram_bins stats_bins(unsigned n_bins, py::object const& range, bool& auto_range)
+{
+  auto_range = n_bins > 0 && range.is_none();
+  histogram_bins bins(n_bins);
+  if (n_bins > 0 && !auto_range) {
+    auto limits = range.cast<std::pair<double, double> >();
+    if (!(limits.first <= limits.second)) {
+      throw std::invalid_argument("image_stats: histogram range must be (min, max) with min <= max");
+    }
+    bins.min = limits.first;
+    bins.max = limits.second;
+  }
+  return bins;
+}
+
+// Bins spanning the values of every plane
+histogram_bins stats_range(std::vector<plane_stats> const& stats, unsigned n_bins)
+{
+  plane_stats all;
+  for (auto const& s : stats) {
+    all.merge(s);
+  }
+  return all.count ? histogram_bins(n_bins, all.min, all.max) : histogram_bins(n_bins);
+}
+
+template <class T>
+std::vector<plane_stats> image_stats_wrapper(vil_image_view<T> const& img, py::object const& planes,
+                                             vil_image_view<unsigned char> const* mask,
+                                             unsigned n_bins, py::object const& range)
+{
+  std::vector<unsigned> plane_list = stats_planes(planes);
+  bool auto_range;
+  histogram_bins bins = stats_bins(n_bins, range, auto_range);
+
+  py::gil_scoped_release release;
+  if (auto_range) {
+    bins = stats_range(image_stats(img, plane_list, mask, histogram_bins()), n_bins);
+  }
+  return image_stats(img, plane_list, mask, bins);
+}
+
+std::vector<plane_stats> resource_stats_wrapper(vil_image_resource_sptr const& resource,
+                                                py::object const& planes, py::object const& mask,
+                                                unsigned n_bins, py::object const& range,
+                                                unsigned block_ni, unsigned block_nj,
+                                                unsigned sample_step)
+{
+  std::vector<unsigned> plane_list = stats_planes(planes);
+  bool auto_range;
+  histogram_bins bins = stats_bins(n_bins, range, auto_range);
+  vil_image_resource_sptr mask_resource;
+  if (!mask.is_none()) {
+    mask_resource = mask.cast<vil_image_resource_sptr>();
+  }
+
+  py::gil_scoped_release release;
+  if (auto_range) {
+    bins = stats_range(resource_stats(resource, plane_list, mask_resource, histogram_bins(),
+                                      block_ni, block_nj, sample_step), n_bins);
+  }
+  return resource_stats(resource, plane_list, mask_resource, bins, block_ni, block_nj, sample_step);
+}
+
+template <class T>
+void vil_truncate_range_wrapper(vil_image_view<T>& img, T min_v, T max_v)
+{
+  parallel_for_rows(img.ni(), img.nj(), [&](unsigned j0, unsigned j1) {
+    for (unsigned p = 0; p < img.nplanes(); ++p) {
+      for (unsigned j = j0; j < j1; ++j) {
+        T* row = &img(0, j, p);
+        for (unsigned i = 0; i < img.ni(); ++i) {
+          T& v = row[i*img.istep()];
+          if (v < min_v) v = min_v;
+          else if (v > max_v) v = max_v;
+        }
+      }
+    }
+  });
+}
+
+template <class srcT, class destT>
+void separable_filter_wrapper(vil_image_view<srcT> const& img, std::vector<float> const& kernel_i,
+                              std::vector<float> const& kernel_j, vil_image_view<destT>& out)
+{
+  // compound pixels are filtered as planes of their components
+  vil_image_view<typename pixel_component<destT>::type> out_planes(out);
+  separable_filter(vil_image_view<typename pixel_component<srcT>::type>(img), out_planes, kernel_i, kernel_j);
 }
 
 
@@ -541,25 +1768,38 @@ void wrap_vil(py::module &m)
     .def("nj", &vil_image_resource::nj)
     .def("nplanes", &vil_image_resource::nplanes)
     .def("pixel_format", &vil_image_resource::pixel_format)
-    .def("get_view_byte", [](vil_image_resource const& r) {vil_image_view<unsigned char> temp = r.get_view(); return temp; }, "Get a byte image view of all the data")
-    .def("get_view_short", [](vil_image_resource const& r) {vil_image_view<unsigned short int> temp = r.get_view(); return temp; }, "Get a short image view of all the data")
-    .def("get_view_float", [](vil_image_resource const& r) {vil_image_view<float> temp = r.get_view(); return temp; }, "Get a float image view of all the data")
-    .def("get_view_int", [](vil_image_resource const& r) {vil_image_view<int> temp = r.get_view(); return temp; }, "Get an int image view of all the data")
-
-    .def("get_view_byte", [](vil_image_resource const& r, unsigned i0, unsigned n_i, unsigned j0, unsigned n_j) {vil_image_view<unsigned char> temp = r.get_view(i0, n_i, j0, n_j); return temp; }, "Get a byte image view within a rectangular window")
-    .def("get_view_short", [](vil_image_resource const& r, unsigned i0, unsigned n_i, unsigned j0, unsigned n_j) {vil_image_view<unsigned short int> temp = r.get_view(i0, n_i, j0, n_j); return temp; }, "Get a short image view within a rectangular window")
-    .def("get_view_float", [](vil_image_resource const& r, unsigned i0, unsigned n_i, unsigned j0, unsigned n_j) {vil_image_view<float> temp = r.get_view(i0, n_i, j0, n_j); return temp; }, "Get a float image view within a rectangular window")
-    .def("get_view_int", [](vil_image_resource const& r, unsigned i0, unsigned n_i, unsigned j0, unsigned n_j) {vil_image_view<int> temp = r.get_view(i0, n_i, j0, n_j); return temp; }, "Get an int image view within a rectangular window")
-
-    .def("get_copy_view_byte", [](vil_image_resource const& r) {vil_image_view<unsigned char> temp = r.get_copy_view(); return temp; }, "Get a byte image view of a copy of all the data")
-    .def("get_copy_view_short", [](vil_image_resource const& r) {vil_image_view<unsigned short int> temp = r.get_copy_view(); return temp; }, "Get a short image view of a copy of all the data")
-    .def("get_copy_view_float", [](vil_image_resource const& r) {vil_image_view<float> temp = r.get_copy_view(); return temp; }, "Get a float image view of a copy of all the data")
-    .def("get_copy_view_int", [](vil_image_resource const& r) {vil_image_view<int> temp = r.get_copy_view(); return temp; }, "Get an int image view of a copy of all the data")
-
-    .def("get_copy_view_byte", [](vil_image_resource const& r, unsigned i0, unsigned n_i, unsigned j0, unsigned n_j) {vil_image_view<unsigned char> temp = r.get_copy_view(i0, n_i, j0, n_j); return temp; }, "Get a byte image view of a copy of this data within a rectangular window")
-    .def("get_copy_view_short", [](vil_image_resource const& r, unsigned i0, unsigned n_i, unsigned j0, unsigned n_j) {vil_image_view<unsigned short int> temp = r.get_copy_view(i0, n_i, j0, n_j); return temp; }, "Get a short image view of a copy of this data within a rectangular window")
-    .def("get_copy_view_float", [](vil_image_resource const& r, unsigned i0, unsigned n_i, unsigned j0, unsigned n_j) {vil_image_view<float> temp = r.get_copy_view(i0, n_i, j0, n_j); return temp; }, "Get a float image view of a copy of this data within a rectangular window")
-    .def("get_copy_view_int", [](vil_image_resource const& r, unsigned i0, unsigned n_i, unsigned j0, unsigned n_j) {vil_image_view<int> temp = r.get_copy_view(i0, n_i, j0, n_j); return temp; }, "Get an int image view of a copy of this data within a rectangular window")
+    .def("get_view_byte", &resource_view<unsigned char>, "Get a byte image view of all the data")
+    .def("get_view_short", &resource_view<unsigned short int>, "Get a short image view of all the data")
+    .def("get_view_float", &resource_view<float>, "Get a float image view of all the data")
+    .def("get_view_int", &resource_view<int>, "Get an int image view of all the data")
+    .def("get_view_int16", &resource_view<vxl_int_16>, "Get an int16 image view of all the data")
+    .def("get_view_double", &resource_view<double>, "Get a double image view of all the data")
+
+    .def("get_view_byte", &resource_window<unsigned char>, "Get a byte image view within a rectangular window")
+    .def("get_view_short", &resource_window<unsigned short int>, "Get a short image view within a rectangular window")
+    .def("get_view_float", &resource_window<float>, "Get a float image view within a rectangular window")
+    .def("get_view_int", &resource_window<int>, "Get an int image view within a rectangular window")
+    .def("get_view_int16", &resource_window<vxl_int_16>, "Get an int16 image view within a rectangular window")
+    .def("get_view_double", &resource_window<double>, "Get a double image view within a rectangular window")
+
+    .def("get_copy_view_byte", &resource_copy_view<unsigned char>, "Get a byte image view of a copy of all the data")
+    .def("get_copy_view_short", &resource_copy_view<unsigned short int>, "Get a short image view of a copy of all the data")
+    .def("get_copy_view_float", &resource_copy_view<float>, "Get a float image view of a copy of all the data")
+    .def("get_copy_view_int", &resource_copy_view<int>, "Get an int image view of a copy of all the data")
+    .def("get_copy_view_int16", &resource_copy_view<vxl_int_16>, "Get an int16 image view of a copy of all the data")
+    .def("get_copy_view_double", &resource_copy_view<double>, "Get a double image view of a copy of all the data")
+
+    .def("get_copy_view_byte", &resource_copy_window<unsigned char>, "Get a byte image view of a copy of this data within a rectangular window")
+    .def("get_copy_view_short", &resource_copy_window<unsigned short int>, "Get a short image view of a copy of this data within a rectangular window")
+    .def("get_copy_view_float", &resource_copy_window<float>, "Get a float image view of a copy of this data within a rectangular window")
+    .def("get_copy_view_int", &resource_copy_window<int>, "Get an int image view of a copy of this data within a rectangular window")
+    .def("get_copy_view_int16", &resource_copy_window<vxl_int_16>, "Get an int16 image view of a copy of this data within a rectangular window")
+    .def("get_copy_view_double", &resource_copy_window<double>, "Get a double image view of a copy of this data within a rectangular window")
+    .def("get_views", &resource_get_views, py::arg("windows"), py::arg("vil_type") = py::none(), py::arg("stack") = false,
+         "Get a copy of each window of an N x 4 array of (i0, ni, j0, nj), as a list of views, or with stack "
+         "as one N x nj x ni (x nplanes) array of windows of the same size. Each block of the image is decoded "
+         "once however many windows overlap it, in parallel when the resource allows. vil_type converts the "
+         "pixels as get_view_* does; by default they keep the type of the image.")
 
     .def("put_view", (bool (vil_image_resource::*)(const vil_image_view_base& im, unsigned i0, unsigned j0)) &vil_image_resource::put_view, "Put the data in this view back into the image source")
     .def("put_view", (bool (vil_image_resource::*)(const vil_image_view_base& im)) &vil_image_resource::put_view, "Put the data in this view back into the image source at the origin")
@@ -567,7 +1807,172 @@ void wrap_vil(py::module &m)
     .def("file_format", &vil_image_resource::file_format)
     .def("get_property", &vil_image_resource::get_property)
     .def("__len__", &resource_len)
-    .def_property_readonly("shape", &image_resource_shape);
+    .def_property_readonly("shape", &image_resource_shape)
+    .def("blocks", [](vil_image_resource& r, unsigned block_ni, unsigned block_nj, unsigned overlap, unsigned read_ahead) {
+          return new py_block_iterator(vil_image_resource_sptr(&r), block_ni, block_nj, overlap, read_ahead);
+        },
+        py::arg("block_ni") = 0, py::arg("block_nj") = 0, py::arg("overlap") = 0, py::arg("read_ahead") = 2,
+        py::keep_alive<0, 1>(),
+        "Iterate over (i0, j0, view) for aligned blocks of the image, each view extended by overlap pixels on every side. "
+        "Block sizes of 0 use the native block size of the file, and sizes are rounded up to a multiple of it. "
+        "The next read_ahead blocks are decoded in the background, so unless the resource is a "
+        "concurrent_image_resource or memory mapped, read other windows with the iterator's "
+        "get_copy_view rather than the resource until the iterator is exhausted or deleted.");
+
+  py::class_<cached_image_resource, vil_image_resource /* <- Parent */, cached_image_resource_sptr /* <- holder type */ > (m, "cached_image_resource")
+    .def(py::init<vil_image_resource_sptr const&, std::size_t, unsigned, unsigned>(),
+         py::arg("image_resource"), py::arg("max_bytes") = std::size_t(256) << 20,
+         py::arg("block_ni") = 0, py::arg("block_nj") = 0,
+         "Cache the decoded blocks of image_resource in an LRU of at most max_bytes. "
+         "Block sizes of 0 use the native block size of the file.")
+    .def_property_readonly("source", &cached_image_resource::source)
+    .def_property_readonly("block_ni", &cached_image_resource::block_ni)
+    .def_property_readonly("block_nj", &cached_image_resource::block_nj)
+    .def_property_readonly("max_bytes", &cached_image_resource::max_bytes)
+    .def_property_readonly("hits", &cached_image_resource::hits)
+    .def_property_readonly("misses", &cached_image_resource::misses)
+    .def_property_readonly("evictions", &cached_image_resource::evictions)
+    .def_property_readonly("bytes", &cached_image_resource::bytes)
+    .def_property_readonly("n_cached_blocks", &cached_image_resource::n_cached_blocks)
+    .def("clear", &cached_image_resource::clear, "Drop every cached block");
+
+  py::class_<integral_image> (m, "integral_image")
+    .def(py::init([](vil_image_view_base const& image, bool squared) {
+           py::gil_scoped_release release;
+           return make_integral_image(image, squared);
+         }),
+         py::arg("image"), py::arg("squared") = false,
+         "Summed-area tables of image, and with squared of the squares of its pixels, built in parallel. "
+         "Integer pixels are summed exactly in 64 bits, others in double.")
+    .def("ni", &integral_image::ni)
+    .def("nj", &integral_image::nj)
+    .def("nplanes", &integral_image::nplanes)
+    .def_property_readonly("squared", [](integral_image const& image) { return bool(image.squares()); })
+    .def_property_readonly("sums", [](py::object const& self) { return integral_table(self, false); },
+         "The (nj+1) x (ni+1) (x nplanes) table, whose [j, i] is the sum over [0, j) x [0, i)")
+    .def_property_readonly("squares", [](py::object const& self) { return integral_table(self, true); },
+         "The table of the squares of the pixels, or None")
+    .def("box_sum", [](integral_image const& image, window_array const& boxes) {
+           return box_statistics_wrapper(image, boxes, box_statistic::sum, "box_sum");
+         }, py::arg("boxes"),
+         "Sum of each plane over each box of an N x 4 array of (i0, ni, j0, nj)")
+    .def("box_mean", [](integral_image const& image, window_array const& boxes) {
+           return box_statistics_wrapper(image, boxes, box_statistic::mean, "box_mean");
+         }, py::arg("boxes"),
+         "Mean of each plane over each box of an N x 4 array of (i0, ni, j0, nj), NaN for empty boxes")
+    .def("box_variance", [](integral_image const& image, window_array const& boxes) {
+           return box_statistics_wrapper(image, boxes, box_statistic::variance, "box_variance");
+         }, py::arg("boxes"),
+         "Population variance of each plane over each box of an N x 4 array of (i0, ni, j0, nj), "
+         "NaN for empty boxes. Needs squared.");
+
+  py::class_<tile_image_resource, vil_image_resource /* <- Parent */, PyTileImageResource /* <- trampoline */,
+             tile_image_resource_sptr /* <- holder type */ > (m, "tile_image_resource")
+    .def(py::init([](unsigned ni, unsigned nj, unsigned nplanes, std::string const& vil_type,
+                     unsigned block_ni, unsigned block_nj, std::string const& file_format) {
+           return new PyTileImageResource(ni, nj, nplanes, conversion_format(vil_type), block_ni, block_nj, file_format);
+         }),
+         py::arg("ni"), py::arg("nj"), py::arg("nplanes") = 1, py::arg("vil_type") = "byte",
+         py::arg("block_ni") = 0, py::arg("block_nj") = 0, py::arg("file_format") = "",
+         "An image resource to subclass in Python for sources which fetch pixels in bulk. The size, type and "
+         "tiling given here are kept in C++, and pixels come only from read_tiles(windows), which is given an "
+         "N x 4 array of (i0, ni, j0, nj) and returns one image view or nj x ni (x nplanes) array per window. "
+         "Arrays of the right type are used without a copy; get_views asks for all its tiles in one call.")
+    .def_property_readonly("block_ni", &tile_image_resource::block_ni)
+    .def_property_readonly("block_nj", &tile_image_resource::block_nj);
+
+  py::class_<concurrent_image_resource, vil_image_resource /* <- Parent */, concurrent_image_resource_sptr /* <- holder type */ > (m, "concurrent_image_resource")
+    .def(py::init<std::string const&, unsigned>(), py::arg("filename"), py::arg("max_handles") = 0,
+         py::call_guard<py::gil_scoped_release>(),
+         "Open filename for reading from any number of threads at once, keeping a pool of up to "
+         "max_handles resources of it (0 for one per core), each with its own file handle. Windows "
+         "are decoded in parallel, without the GIL.")
+    .def_property_readonly("filename", &concurrent_image_resource::filename)
+    .def_property_readonly("max_handles", &concurrent_image_resource::max_handles)
+    .def_property_readonly("n_open_handles", &concurrent_image_resource::n_open_handles);
+
+  py::class_<vil_pyramid_image_resource, vil_image_resource /* <- Parent */, vil_pyramid_image_resource_sptr /* <- holder type */ > (m, "pyramid_image_resource")
+    .def("nlevels", &vil_pyramid_image_resource::nlevels)
+    .def("get_resource", &vil_pyramid_image_resource::get_resource, py::arg("level"),
+         "The image resource of one level, 0 being full resolution")
+    .def("get_view_at_scale", &pyramid_view_at_scale,
+         py::arg("scale"), py::arg("i0") = 0, py::arg("ni") = 0, py::arg("j0") = 0, py::arg("nj") = 0,
+         "Decode a window from the level nearest to scale (1 is full resolution, 0.5 half size), "
+         "returning (view, actual_scale). The window is given in full resolution pixels, "
+         "ni or nj of 0 meaning to the edge of the image.");
+
+  py::class_<pipeline_node, vil_image_resource /* <- Parent */, pipeline_node_sptr /* <- holder type */ > (m, "pipeline_node")
+    .def("crop", [](pipeline_node_sptr const& p, unsigned i0, unsigned n_i, unsigned j0, unsigned n_j) {
+           return pipeline_node_sptr(new pipeline_crop(p, i0, n_i, j0, n_j));
+         }, py::arg("i0"), py::arg("ni"), py::arg("j0"), py::arg("nj"))
+    .def("convert", [](pipeline_node_sptr const& p, std::string const& vil_type) {
+           return pipeline_pointwise::convert(p, conversion_format(vil_type));
+         }, py::arg("vil_type"), "Convert to \"byte\", \"short\", \"int16\", \"int\", \"float\", \"double\" or \"rgb_byte\" "
+         "(from 3 planes) as vil.convert, but rounding halves up, and always saturating")
+    .def("stretch", &pipeline_stretch, py::arg("min_limit"), py::arg("max_limit"), py::arg("out_type"),
+         "As stretch_image, with limits given once or per plane. The pipeline works in double "
+         "where stretch_image works in float, so a pixel may differ from it by 1.")
+    .def("truncate", [](pipeline_node_sptr const& p, py::object const& min_v, py::object const& max_v) {
+           return pipeline_op(p, pointwise_op::clamp, pipeline_values(min_v), pipeline_values(max_v));
+         }, py::arg("min_value"), py::arg("max_value"), "Clamp to [min_value, max_value], as truncate_image_range")
+    .def("scale", [](pipeline_node_sptr const& p, py::object const& a, py::object const& b) {
+           return pipeline_op(p, pointwise_op::affine, pipeline_values(a), pipeline_values(b));
+         }, py::arg("scale"), py::arg("offset") = 0.0, "scale * v + offset, given once or per plane")
+    .def("convolve", &pipeline_convolve, py::arg("kernel_i"), py::arg("kernel_j") = py::none(),
+         "As vil.convolve, e.g. with vil.gaussian_kernel(sigma) for a Gaussian blur")
+    .def("__add__", [](pipeline_node_sptr const& p, py::object const& o) { return pipeline_arithmetic(p, o, pointwise_combine::add, false); })
+    .def("__radd__", [](pipeline_node_sptr const& p, py::object const& o) { return pipeline_arithmetic(p, o, pointwise_combine::add, true); })
+    .def("__sub__", [](pipeline_node_sptr const& p, py::object const& o) { return pipeline_arithmetic(p, o, pointwise_combine::subtract, false); })
+    .def("__rsub__", [](pipeline_node_sptr const& p, py::object const& o) { return pipeline_arithmetic(p, o, pointwise_combine::subtract, true); })
+    .def("__mul__", [](pipeline_node_sptr const& p, py::object const& o) { return pipeline_arithmetic(p, o, pointwise_combine::multiply, false); })
+    .def("__rmul__", [](pipeline_node_sptr const& p, py::object const& o) { return pipeline_arithmetic(p, o, pointwise_combine::multiply, true); })
+    .def("write", &pipeline_write, py::arg("filename"), py::arg("tile_size") = 256, py::arg("file_format") = "tiff",
+         "Compute the pipeline tile by tile into a tiled file, returning its image_resource")
+    .def("evaluate", &pipeline_evaluate, py::arg("tile_size") = 256,
+         "Compute the pipeline tile by tile into a new image view");
+
+  py::class_<save_future, std::shared_ptr<save_future> >(m, "save_future")
+    .def_property_readonly("filename", &save_future::filename)
+    .def("done", &save_future::done, "True once the image was written or failed to be")
+    .def("wait", &save_future::wait, py::arg("timeout") = -1.0,
+         py::call_guard<py::gil_scoped_release>(),
+         "Wait up to timeout seconds, forever if negative. Returns done().")
+    .def("result", &save_future::result, py::call_guard<py::gil_scoped_release>(),
+         "Wait for the image to be saved, raising if that failed");
+
+  py::class_<async_writer>(m, "async_writer")
+    .def(py::init<unsigned, std::size_t>(),
+         py::arg("num_threads") = 2, py::arg("max_bytes") = std::size_t(256) << 20,
+         "Save images on num_threads background threads, holding copies of at most "
+         "max_bytes of queued images before save blocks.")
+    .def("save", &async_writer::save,
+         py::arg("image"), py::arg("filename"), py::arg("file_format") = "",
+         py::call_guard<py::gil_scoped_release>(),
+         "Queue a copy of image to be saved, returning a save_future. "
+         "The file format is taken from the extension unless given.")
+    .def("flush", &async_writer::flush, py::call_guard<py::gil_scoped_release>(),
+         "Wait for every queued save, raising if any failed since the last flush")
+    .def("close", &async_writer::close, py::call_guard<py::gil_scoped_release>(),
+         "Flush and stop the writer threads")
+    .def("__enter__", [](py::object self) { return self; })
+    .def("__exit__", [](async_writer& writer, py::args) { writer.close(); },
+         py::call_guard<py::gil_scoped_release>())
+    .def_property_readonly("num_threads", &async_writer::num_threads)
+    .def_property_readonly("max_bytes", &async_writer::max_bytes)
+    .def_property_readonly("pending", &async_writer::pending)
+    .def_property_readonly("pending_bytes", &async_writer::pending_bytes);
+
+  py::class_<py_block_iterator>(m, "image_block_iterator")
+    .def("__iter__", [](py::object self) { return self; })
+    .def("__next__", &py_block_iterator::next_block)
+    .def("__len__", &py_block_iterator::n_blocks)
+    .def_property_readonly("block_ni", &py_block_iterator::block_ni)
+    .def_property_readonly("block_nj", &py_block_iterator::block_nj)
+    .def_property_readonly("n_block_i", &py_block_iterator::n_block_i)
+    .def_property_readonly("n_block_j", &py_block_iterator::n_block_j)
+    .def("get_copy_view", &py_block_iterator::read_window, py::arg("i0"), py::arg("ni"), py::arg("j0"), py::arg("nj"),
+         "Copy a window of the image. Use this rather than the resource while iterating, "
+         "as the read ahead thread may be reading it.");
 
 
 
@@ -591,53 +1996,265 @@ void wrap_vil(py::module &m)
   wrap_vil_image_view<unsigned short int>(m, "image_view_uint16");
   wrap_vil_image_view<float>(m, "image_view_float");
   wrap_vil_image_view<int>(m, "image_view_int");
+  wrap_vil_image_view<vxl_int_16>(m, "image_view_int16");
+  wrap_vil_image_view<double>(m, "image_view_double");
   wrap_vil_image_view<vil_rgb<unsigned char> >(m, "image_view_rgb_byte");
 
 
+  m.def("set_num_threads", &set_num_threads, py::arg("num_threads"),
+        "Set the number of threads used by the vil pixel operations, 0 for one per core");
+  m.def("get_num_threads", &get_num_threads,
+        "Number of threads used by the vil pixel operations");
+
   m.def("crop_image_resource", (vil_image_resource_sptr (*)(const vil_image_resource_sptr&, unsigned, unsigned, unsigned, unsigned)) &vil_crop,
         py::arg("image_resource"), py::arg("i0"), py::arg("ni"), py::arg("j0"), py::arg("nj"));
 
-  m.def("img_sum", &vil_image_sum_wrapper<unsigned char>, "", py::arg("image"), py::arg("p") = 0);
-  m.def("img_sum", &vil_image_sum_wrapper<unsigned short int>, "", py::arg("image"), py::arg("p") = 0);
-  m.def("img_sum", &vil_image_sum_wrapper<float>, "", py::arg("image"), py::arg("p") = 0);
-  m.def("img_sum", &vil_image_sum_wrapper<int>, "", py::arg("image"), py::arg("p") = 0);
+  m.def("img_sum", &vil_image_sum_wrapper<unsigned char>, "", py::arg("image"), py::arg("p") = 0,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("img_sum", &vil_image_sum_wrapper<unsigned short int>, "", py::arg("image"), py::arg("p") = 0,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("img_sum", &vil_image_sum_wrapper<float>, "", py::arg("image"), py::arg("p") = 0,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("img_sum", &vil_image_sum_wrapper<int>, "", py::arg("image"), py::arg("p") = 0,
+        py::call_guard<py::gil_scoped_release>());
+
+  py::class_<plane_stats>(m, "plane_stats")
+    .def_readonly("count", &plane_stats::count)
+    .def_readonly("sum", &plane_stats::sum)
+    .def_readonly("sum_sq", &plane_stats::sum_sq)
+    .def_readonly("min", &plane_stats::min)
+    .def_readonly("max", &plane_stats::max)
+    .def_property_readonly("mean", &plane_stats::mean)
+    .def_property_readonly("variance", &plane_stats::variance)
+    .def_property_readonly("std", [](plane_stats const& s) { return std::sqrt(s.variance()); })
+    .def_readonly("histogram", &plane_stats::histogram)
+    .def_property_readonly("histogram_range", [](plane_stats const& s) {
+        return std::make_tuple(s.bins.min, s.bins.max);
+      })
+    .def("percentile", &plane_stats::percentile, py::arg("percent"),
+         "Approximate value below which percent of the pixels fall, interpolated within the histogram")
+    .def("__repr__", [](plane_stats const& s) {
+        std::ostringstream buffer;
+        buffer << "<plane_stats count=" << s.count << " mean=" << s.mean()
+               << " min=" << s.min << " max=" << s.max << ">";
+        return buffer.str();
+      });
+
+  const char* image_stats_doc =
+    "Count, sum, sum of squares, min and max of the given planes (all by default), "
+    "and a histogram of bins equal bins over range (the image's range if None), "
+    "in one pass. Pixels where mask is 0 and NaN pixels are skipped.";
+  m.def("image_stats", &image_stats_wrapper<unsigned char>, image_stats_doc,
+        py::arg("image"), py::arg("planes") = py::none(), py::arg("mask") = nullptr,
+        py::arg("bins") = 0, py::arg("range") = py::none());
+  m.def("image_stats", &image_stats_wrapper<unsigned short int>, image_stats_doc,
+        py::arg("image"), py::arg("planes") = py::none(), py::arg("mask") = nullptr,
+        py::arg("bins") = 0, py::arg("range") = py::none());
+  m.def("image_stats", &image_stats_wrapper<float>, image_stats_doc,
+        py::arg("image"), py::arg("planes") = py::none(), py::arg("mask") = nullptr,
+        py::arg("bins") = 0, py::arg("range") = py::none());
+  m.def("image_stats", &image_stats_wrapper<int>, image_stats_doc,
+        py::arg("image"), py::arg("planes") = py::none(), py::arg("mask") = nullptr,
+        py::arg("bins") = 0, py::arg("range") = py::none());
+  m.def("image_stats", &resource_stats_wrapper,
+        "Statistics of a whole image_resource, streamed block by block so the image is "
+        "never loaded at once. mask is None or a byte image_resource of the same size. "
+        "A sample_step above 1 only counts every sample_step-th pixel of every sample_step-th row.",
+        py::arg("image_resource"), py::arg("planes") = py::none(), py::arg("mask") = py::none(),
+        py::arg("bins") = 0, py::arg("range") = py::none(),
+        py::arg("block_ni") = 0, py::arg("block_nj") = 0, py::arg("sample_step") = 1);
 
   m.def("_load_byte", &load_byte);
   m.def("_load_short", &load_short);
   m.def("_load_float", &load_float);
   m.def("_load_int", &load_int);
 
+  m.def("load_native", &load_native, py::arg("filename"),
+        "Load an image in the pixel format of the file, without any conversion");
+
+  m.def("_convert_stretch_range_to_byte", &vil_convert_stretch_range_wrapper<unsigned char, unsigned char>);
+  m.def("_convert_stretch_range_to_byte", &vil_convert_stretch_range_wrapper<unsigned char, unsigned short int>);
+  m.def("_convert_stretch_range_to_byte", &vil_convert_stretch_range_wrapper<unsigned char, float>);
+  m.def("_convert_stretch_range_to_byte", &vil_convert_stretch_range_wrapper<unsigned char, int>);
+
+  m.def("_convert_stretch_range_to_short", &vil_convert_stretch_range_wrapper<unsigned short int, unsigned char>);
+  m.def("_convert_stretch_range_to_short", &vil_convert_stretch_range_wrapper<unsigned short int, unsigned short int>);
+  m.def("_convert_stretch_range_to_short", &vil_convert_stretch_range_wrapper<unsigned short int, float>);
+  m.def("_convert_stretch_range_to_short", &vil_convert_stretch_range_wrapper<unsigned short int, int>);
+
+  m.def("_convert_stretch_range_to_float", &vil_convert_stretch_range_wrapper<float, unsigned char>);
+  m.def("_convert_stretch_range_to_float", &vil_convert_stretch_range_wrapper<float, unsigned short int>);
+  m.def("_convert_stretch_range_to_float", &vil_convert_stretch_range_wrapper<float, float>);
+  m.def("_convert_stretch_range_to_float", &vil_convert_stretch_range_wrapper<float, int>);
+
+  m.def("_convert_stretch_range_to_int", &vil_convert_stretch_range_wrapper<int, unsigned char>);
+  m.def("_convert_stretch_range_to_int", &vil_convert_stretch_range_wrapper<int, unsigned short int>);
+  m.def("_convert_stretch_range_to_int", &vil_convert_stretch_range_wrapper<int, float>);
+  m.def("_convert_stretch_range_to_int", &vil_convert_stretch_range_wrapper<int, int>);
+
+  m.def("convert", &convert_wrapper, py::arg("image"), py::arg("vil_type"), py::arg("rounding") = "nearest",
+        py::arg("saturate") = true,
+        "A new view of image with pixels of vil_type (\"byte\", \"short\", \"int16\", \"int\", \"float\", "
+        "\"double\" or \"rgb_byte\"), values unchanged. Floating point values become integers rounded "
+        "\"nearest\" (halves to even) or \"truncate\"d, and with saturate are clamped to the range of the "
+        "new type. Without saturate, values beyond a narrower integer type wrap around, and floating point "
+        "values are first clamped to the range of int32 (NaN becoming 0). RGB pixels convert as three planes, and an image of three planes converts to \"rgb_byte\".");
+  m.def("convert_kernel_isa", &convert_kernel_isa,
+        "Instruction set of the conversion kernels picked for this CPU, \"avx2\" or \"sse2\"");
+  m.def("shared_image_view", &shared_image_view_wrapper, py::arg("ni"), py::arg("nj"), py::arg("nplanes") = 1,
+        py::arg("vil_type") = "byte", py::arg("persist") = false,
+        "A new zero filled image view in POSIX shared memory. Pickling it, or any view of its pixels, "
+        "sends only the name of the memory and the layout of the view, and unpickling maps the same "
+        "pixels without a copy. The memory's name is removed once every view of it in this process "
+        "has gone, or by unlink_shared. multiprocessing pickles arguments later, in a feeder thread "
+        "(Pool.apply_async, Queue.put), and another process unpickles them later still, so a view "
+        "passed that way must outlive the call or the name may be gone first. With persist=True the "
+        "name stays until unlink_shared is called, in any process; until then it outlives this "
+        "process too.");
+  m.def("shared_copy", &shared_copy_wrapper, py::arg("image"), py::arg("persist") = false,
+        "A copy of image in POSIX shared memory, as shared_image_view");
+  m.def("disk_image_view", &disk_image_view_wrapper, py::arg("ni"), py::arg("nj"), py::arg("nplanes") = 1,
+        py::arg("vil_type") = "byte", py::arg("directory") = "",
+        "A new zero filled image view whose pixels live in a sparse temporary file in directory "
+        "($TMPDIR or /tmp by default), paged in and out of memory as they are used, so the image "
+        "may be bigger than memory. The file is deleted with the last view of it. Operations "
+        "making a new image of the same size from one on disk put it on disk too.");
+  m.def("disk_copy", &disk_copy_wrapper, py::arg("image"), py::arg("directory") = "",
+        "A copy of all of image_resource on disk, as disk_image_view, read a band of rows at a time");
+  m.def("disk_copy", &disk_copy_view_wrapper, py::arg("image"), py::arg("directory") = "",
+        "A copy of image on disk, as disk_image_view");
+  m.def("on_disk", [](vil_image_view_base const& view) { return disk_chunk_of(view) != nullptr; },
+        py::arg("image"), "Whether the pixels of image live in a file made by disk_image_view");
+  m.def("shared_memory_name", &shared_memory_name, py::arg("image"),
+        "Name of the shared memory holding the pixels of image, or None");
+  m.def("unlink_shared", &unlink_shared, py::arg("image"),
+        "Remove the name of the shared memory of image, so no other process can map it. Views "
+        "already mapping it stay valid.");
+
+  m.def("encode", &encode_wrapper, py::arg("image"), py::arg("file_format") = "png", py::arg("options") = py::none(),
+        "The bytes of image saved in file_format (\"png\", \"jpeg\", \"tiff\", \"pnm\", ...) without "
+        "touching the disk. options is a dict of encoder settings, {\"quality\": 1 to 100} for JPEG.");
+  m.def("decode", &decode_wrapper, py::arg("data"), py::arg("vil_type") = py::none(), py::arg("as_resource") = false,
+        "The image held in the bytes data, whose format is detected from its contents. Returns a view, "
+        "stretched to vil_type as load does or of the pixel format of the data, or with as_resource an "
+        "image_resource reading from a copy of data.");
+
+  m.def("_load_many", &load_many, py::arg("filenames"), py::arg("vil_type"), py::arg("num_threads"));
+
   m.def("load_image_resource", &vil_load_image_resource_wrapper);
 
+  m.def("load_pyramid_resource", &load_pyramid_resource, py::arg("directory_or_file"),
+        "Open a pyramid image, either a directory of levels or a file holding several levels");
+  m.def("build_pyramid", &build_pyramid_wrapper,
+        py::arg("image_resource"), py::arg("directory"), py::arg("n_levels") = 0,
+        py::arg("kernel") = "gaussian", py::arg("tile_size") = 256, py::arg("file_format") = "tiff",
+        "Write a pyramid of image_resource into directory as one tiled file per level, each half the size "
+        "of the last, filtered with a \"box\" or \"gaussian\" kernel. The image is read once. n_levels of 0 "
+        "adds levels until one fits in a single tile. level_* files of an earlier build are removed first. "
+        "Returns the pyramid_image_resource.");
+
+  m.def("_warp", &warp_wrapper,
+        py::arg("image_resource"), py::arg("grid"), py::arg("step"), py::arg("ni"), py::arg("nj"),
+        py::arg("interp"), py::arg("fill"), py::arg("filename"), py::arg("tile_size"), py::arg("file_format"),
+        py::arg("cells"), py::arg("cell_positions"));
+  m.def("_warp", &warp_view_wrapper,
+        py::arg("image"), py::arg("grid"), py::arg("step"), py::arg("ni"), py::arg("nj"),
+        py::arg("interp"), py::arg("fill"), py::arg("filename"), py::arg("tile_size"), py::arg("file_format"),
+        py::arg("cells"), py::arg("cell_positions"));
+
+  m.def("pipeline", [](vil_image_resource_sptr const& r) { return pipeline_node_sptr(new pipeline_source(r)); },
+        py::arg("image_resource"),
+        "Start a lazy pipeline reading image_resource. Steps return new pipeline_nodes, which are "
+        "image_resources computing only the windows asked of them; pointwise steps are fused. "
+        "Scalar arithmetic keeps the pixel type, so convert to \"float\" first where needed.");
+  m.def("pipeline", [](vil_image_view_base const& v) { return pipeline_node_sptr(new pipeline_source(vil_new_image_resource_of_view(v))); },
+        py::arg("image"));
+
+  m.def("load_mmap_image_resource", &load_mmap_image_resource, py::arg("filename"),
+        "Memory map an uncompressed TIFF, so get_view windows are views into the mapping without any copy. "
+        "Compressed, tiled, bit packed, palette or alpha files are loaded through load_image_resource instead.");
+  m.def("mmap_raw_image_resource", &mmap_raw_image_resource,
+        py::arg("filename"), py::arg("ni"), py::arg("nj"), py::arg("nplanes"), py::arg("pixel_format"),
+        py::arg("offset") = 0, py::arg("interleaved") = false,
+        "Memory map a headerless raw raster starting offset bytes into the file");
+
   m.def("save_image_view", &vil_save_wrapper<unsigned char>);
   m.def("save_image_view", &vil_save_wrapper<unsigned short int>);
   m.def("save_image_view", &vil_save_wrapper<float>);
   m.def("save_image_view", &vil_save_wrapper<int>);
 
-  m.def("_stretch_image_to_byte", &vil_stretch_image_to_byte_wrapper<unsigned char>);
-  m.def("_stretch_image_to_byte", &vil_stretch_image_to_byte_wrapper<unsigned short int>);
-  m.def("_stretch_image_to_byte", &vil_stretch_image_to_byte_wrapper<float>);
-  m.def("_stretch_image_to_byte", &vil_stretch_image_to_byte_wrapper<int>);
-
-  m.def("_stretch_image_to_short", &vil_stretch_image_to_short_wrapper<unsigned char>);
-  m.def("_stretch_image_to_short", &vil_stretch_image_to_short_wrapper<unsigned short int>);
-  m.def("_stretch_image_to_short", &vil_stretch_image_to_short_wrapper<float>);
-  m.def("_stretch_image_to_short", &vil_stretch_image_to_short_wrapper<int>);
-
-  m.def("_stretch_image_to_float", &vil_stretch_image_to_float_wrapper<unsigned char>);
-  m.def("_stretch_image_to_float", &vil_stretch_image_to_float_wrapper<unsigned short int>);
-  m.def("_stretch_image_to_float", &vil_stretch_image_to_float_wrapper<float>);
-  m.def("_stretch_image_to_float", &vil_stretch_image_to_float_wrapper<int>);
-
-  m.def("truncate_image_range", &vil_math_truncate_range<unsigned char>);
-  m.def("truncate_image_range", &vil_math_truncate_range<unsigned short int>);
-  m.def("truncate_image_range", &vil_math_truncate_range<float>);
-  m.def("truncate_image_range", &vil_math_truncate_range<int>);
-
-  m.def("image_range", &vil_image_range_wrapper<unsigned char>);
-  m.def("image_range", &vil_image_range_wrapper<unsigned short int>);
-  m.def("image_range", &vil_image_range_wrapper<float>);
-  m.def("image_range", &vil_image_range_wrapper<int>);
+  m.def("_stretch_image_to_byte", &vil_stretch_image_wrapper<unsigned char, unsigned char>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_stretch_image_to_byte", &vil_stretch_image_wrapper<unsigned char, unsigned short int>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_stretch_image_to_byte", &vil_stretch_image_wrapper<unsigned char, float>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_stretch_image_to_byte", &vil_stretch_image_wrapper<unsigned char, int>,
+        py::call_guard<py::gil_scoped_release>());
+
+  m.def("_stretch_image_to_short", &vil_stretch_image_wrapper<unsigned short int, unsigned char>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_stretch_image_to_short", &vil_stretch_image_wrapper<unsigned short int, unsigned short int>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_stretch_image_to_short", &vil_stretch_image_wrapper<unsigned short int, float>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_stretch_image_to_short", &vil_stretch_image_wrapper<unsigned short int, int>,
+        py::call_guard<py::gil_scoped_release>());
+
+  m.def("_stretch_image_to_float", &vil_stretch_image_wrapper<float, unsigned char>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_stretch_image_to_float", &vil_stretch_image_wrapper<float, unsigned short int>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_stretch_image_to_float", &vil_stretch_image_wrapper<float, float>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_stretch_image_to_float", &vil_stretch_image_wrapper<float, int>,
+        py::call_guard<py::gil_scoped_release>());
+
+  m.def("truncate_image_range", &vil_truncate_range_wrapper<unsigned char>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("truncate_image_range", &vil_truncate_range_wrapper<unsigned short int>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("truncate_image_range", &vil_truncate_range_wrapper<float>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("truncate_image_range", &vil_truncate_range_wrapper<int>,
+        py::call_guard<py::gil_scoped_release>());
+
+  m.def("image_range", &vil_image_range_wrapper<unsigned char>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("image_range", &vil_image_range_wrapper<unsigned short int>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("image_range", &vil_image_range_wrapper<float>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("image_range", &vil_image_range_wrapper<int>,
+        py::call_guard<py::gil_scoped_release>());
+
+  // filters write into out, either of the image's own type or float
+  m.def("_separable_filter", &separable_filter_wrapper<unsigned char, unsigned char>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_separable_filter", &separable_filter_wrapper<unsigned char, float>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_separable_filter", &separable_filter_wrapper<unsigned short int, unsigned short int>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_separable_filter", &separable_filter_wrapper<unsigned short int, float>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_separable_filter", &separable_filter_wrapper<float, float>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_separable_filter", &separable_filter_wrapper<int, int>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_separable_filter", &separable_filter_wrapper<int, float>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_separable_filter", &separable_filter_wrapper<vxl_int_16, vxl_int_16>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_separable_filter", &separable_filter_wrapper<vxl_int_16, float>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_separable_filter", &separable_filter_wrapper<double, double>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_separable_filter", &separable_filter_wrapper<double, float>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_separable_filter", &separable_filter_wrapper<vil_rgb<unsigned char>, vil_rgb<unsigned char> >,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("_separable_filter", &separable_filter_wrapper<vil_rgb<unsigned char>, float>,
+        py::call_guard<py::gil_scoped_release>());
 
   // Lambda version of the above, in case that helps with the todo
   // m.def("load", [](std::string const& filename)
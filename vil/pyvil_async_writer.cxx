@@ -0,0 +1,203 @@
+#include "pyvil_async_writer.h"
+
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+
+#include <vil/vil_file_format.h>
+#include <vil/vil_image_view.h>
+#include <vil/vil_save.h>
+
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+save_future::save_future(std::string const& filename)
+  : filename_(filename), done_(false)
+{
+}
+
+bool save_future::done() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return done_;
+}
+
+bool save_future::wait(double timeout) const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (timeout < 0) {
+    cv_.wait(lock, [this] { return done_; });
+  }
+  else {
+    cv_.wait_for(lock, std::chrono::duration<double>(timeout), [this] { return done_; });
+  }
+  return done_;
+}
+
+void save_future::result() const
+{
+  wait();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!error_.empty()) {
+    throw std::runtime_error(error_);
+  }
+}
+
+void save_future::finish(std::string const& error)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+    error_ = error;
+  }
+  cv_.notify_all();
+}
+
+async_writer::async_writer(unsigned num_threads, std::size_t max_bytes)
+  : max_bytes_(max_bytes), pending_(0), pending_bytes_(0), closed_(false)
+{
+  if (num_threads == 0) {
+    throw std::invalid_argument("async_writer: needs at least one thread");
+  }
+  // populate the file format registry before the workers look at it
+  vil_file_format::all();
+  for (unsigned t = 0; t < num_threads; ++t) {
+    workers_.emplace_back(&async_writer::worker_loop, this);
+  }
+}
+
+async_writer::~async_writer()
+{
+  stop_workers();
+}
+
+template <class T>
+struct async_writer::copy_op {
+  static vil_image_view_base* run(vil_image_view_base const& view)
+  {
+    // compound pixels (e.g. RGB) are copied as planes of their components
+    std::unique_ptr<vil_image_view<T> > copy(new vil_image_view<T>);
+    copy->deep_copy(vil_image_view<T>(view));
+    return copy.release();
+  }
+};
+
+std::shared_ptr<save_future> async_writer::save(vil_image_view_base const& view,
+                                                std::string const& filename,
+                                                std::string const& file_format)
+{
+  // the caller may change view as soon as this returns, so the writer
+  // saves a copy of its own
+  std::unique_ptr<vil_image_view_base> copy(
+    dispatch_component_type<copy_op>(view.pixel_format(), view));
+  const std::size_t bytes = copy->size() * pixel_format_sizeof(copy->pixel_format());
+  auto future = std::make_shared<save_future>(filename);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_.wait(lock, [&] {
+    return closed_ || pending_bytes_ == 0 || pending_bytes_ + bytes <= max_bytes_;
+  });
+  if (closed_) {
+    throw std::runtime_error("async_writer: save after close");
+  }
+
+  // reference counts aren't atomic, so the copy is only ever owned by
+  // the queue and then by one worker, changing hands under the lock
+  queue_.push_back(request{copy.release(), filename, file_format, bytes, future});
+  ++pending_;
+  pending_bytes_ += bytes;
+  lock.unlock();
+  queued_.notify_one();
+  return future;
+}
+
+void async_writer::worker_loop()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    queued_.wait(lock, [this] { return closed_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+    request r = queue_.front();
+    queue_.pop_front();
+    lock.unlock();
+
+    std::string error;
+    try {
+      bool saved = r.file_format.empty() ? vil_save(*r.view, r.filename.c_str())
+                                         : vil_save(*r.view, r.filename.c_str(), r.file_format.c_str());
+      if (!saved) {
+        error = "Failed to save image to " + r.filename;
+      }
+    }
+    catch (std::exception const& e) {
+      error = "Failed to save image to " + r.filename + ": " + e.what();
+    }
+    r.future->finish(error);
+
+    lock.lock();
+    // drop the image while holding the lock, as it was handed over under it
+    r.view = nullptr;
+    if (!error.empty()) {
+      errors_.push_back(error);
+    }
+    --pending_;
+    pending_bytes_ -= r.bytes;
+    finished_.notify_all();
+  }
+}
+
+void async_writer::flush()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_.wait(lock, [this] { return pending_ == 0; });
+  if (errors_.empty()) {
+    return;
+  }
+
+  std::ostringstream buffer;
+  buffer << errors_.size() << " image(s) failed to save:";
+  for (auto const& error : errors_) {
+    buffer << "\n  " << error;
+  }
+  errors_.clear();
+  throw std::runtime_error(buffer.str());
+}
+
+void async_writer::close()
+{
+  stop_workers();
+  flush();
+}
+
+void async_writer::stop_workers()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+  }
+  // workers drain the queue before they see closed_
+  queued_.notify_all();
+  finished_.notify_all();
+  for (auto& worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+}
+
+std::size_t async_writer::pending() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_;
+}
+
+std::size_t async_writer::pending_bytes() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_bytes_;
+}
+
+}}
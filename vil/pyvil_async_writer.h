@@ -0,0 +1,104 @@
+#ifndef pyvil_async_writer_h_included_
+#define pyvil_async_writer_h_included_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vil/vil_image_view_base.h>
+
+namespace pyvxl { namespace vil {
+
+//: Handle to one queued save, completed by an async_writer thread
+class save_future {
+public:
+  explicit save_future(std::string const& filename);
+
+  std::string const& filename() const { return filename_; }
+
+  //: True once the image was written or failed to be
+  bool done() const;
+
+  //: Wait up to timeout seconds (forever if negative). Returns done().
+  bool wait(double timeout = -1.0) const;
+
+  //: Wait for the save, throwing if it failed
+  void result() const;
+
+private:
+  friend class async_writer;
+  void finish(std::string const& error);
+
+  std::string filename_;
+  bool done_;
+  std::string error_;
+  mutable std::mutex mutex_;
+  mutable std::condition_variable cv_;
+};
+
+/* Saves images on a few background threads, so the caller only pays for a
+ * copy of each image rather than for encoding and writing it. Queued images
+ * are limited to max_bytes in total: save() blocks while the queue is full
+ * (an image bigger than the limit is still accepted into an empty queue).
+ * Failures are reported by the save_future of each image, and all failures
+ * since the previous flush are raised again by flush() and close(). */
+class async_writer {
+public:
+  async_writer(unsigned num_threads, std::size_t max_bytes);
+  //: Finishes every queued save, ignoring any failures
+  ~async_writer();
+
+  async_writer(async_writer const&) = delete;
+  async_writer& operator=(async_writer const&) = delete;
+
+  //: Queue a copy of view to be saved as filename. An empty file_format
+  //  picks one from the extension.
+  std::shared_ptr<save_future> save(vil_image_view_base const& view,
+                                    std::string const& filename,
+                                    std::string const& file_format);
+
+  //: Wait for every queued save, then throw if any of them failed
+  void flush();
+
+  //: Flush and stop the writer threads. Later saves throw.
+  void close();
+
+  unsigned num_threads() const { return static_cast<unsigned>(workers_.size()); }
+  std::size_t max_bytes() const { return max_bytes_; }
+  //: Number of saves queued or being written
+  std::size_t pending() const;
+  //: Bytes of image data queued or being written
+  std::size_t pending_bytes() const;
+
+private:
+  template <class T> struct copy_op;
+
+  struct request {
+    vil_image_view_base_sptr view;
+    std::string filename, file_format;
+    std::size_t bytes;
+    std::shared_ptr<save_future> future;
+  };
+
+  void worker_loop();
+  void stop_workers();
+
+  std::size_t max_bytes_;
+  std::vector<std::thread> workers_;
+  std::deque<request> queue_;
+  std::size_t pending_, pending_bytes_;
+  std::vector<std::string> errors_;
+  bool closed_;
+  mutable std::mutex mutex_;
+  // signalled when a request is queued, and when one finishes
+  std::condition_variable queued_, finished_;
+};
+
+}}
+
+#endif
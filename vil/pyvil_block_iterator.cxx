@@ -0,0 +1,184 @@
+#include "pyvil_block_iterator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <vil/vil_property.h>
+
+#include "pyvil_concurrent_resource.h"
+
+namespace pyvxl { namespace vil {
+
+bool native_block_size(vil_image_resource const& resource,
+                       unsigned& block_ni, unsigned& block_nj)
+{
+  unsigned size_i = 0, size_j = 0;
+  if (resource.get_property(vil_property_size_block_i, &size_i) &&
+      resource.get_property(vil_property_size_block_j, &size_j) &&
+      size_i > 0 && size_j > 0) {
+    block_ni = size_i;
+    block_nj = size_j;
+    return true;
+  }
+  return false;
+}
+
+namespace {
+
+const unsigned default_block_size = 512;
+
+// Round a requested block size up to a multiple of the native block size
+unsigned align_block_size(unsigned requested, unsigned native)
+{
+  if (requested == 0) {
+    return native;
+  }
+  return ((requested + native - 1) / native) * native;
+}
+
+}
+
+image_block_iterator::image_block_iterator(vil_image_resource_sptr const& resource,
+                                           unsigned block_ni, unsigned block_nj,
+                                           unsigned overlap, unsigned read_ahead)
+  : resource_(resource), overlap_(overlap), read_ahead_(read_ahead),
+    next_(0), stop_(false), done_(false)
+{
+  if (!resource_) {
+    throw std::invalid_argument("image_block_iterator: null image resource");
+  }
+  lock_reads_ = !reads_concurrently(*resource_);
+
+  unsigned native_ni, native_nj;
+  if (native_block_size(*resource_, native_ni, native_nj)) {
+    block_ni_ = align_block_size(block_ni, native_ni);
+    block_nj_ = align_block_size(block_nj, native_nj);
+  }
+  else {
+    block_ni_ = block_ni ? block_ni : default_block_size;
+    block_nj_ = block_nj ? block_nj : default_block_size;
+  }
+
+  n_block_i_ = (resource_->ni() + block_ni_ - 1) / block_ni_;
+  n_block_j_ = (resource_->nj() + block_nj_ - 1) / block_nj_;
+
+  if (n_blocks() == 0) {
+    done_ = true;
+  }
+  else if (read_ahead_ > 0) {
+    thread_ = std::thread(&image_block_iterator::read_ahead_loop, this);
+  }
+}
+
+image_block_iterator::~image_block_iterator()
+{
+  stop();
+}
+
+void image_block_iterator::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+image_block_iterator::block image_block_iterator::decode(std::size_t k) const
+{
+  const unsigned bi = static_cast<unsigned>(k % n_block_i_);
+  const unsigned bj = static_cast<unsigned>(k / n_block_i_);
+
+  // the block plus its halo, clipped to the image
+  const unsigned i_begin = bi * block_ni_, j_begin = bj * block_nj_;
+  const unsigned i0 = i_begin > overlap_ ? i_begin - overlap_ : 0;
+  const unsigned j0 = j_begin > overlap_ ? j_begin - overlap_ : 0;
+  const unsigned i1 = std::min(resource_->ni(), i_begin + block_ni_ + overlap_);
+  const unsigned j1 = std::min(resource_->nj(), j_begin + block_nj_ + overlap_);
+
+  // always a copy, so blocks never share memory with the resource
+  block b;
+  b.i0 = i0;
+  b.j0 = j0;
+  b.view = read(i0, i1 - i0, j0, j1 - j0);
+  if (!b.view) {
+    throw std::runtime_error("image_block_iterator: failed to read block");
+  }
+  return b;
+}
+
+vil_image_view_base_sptr image_block_iterator::read(unsigned i0, unsigned n_i, unsigned j0, unsigned n_j) const
+{
+  std::unique_lock<std::mutex> lock(read_mutex_, std::defer_lock);
+  if (lock_reads_) {
+    lock.lock();
+  }
+  return resource_->get_copy_view(i0, n_i, j0, n_j);
+}
+
+void image_block_iterator::read_ahead_loop()
+{
+  for (std::size_t k = 0; k < n_blocks(); ++k) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stop_ || queue_.size() < read_ahead_; });
+      if (stop_) {
+        break;
+      }
+    }
+
+    block b;
+    std::exception_ptr error;
+    try {
+      b = decode(k);
+    }
+    catch (...) {
+      error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error) {
+      error_ = error;
+      break;
+    }
+    queue_.push_back(b);
+    // drop our reference while the consumer can't touch the view yet
+    b.view = nullptr;
+    cv_.notify_all();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  done_ = true;
+  cv_.notify_all();
+}
+
+bool image_block_iterator::next(block& b)
+{
+  if (read_ahead_ == 0) {
+    if (next_ >= n_blocks()) {
+      return false;
+    }
+    b = decode(next_++);
+    return true;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return !queue_.empty() || done_; });
+  if (!queue_.empty()) {
+    b = queue_.front();
+    queue_.pop_front();
+    cv_.notify_all();
+    return true;
+  }
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+  return false;
+}
+
+}}
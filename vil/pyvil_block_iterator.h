@@ -0,0 +1,86 @@
+#ifndef pyvil_block_iterator_h_included_
+#define pyvil_block_iterator_h_included_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include <vil/vil_image_resource.h>
+#include <vil/vil_image_view_base.h>
+
+namespace pyvxl { namespace vil {
+
+//: The native block size of a resource, or false if it isn't blocked
+bool native_block_size(vil_image_resource const& resource,
+                       unsigned& block_ni, unsigned& block_nj);
+
+/* Walks an image resource in aligned blocks, row of blocks by row of blocks.
+ * Each view covers one block plus a halo of overlap pixels on every side
+ * (clipped to the image). A background thread decodes up to read_ahead
+ * blocks ahead of the consumer; with read_ahead 0 each block is decoded
+ * when it is asked for.
+ *
+ * vil's file resources keep a single file position and decoder state, so
+ * unless the resource reads concurrently (see reads_concurrently) nothing
+ * else may read it while a read ahead iterator is live. read() decodes
+ * other windows under the same lock as the background thread. */
+class image_block_iterator {
+public:
+  struct block {
+    unsigned i0, j0;  // top left of the view in the image
+    vil_image_view_base_sptr view;
+  };
+
+  //: block_ni/block_nj of 0 use the native block size, which sizes given
+  //  by the caller are also rounded up to a multiple of
+  image_block_iterator(vil_image_resource_sptr const& resource,
+                       unsigned block_ni, unsigned block_nj,
+                       unsigned overlap, unsigned read_ahead);
+  virtual ~image_block_iterator();
+
+  image_block_iterator(image_block_iterator const&) = delete;
+  image_block_iterator& operator=(image_block_iterator const&) = delete;
+
+  //: Wait for the next block. Returns false once all blocks were returned,
+  //  and rethrows any error raised while decoding.
+  bool next(block& b);
+
+  //: Stop reading ahead. Called by the destructor.
+  void stop();
+
+  //: A copy of a window of the resource, safe to call while reading ahead
+  vil_image_view_base_sptr read(unsigned i0, unsigned n_i, unsigned j0, unsigned n_j) const;
+
+  unsigned block_ni() const { return block_ni_; }
+  unsigned block_nj() const { return block_nj_; }
+  unsigned n_block_i() const { return n_block_i_; }
+  unsigned n_block_j() const { return n_block_j_; }
+  std::size_t n_blocks() const { return std::size_t(n_block_i_) * n_block_j_; }
+
+private:
+  block decode(std::size_t k) const;
+  void read_ahead_loop();
+
+  vil_image_resource_sptr resource_;
+  unsigned block_ni_, block_nj_, n_block_i_, n_block_j_;
+  unsigned overlap_;
+  std::size_t read_ahead_;
+  // held around every read of a resource which can't be read concurrently
+  bool lock_reads_;
+  mutable std::mutex read_mutex_;
+
+  std::size_t next_;  // next block handed out (synchronous mode)
+  std::deque<block> queue_;
+  bool stop_, done_;
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+};
+
+}}
+
+#endif
@@ -0,0 +1,197 @@
+#include "pyvil_cached_resource.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <vil/vil_copy.h>
+#include <vil/vil_crop.h>
+#include <vil/vil_image_view.h>
+
+#include "pyvil_block_iterator.h"
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+namespace {
+
+const unsigned default_cache_block_size = 256;
+
+std::uint64_t block_key(unsigned bi, unsigned bj)
+{
+  return (static_cast<std::uint64_t>(bj) << 32) | bi;
+}
+
+}
+
+cached_image_resource::cached_image_resource(vil_image_resource_sptr const& source,
+                                             std::size_t max_bytes,
+                                             unsigned block_ni, unsigned block_nj)
+  : source_(source), max_bytes_(max_bytes),
+    bytes_(0), hits_(0), misses_(0), evictions_(0)
+{
+  if (!source_) {
+    throw std::invalid_argument("cached_image_resource: null image resource");
+  }
+
+  unsigned native_ni, native_nj;
+  if (!native_block_size(*source_, native_ni, native_nj)) {
+    native_ni = native_nj = default_cache_block_size;
+  }
+  block_ni_ = block_ni ? block_ni : native_ni;
+  block_nj_ = block_nj ? block_nj : native_nj;
+}
+
+vil_image_view_base_sptr cached_image_resource::block(unsigned bi, unsigned bj) const
+{
+  const std::uint64_t key = block_key(bi, bj);
+  auto it = blocks_.find(key);
+  if (it != blocks_.end()) {
+    ++hits_;
+    lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+    return it->second.view;
+  }
+
+  ++misses_;
+  const unsigned i0 = bi * block_ni_, j0 = bj * block_nj_;
+  const unsigned n_i = std::min(block_ni_, ni() - i0);
+  const unsigned n_j = std::min(block_nj_, nj() - j0);
+  vil_image_view_base_sptr view = source_->get_copy_view(i0, n_i, j0, n_j);
+  if (!view) {
+    return view;
+  }
+
+  lru_.push_front(key);
+  entry& e = blocks_[key];
+  e.view = view;
+  e.bytes = view->size() * pixel_format_sizeof(view->pixel_format());
+  e.lru_position = lru_.begin();
+  bytes_ += e.bytes;
+
+  // keep at least the block just decoded, even when it alone is over budget
+  evict_to(max_bytes_);
+  return view;
+}
+
+void cached_image_resource::evict_to(std::size_t max_bytes) const
+{
+  while (bytes_ > max_bytes && lru_.size() > 1) {
+    auto it = blocks_.find(lru_.back());
+    bytes_ -= it->second.bytes;
+    blocks_.erase(it);
+    lru_.pop_back();
+    ++evictions_;
+  }
+}
+
+template <class T>
+struct cached_image_resource::assemble_op {
+  static vil_image_view_base_sptr run(cached_image_resource const& cache,
+                                      unsigned i0, unsigned n_i, unsigned j0, unsigned n_j)
+  {
+    const unsigned bi0 = i0 / cache.block_ni_, bi1 = (i0 + n_i - 1) / cache.block_ni_;
+    const unsigned bj0 = j0 / cache.block_nj_, bj1 = (j0 + n_j - 1) / cache.block_nj_;
+
+    vil_image_view<T> window;
+    for (unsigned bj = bj0; bj <= bj1; ++bj) {
+      for (unsigned bi = bi0; bi <= bi1; ++bi) {
+        vil_image_view_base_sptr base = cache.block(bi, bj);
+        if (!base) {
+          return nullptr;
+        }
+        // compound pixels (e.g. RGB) are seen as planes of their components
+        vil_image_view<T> block_view(*base);
+        if (window.size() == 0) {
+          window.set_size(n_i, n_j, block_view.nplanes());
+        }
+
+        // overlap of the block and the window, in image coordinates
+        const unsigned block_i0 = bi * cache.block_ni_, block_j0 = bj * cache.block_nj_;
+        const unsigned ci0 = std::max(i0, block_i0), cj0 = std::max(j0, block_j0);
+        const unsigned ci1 = std::min(i0 + n_i, block_i0 + block_view.ni());
+        const unsigned cj1 = std::min(j0 + n_j, block_j0 + block_view.nj());
+        vil_copy_to_window(vil_crop(block_view, ci0 - block_i0, ci1 - ci0, cj0 - block_j0, cj1 - cj0),
+                           window, ci0 - i0, cj0 - j0);
+      }
+    }
+    return new vil_image_view<T>(window);
+  }
+};
+
+vil_image_view_base_sptr cached_image_resource::get_copy_view(unsigned i0, unsigned n_i,
+                                                              unsigned j0, unsigned n_j) const
+{
+  if (n_i == 0 || n_j == 0 || std::size_t(i0) + n_i > ni() || std::size_t(j0) + n_j > nj()) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dispatch_component_type<assemble_op>(pixel_format(), *this, i0, n_i, j0, n_j);
+}
+
+bool cached_image_resource::put_view(vil_image_view_base const& im, unsigned i0, unsigned j0)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!source_->put_view(im, i0, j0)) {
+    return false;
+  }
+
+  // drop the blocks which are now stale
+  if (im.ni() > 0 && im.nj() > 0) {
+    for (unsigned bj = j0 / block_nj_; bj <= (j0 + im.nj() - 1) / block_nj_; ++bj) {
+      for (unsigned bi = i0 / block_ni_; bi <= (i0 + im.ni() - 1) / block_ni_; ++bi) {
+        auto it = blocks_.find(block_key(bi, bj));
+        if (it != blocks_.end()) {
+          bytes_ -= it->second.bytes;
+          lru_.erase(it->second.lru_position);
+          blocks_.erase(it);
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool cached_image_resource::get_property(char const* tag, void* property_value) const
+{
+  return source_->get_property(tag, property_value);
+}
+
+std::size_t cached_image_resource::hits() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+std::size_t cached_image_resource::misses() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+std::size_t cached_image_resource::evictions() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return evictions_;
+}
+
+std::size_t cached_image_resource::bytes() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bytes_;
+}
+
+std::size_t cached_image_resource::n_cached_blocks() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return blocks_.size();
+}
+
+void cached_image_resource::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  lru_.clear();
+  blocks_.clear();
+  bytes_ = 0;
+}
+
+}}
@@ -0,0 +1,85 @@
+#ifndef pyvil_cached_resource_h_included_
+#define pyvil_cached_resource_h_included_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include <vil/vil_image_resource.h>
+#include <vil/vil_image_view_base.h>
+#include <vil/vil_smart_ptr.h>
+
+namespace pyvxl { namespace vil {
+
+/* An image resource which decorates another resource with an LRU cache of
+ * decoded blocks. Windows are assembled from cached blocks, so overlapping
+ * or repeated get_view calls only decode each block once while it stays
+ * within the byte budget. put_view writes through to the source and drops
+ * the blocks it overlaps. */
+class cached_image_resource : public vil_image_resource {
+public:
+  //: block_ni/block_nj of 0 use the native block size of the source
+  cached_image_resource(vil_image_resource_sptr const& source, std::size_t max_bytes,
+                        unsigned block_ni = 0, unsigned block_nj = 0);
+
+  unsigned nplanes() const override { return source_->nplanes(); }
+  unsigned ni() const override { return source_->ni(); }
+  unsigned nj() const override { return source_->nj(); }
+  enum vil_pixel_format pixel_format() const override { return source_->pixel_format(); }
+
+  vil_image_view_base_sptr get_copy_view(unsigned i0, unsigned n_i,
+                                         unsigned j0, unsigned n_j) const override;
+  using vil_image_resource::get_copy_view;
+
+  bool put_view(vil_image_view_base const& im, unsigned i0, unsigned j0) override;
+  using vil_image_resource::put_view;
+
+  char const* file_format() const override { return source_->file_format(); }
+  bool get_property(char const* tag, void* property_value = nullptr) const override;
+
+  vil_image_resource_sptr source() const { return source_; }
+  unsigned block_ni() const { return block_ni_; }
+  unsigned block_nj() const { return block_nj_; }
+  std::size_t max_bytes() const { return max_bytes_; }
+
+  // cache statistics
+  std::size_t hits() const;
+  std::size_t misses() const;
+  std::size_t evictions() const;
+  std::size_t bytes() const;
+  std::size_t n_cached_blocks() const;
+
+  //: Drop every cached block
+  void clear();
+
+private:
+  struct entry {
+    vil_image_view_base_sptr view;
+    std::size_t bytes;
+    std::list<std::uint64_t>::iterator lru_position;
+  };
+
+  template <class T> struct assemble_op;
+
+  //: The decoded block (bi, bj), from the cache if possible. Needs mutex_.
+  vil_image_view_base_sptr block(unsigned bi, unsigned bj) const;
+  void evict_to(std::size_t max_bytes) const;
+
+  vil_image_resource_sptr source_;
+  std::size_t max_bytes_;
+  unsigned block_ni_, block_nj_;
+
+  // most recently used block keys first
+  mutable std::list<std::uint64_t> lru_;
+  mutable std::unordered_map<std::uint64_t, entry> blocks_;
+  mutable std::size_t bytes_, hits_, misses_, evictions_;
+  mutable std::mutex mutex_;
+};
+
+typedef vil_smart_ptr<cached_image_resource> cached_image_resource_sptr;
+
+}}
+
+#endif
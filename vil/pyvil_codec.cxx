@@ -0,0 +1,101 @@
+#include "pyvil_codec.h"
+
+#include <stdexcept>
+
+#include <vil/vil_config.h>
+#include <vil/vil_image_view.h>
+#include <vil/vil_load.h>
+#include <vil/vil_new.h>
+#include <vil/vil_smart_ptr.h>
+#include <vil/vil_stream_core.h>
+#if HAS_JPEG
+#include <vil/file_formats/vil_jpeg.h>
+#endif
+
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+namespace {
+
+void apply_options(vil_image_resource_sptr const& resource, std::string const& file_format,
+                   encode_options const& options)
+{
+  if (options.jpeg_quality == -1) {
+    return;
+  }
+#if HAS_JPEG
+  if (vil_jpeg_image* jpeg = dynamic_cast<vil_jpeg_image*>(resource.ptr())) {
+    jpeg->set_quality(options.jpeg_quality);
+    return;
+  }
+#endif
+  throw std::invalid_argument("encode: quality doesn't apply to file format " + file_format);
+}
+
+template <class T>
+struct put_op {
+  // compound pixels are written as planes of their components, as vil_save does
+  static bool run(vil_image_view_base const& view, vil_image_resource_sptr const& resource)
+  {
+    return resource->put_view(vil_image_view<T>(view), 0, 0);
+  }
+};
+
+}
+
+std::string encode_view(vil_image_view_base const& view, std::string const& file_format,
+                        encode_options const& options)
+{
+  if (file_format.empty()) {
+    throw std::invalid_argument("encode: no file format given");
+  }
+  if (options.jpeg_quality != -1 && (options.jpeg_quality < 1 || options.jpeg_quality > 100)) {
+    throw std::invalid_argument("encode: quality must be from 1 to 100");
+  }
+  vil_smart_ptr<vil_stream_core> stream = new vil_stream_core;
+  {
+    // the encoder finishes the file when the resource goes
+    const vil_pixel_format format = view.pixel_format();
+    vil_image_resource_sptr resource =
+      vil_new_image_resource(stream.ptr(), view.ni(), view.nj(),
+                             view.nplanes() * vil_pixel_format_num_components(format),
+                             vil_pixel_format_component_format(format), file_format.c_str());
+    if (!resource) {
+      throw std::runtime_error("encode: file format " + file_format + " can't hold this image");
+    }
+    apply_options(resource, file_format, options);
+    if (!dispatch_component_type<put_op>(format, view, resource)) {
+      throw std::runtime_error("encode: failed to encode the image as " + file_format);
+    }
+  }
+
+  std::string data(static_cast<std::size_t>(stream->file_size()), '\0');
+  if (!data.empty()) {
+    stream->m_transfer(&data[0], 0, stream->file_size(), true);
+  }
+  return data;
+}
+
+vil_image_resource_sptr decode_resource(std::string const& data)
+{
+  vil_smart_ptr<vil_stream_core> stream = new vil_stream_core;
+  stream->write(data.data(), static_cast<vil_streampos>(data.size()));
+  stream->seek(0);
+  vil_image_resource_sptr resource = vil_load_image_resource_raw(stream.ptr(), false);
+  if (!resource) {
+    throw std::runtime_error("decode: unknown or corrupt image data");
+  }
+  return resource;
+}
+
+vil_image_view_base_sptr decode_view(std::string const& data)
+{
+  vil_image_view_base_sptr view = decode_resource(data)->get_view();
+  if (!view) {
+    throw std::runtime_error("decode: failed to decode the image");
+  }
+  return view;
+}
+
+}}
@@ -0,0 +1,33 @@
+#ifndef pyvil_codec_h_included_
+#define pyvil_codec_h_included_
+
+#include <string>
+
+#include <vil/vil_image_resource.h>
+#include <vil/vil_image_view_base.h>
+
+namespace pyvxl { namespace vil {
+
+/* Encoding and decoding image files held in memory, through vil's file
+ * formats writing to and reading from a vil_stream_core, so no temporary
+ * file is needed. */
+
+//: Settings of the encoders which have any
+struct encode_options {
+  int jpeg_quality = -1;  // 1 to 100, or -1 for vil's default
+};
+
+//: The file view would be saved as in file_format ("png", "jpeg", "tiff", ...)
+std::string encode_view(vil_image_view_base const& view, std::string const& file_format,
+                        encode_options const& options);
+
+//: A resource reading the image in data, whose format is detected as
+//  vil_load does. The resource keeps its own copy of data.
+vil_image_resource_sptr decode_resource(std::string const& data);
+
+//: The whole image in data, in the pixel format of the file
+vil_image_view_base_sptr decode_view(std::string const& data);
+
+}}
+
+#endif
@@ -0,0 +1,110 @@
+#include "pyvil_concurrent_resource.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#include <vil/vil_file_format.h>
+#include <vil/vil_load.h>
+
+#include "pyvil_mmap_resource.h"
+
+namespace pyvxl { namespace vil {
+
+concurrent_image_resource::concurrent_image_resource(std::string const& filename, unsigned max_handles)
+  : filename_(filename), max_handles_(max_handles ? max_handles : std::max(1u, std::thread::hardware_concurrency()))
+{
+  // populate the file format registry before several threads look at it
+  vil_file_format::all();
+
+  vil_image_resource_sptr first = open();
+  ni_ = first->ni();
+  nj_ = first->nj();
+  nplanes_ = first->nplanes();
+  format_ = first->pixel_format();
+  file_format_ = first->file_format() ? first->file_format() : "";
+  handles_.push_back(first);
+  free_.push_back(first.ptr());
+  n_handles_ = 1;
+}
+
+vil_image_resource_sptr concurrent_image_resource::open() const
+{
+  vil_image_resource_sptr r = vil_load_image_resource(filename_.c_str(), false);
+  if (!r) {
+    throw std::runtime_error("Failed to load image resource " + filename_);
+  }
+  return r;
+}
+
+concurrent_image_resource::lease::lease(concurrent_image_resource const& owner)
+  : owner_(owner), handle_(nullptr)
+{
+  std::unique_lock<std::mutex> lock(owner_.mutex_);
+  owner_.available_.wait(lock, [this] {
+    return !owner_.free_.empty() || owner_.n_handles_ < owner_.max_handles_;
+  });
+  if (!owner_.free_.empty()) {
+    handle_ = owner_.free_.back();
+    owner_.free_.pop_back();
+    return;
+  }
+
+  // count the handle now, then open it without holding the lock
+  ++owner_.n_handles_;
+  lock.unlock();
+  vil_image_resource_sptr opened;
+  try {
+    opened = owner_.open();
+  }
+  catch (...) {
+    lock.lock();
+    --owner_.n_handles_;
+    owner_.available_.notify_one();
+    throw;
+  }
+  lock.lock();
+  handle_ = opened.ptr();
+  owner_.handles_.push_back(opened);
+}
+
+concurrent_image_resource::lease::~lease()
+{
+  std::lock_guard<std::mutex> lock(owner_.mutex_);
+  owner_.free_.push_back(handle_);
+  owner_.available_.notify_one();
+}
+
+vil_image_view_base_sptr concurrent_image_resource::get_view(unsigned i0, unsigned n_i,
+                                                             unsigned j0, unsigned n_j) const
+{
+  lease handle(*this);
+  return handle->get_view(i0, n_i, j0, n_j);
+}
+
+vil_image_view_base_sptr concurrent_image_resource::get_copy_view(unsigned i0, unsigned n_i,
+                                                                  unsigned j0, unsigned n_j) const
+{
+  lease handle(*this);
+  return handle->get_copy_view(i0, n_i, j0, n_j);
+}
+
+bool concurrent_image_resource::get_property(char const* tag, void* property_value) const
+{
+  lease handle(*this);
+  return handle->get_property(tag, property_value);
+}
+
+unsigned concurrent_image_resource::n_open_handles() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<unsigned>(handles_.size());
+}
+
+bool reads_concurrently(vil_image_resource const& resource)
+{
+  return dynamic_cast<concurrent_image_resource const*>(&resource) ||
+         dynamic_cast<mmap_image_resource const*>(&resource);
+}
+
+}}
@@ -0,0 +1,94 @@
+#ifndef pyvil_concurrent_resource_h_included_
+#define pyvil_concurrent_resource_h_included_
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <vil/vil_image_resource.h>
+#include <vil/vil_image_view_base.h>
+#include <vil/vil_smart_ptr.h>
+
+namespace pyvxl { namespace vil {
+
+/* A read-only image resource which any number of threads may read at once.
+ * vil's file resources keep a single file position and decoder state, so
+ * this one keeps a pool of resources of the same file, each opened on its
+ * own handle. A read borrows a free handle (opening another while fewer
+ * than max_handles are open, waiting otherwise), decodes its window
+ * without holding any lock, and hands the handle back. */
+class concurrent_image_resource : public vil_image_resource {
+public:
+  //: max_handles of 0 allows one per core
+  concurrent_image_resource(std::string const& filename, unsigned max_handles);
+
+  unsigned nplanes() const override { return nplanes_; }
+  unsigned ni() const override { return ni_; }
+  unsigned nj() const override { return nj_; }
+  enum vil_pixel_format pixel_format() const override { return format_; }
+
+  vil_image_view_base_sptr get_view(unsigned i0, unsigned n_i,
+                                    unsigned j0, unsigned n_j) const override;
+  using vil_image_resource::get_view;
+  vil_image_view_base_sptr get_copy_view(unsigned i0, unsigned n_i,
+                                         unsigned j0, unsigned n_j) const override;
+  using vil_image_resource::get_copy_view;
+
+  //: Read only
+  bool put_view(vil_image_view_base const&, unsigned, unsigned) override { return false; }
+  using vil_image_resource::put_view;
+
+  char const* file_format() const override { return file_format_.c_str(); }
+  bool get_property(char const* tag, void* property_value = nullptr) const override;
+
+  std::string const& filename() const { return filename_; }
+  unsigned max_handles() const { return max_handles_; }
+  //: Handles opened so far, never more than max_handles
+  unsigned n_open_handles() const;
+
+private:
+  //: A handle to read with, returned to the pool when it goes
+  class lease {
+  public:
+    explicit lease(concurrent_image_resource const& owner);
+    ~lease();
+    lease(lease const&) = delete;
+    lease& operator=(lease const&) = delete;
+
+    vil_image_resource* operator->() const { return handle_; }
+
+  private:
+    concurrent_image_resource const& owner_;
+    vil_image_resource* handle_;
+  };
+
+  //: A new resource of filename, throwing if it can't be opened
+  vil_image_resource_sptr open() const;
+
+  std::string filename_;
+  unsigned max_handles_;
+  unsigned ni_, nj_, nplanes_;
+  vil_pixel_format format_;
+  std::string file_format_;
+
+  // every handle opened, and those not lent out
+  mutable std::vector<vil_image_resource_sptr> handles_;
+  mutable std::vector<vil_image_resource*> free_;
+  // handles opened or being opened
+  mutable unsigned n_handles_;
+  mutable std::mutex mutex_;
+  mutable std::condition_variable available_;
+};
+
+typedef vil_smart_ptr<concurrent_image_resource> concurrent_image_resource_sptr;
+
+//: Whether any number of threads may read resource at once: true of a
+//  concurrent_image_resource, and of an mmap_image_resource, whose views
+//  share nothing but the mapping
+bool reads_concurrently(vil_image_resource const& resource);
+
+}}
+
+#endif
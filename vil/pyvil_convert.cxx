@@ -0,0 +1,127 @@
+#include "pyvil_convert.h"
+
+#include <stdexcept>
+
+#include <vil/vil_image_view.h>
+
+#include "pyvil_disk_view.h"
+#include "pyvil_parallel.h"
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+namespace {
+
+bool cpu_has_avx2()
+{
+#if defined(PYVXL_VIL_HAVE_AVX2_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#else
+  return false;
+#endif
+}
+
+// Instruction set of the table select_convert_table chose. Kept here since
+// nothing in the AVX2 build may run, even to compare tables, without AVX2.
+char const* selected_isa = "sse2";
+
+convert_table const& select_convert_table()
+{
+#if defined(PYVXL_VIL_HAVE_AVX2_KERNELS)
+  if (cpu_has_avx2()) {
+    selected_isa = "avx2";
+    return convert_table_avx2();
+  }
+#endif
+  return convert_table_sse2();
+}
+
+//: Position of a component format in the table, or -1
+int convert_index(vil_pixel_format format)
+{
+  switch (format) {
+    case VIL_PIXEL_FORMAT_BYTE:    return convert_byte;
+    case VIL_PIXEL_FORMAT_UINT_16: return convert_uint16;
+    case VIL_PIXEL_FORMAT_INT_16:  return convert_int16;
+    case VIL_PIXEL_FORMAT_INT_32:  return convert_int32;
+    case VIL_PIXEL_FORMAT_FLOAT:   return convert_float;
+    case VIL_PIXEL_FORMAT_DOUBLE:  return convert_double;
+    default:                       return -1;
+  }
+}
+
+//: Memory layout of a view seen as planes of its components, steps in pixels
+struct plane_layout {
+  char* data;
+  std::ptrdiff_t istep, jstep, planestep;
+  std::size_t pixel_size;
+  unsigned nplanes;
+};
+
+template <class T>
+struct layout_op {
+  static plane_layout run(vil_image_view_base const& view)
+  {
+    // shares the memory of view, so the pointer stays valid after c goes
+    vil_image_view<T> c(view);
+    return plane_layout{reinterpret_cast<char*>(c.top_left_ptr()), c.istep(), c.jstep(),
+                        c.planestep(), sizeof(T), c.nplanes()};
+  }
+};
+
+}
+
+convert_table const& active_convert_table()
+{
+  static convert_table const& table = select_convert_table();
+  return table;
+}
+
+char const* convert_kernel_isa()
+{
+  // the table is chosen, and selected_isa set, on first use
+  active_convert_table();
+  return selected_isa;
+}
+
+vil_image_view_base_sptr convert_view(vil_image_view_base const& src, vil_pixel_format format,
+                                      conversion_rounding rounding, bool saturate)
+{
+  const vil_pixel_format src_format = vil_pixel_format_component_format(src.pixel_format());
+  const vil_pixel_format dest_format = vil_pixel_format_component_format(format);
+  const int s = convert_index(src_format), d = convert_index(dest_format);
+  if (s < 0 || d < 0 || (format != dest_format && format != VIL_PIXEL_FORMAT_RGB_BYTE)) {
+    throw std::invalid_argument("convert: unsupported pixel format");
+  }
+
+  const unsigned ni = src.ni(), nj = src.nj();
+  const unsigned src_planes = src.nplanes() * vil_pixel_format_num_components(src.pixel_format());
+  if (format == VIL_PIXEL_FORMAT_RGB_BYTE && src_planes != 3) {
+    throw std::invalid_argument("convert: an RGB image needs 3 planes");
+  }
+  // on disk when src is
+  vil_image_view_base_sptr result =
+    new_view_like(src, ni, nj, format == VIL_PIXEL_FORMAT_RGB_BYTE ? 1 : src_planes, format);
+  if (ni == 0 || nj == 0 || src_planes == 0) {
+    return result;
+  }
+
+  const plane_layout in = dispatch_component_type<layout_op>(src_format, src);
+  const plane_layout out = dispatch_component_type<layout_op>(dest_format, *result);
+  const convert_row_function kernel =
+    active_convert_table().kernels[s][d][rounding == conversion_rounding::nearest][saturate];
+
+  parallel_for_rows(ni, nj, [&](unsigned j0, unsigned j1) {
+    for (unsigned p = 0; p < src_planes; ++p) {
+      for (unsigned j = j0; j < j1; ++j) {
+        char const* src_row = in.data + (p * in.planestep + j * in.jstep) * std::ptrdiff_t(in.pixel_size);
+        char* dest_row = out.data + (p * out.planestep + j * out.jstep) * std::ptrdiff_t(out.pixel_size);
+        kernel(src_row, in.istep, dest_row, out.istep, ni);
+      }
+    }
+  });
+  return result;
+}
+
+}}
@@ -0,0 +1,61 @@
+#ifndef pyvil_convert_h_included_
+#define pyvil_convert_h_included_
+
+#include <cstddef>
+
+#include <vil/vil_image_view_base.h>
+#include <vil/vil_pixel_format.h>
+
+namespace pyvxl { namespace vil {
+
+/* Pixel type conversion between every pair of wrapped component types.
+ * Each pair has a row kernel written so the compiler vectorises it, and
+ * the kernels are built once for SSE2 and once for AVX2; the AVX2 table
+ * is used when the CPU running the module supports it. */
+
+//: How a floating point value becomes an integer
+enum class conversion_rounding {
+  truncate,  // towards zero, as a C++ cast
+  nearest    // to the nearest integer, halves to even
+};
+
+//: Component types of the conversion table
+enum convert_type {
+  convert_byte, convert_uint16, convert_int16, convert_int32, convert_float, convert_double,
+  n_convert_types
+};
+
+//: Convert n pixels from src to dest, steps given in pixels
+typedef void (*convert_row_function)(void const* src, std::ptrdiff_t src_step,
+                                     void* dest, std::ptrdiff_t dest_step, std::size_t n);
+
+//: Kernels by [source][destination][rounding][saturate]
+struct convert_table {
+  convert_row_function kernels[n_convert_types][n_convert_types][2][2];
+};
+
+convert_table const& convert_table_sse2();
+#if defined(PYVXL_VIL_HAVE_AVX2_KERNELS)
+convert_table const& convert_table_avx2();
+#endif
+
+//: The table for this CPU
+convert_table const& active_convert_table();
+
+//: Instruction set of active_convert_table, "avx2" or "sse2"
+char const* convert_kernel_isa();
+
+/* A new view of src with pixels of format, which is one of the table's
+ * types or VIL_PIXEL_FORMAT_RGB_BYTE. Compound source pixels are converted
+ * as planes of their components, and an RGB destination takes its three
+ * components from three planes. With saturate, values beyond the range of
+ * an integer type are clamped to it (NaN becoming 0). Otherwise floating
+ * point values are clamped to the range of int (NaN becoming 0) and cast
+ * through it, and integers beyond a narrower type wrap around. Rows are
+ * converted in parallel on the shared thread pool. */
+vil_image_view_base_sptr convert_view(vil_image_view_base const& src, vil_pixel_format format,
+                                      conversion_rounding rounding, bool saturate);
+
+}}
+
+#endif
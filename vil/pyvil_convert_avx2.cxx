@@ -0,0 +1,13 @@
+// The conversion kernels built for AVX2, see CMakeLists.txt
+#define PYVXL_VIL_KERNEL_ISA avx2
+#include "pyvil_convert_kernels.h"
+
+namespace pyvxl { namespace vil {
+
+convert_table const& convert_table_avx2()
+{
+  static const convert_table table = avx2::make_convert_table();
+  return table;
+}
+
+}}
@@ -0,0 +1,163 @@
+// Row kernels of the conversion table. Included once per instruction set by
+// pyvil_convert_<isa>.cxx, with PYVXL_VIL_KERNEL_ISA naming the namespace
+// the kernels of that build live in, so the builds never mix at link time.
+#ifndef PYVXL_VIL_KERNEL_ISA
+#error "Define PYVXL_VIL_KERNEL_ISA before including pyvil_convert_kernels.h"
+#endif
+
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+#include <vil/vil_pixel_format.h>
+
+#include "pyvil_convert.h"
+
+namespace pyvxl { namespace vil { namespace PYVXL_VIL_KERNEL_ISA {
+
+// Inline functions from outside this namespace (std::min and the like) may
+// be emitted out of line, and the linker would then keep just one build of
+// them for every instruction set, so the kernels only use their own.
+template <class T>
+inline T clamp_to(T v, T lo, T hi)
+{
+  return v < lo ? lo : (hi < v ? hi : v);
+}
+
+//: v rounded to the nearest integer, half to even, for |v| below 2^23 if
+//  R is float or 2^52 if double. Adding that to |v| leaves no bits for a
+//  fraction, so the add rounds as nearbyint does, but unlike a call to
+//  nearbyint it vectorises on SSE2.
+template <class R>
+inline R round_small(R v)
+{
+  const R big = sizeof(R) == 4 ? R(8388608.0) : R(4503599627370496.0);
+  const R r = ((v < 0 ? -v : v) + big) - big;
+  return v < 0 ? -r : r;
+}
+
+//: v, already clamped to the range of D, rounded to the nearest integer.
+//  Floats are rounded as doubles when D reaches beyond 2^23.
+template <class D, class S>
+inline S round_to_nearest(S v)
+{
+  typedef typename std::conditional<(sizeof(S) == 4 && std::numeric_limits<D>::max() < 8388608 &&
+                                     std::numeric_limits<D>::lowest() > -8388608), float, double>::type R;
+  return static_cast<S>(round_small(static_cast<R>(v)));
+}
+
+//: Largest S no bigger than the largest D. The largest int32 rounds up
+//  to 2^31 as a float, so the float below it is used instead.
+template <class S, class D>
+constexpr S float_upper_bound()
+{
+  return (sizeof(S) == 4 && sizeof(D) == 4) ? S(2147483520.0) : S(std::numeric_limits<D>::max());
+}
+
+//: Floating point v as an integer of type D
+template <class D, bool Round, bool Saturate, class S>
+inline D float_to_int(S v)
+{
+  // without saturation, through int rather than a wider type, which SSE
+  // and AVX can't convert to, clamped as converting a float beyond int is
+  // undefined
+  typedef typename std::conditional<Saturate, D, int>::type I;
+  // NaN fails both comparisons, so is replaced by 0
+  v = v == v ? v : S(0);
+  v = clamp_to(v, S(std::numeric_limits<I>::lowest()), float_upper_bound<S, I>());
+  if (Round) {
+    // the bounds are whole numbers, so rounding after clamping is the same
+    v = round_to_nearest<I>(v);
+  }
+  return static_cast<D>(static_cast<I>(v));
+}
+
+//: Integer v as an integer of type D. Every source type fits in an int.
+template <class D, bool Saturate, class S>
+inline D int_to_int(S v)
+{
+  if (Saturate && (std::numeric_limits<D>::lowest() > std::numeric_limits<S>::lowest() ||
+                   std::numeric_limits<D>::max() < std::numeric_limits<S>::max())) {
+    return static_cast<D>(clamp_to(int(v), int(std::numeric_limits<D>::lowest()),
+                                   int(std::numeric_limits<D>::max())));
+  }
+  return static_cast<D>(v);
+}
+
+template <class D, bool Round, bool Saturate, class S>
+inline D convert_value(S v, std::true_type /* D floating */, std::false_type)
+{
+  return static_cast<D>(v);
+}
+
+template <class D, bool Round, bool Saturate, class S>
+inline D convert_value(S v, std::false_type, std::true_type /* S floating */)
+{
+  return float_to_int<D, Round, Saturate>(v);
+}
+
+template <class D, bool Round, bool Saturate, class S>
+inline D convert_value(S v, std::false_type, std::false_type)
+{
+  return int_to_int<D, Saturate>(v);
+}
+
+template <class D, bool Round, bool Saturate, class S>
+inline D convert_value(S v, std::true_type, std::true_type)
+{
+  return static_cast<D>(v);
+}
+
+template <class S, class D, bool Round, bool Saturate>
+void convert_row(void const* src, std::ptrdiff_t src_step, void* dest, std::ptrdiff_t dest_step, std::size_t n)
+{
+  S const* s = static_cast<S const*>(src);
+  D* d = static_cast<D*>(dest);
+  typedef typename std::is_floating_point<D>::type dest_floating;
+  typedef typename std::is_floating_point<S>::type src_floating;
+  // contiguous rows are the vectorised case
+  if (src_step == 1 && dest_step == 1) {
+    for (std::size_t i = 0; i < n; ++i) {
+      d[i] = convert_value<D, Round, Saturate>(s[i], dest_floating(), src_floating());
+    }
+  }
+  else {
+    for (std::size_t i = 0; i < n; ++i) {
+      d[i * dest_step] = convert_value<D, Round, Saturate>(s[i * src_step], dest_floating(), src_floating());
+    }
+  }
+}
+
+template <class S, class D>
+void fill_pair(convert_row_function (&k)[2][2])
+{
+  k[0][0] = &convert_row<S, D, false, false>;
+  k[0][1] = &convert_row<S, D, false, true>;
+  k[1][0] = &convert_row<S, D, true, false>;
+  k[1][1] = &convert_row<S, D, true, true>;
+}
+
+template <class S>
+void fill_source(convert_row_function (&k)[n_convert_types][2][2])
+{
+  fill_pair<S, vxl_byte>(k[convert_byte]);
+  fill_pair<S, vxl_uint_16>(k[convert_uint16]);
+  fill_pair<S, vxl_int_16>(k[convert_int16]);
+  fill_pair<S, vxl_int_32>(k[convert_int32]);
+  fill_pair<S, float>(k[convert_float]);
+  fill_pair<S, double>(k[convert_double]);
+}
+
+inline convert_table make_convert_table()
+{
+  convert_table t;
+  fill_source<vxl_byte>(t.kernels[convert_byte]);
+  fill_source<vxl_uint_16>(t.kernels[convert_uint16]);
+  fill_source<vxl_int_16>(t.kernels[convert_int16]);
+  fill_source<vxl_int_32>(t.kernels[convert_int32]);
+  fill_source<float>(t.kernels[convert_float]);
+  fill_source<double>(t.kernels[convert_double]);
+  return t;
+}
+
+}}}
@@ -0,0 +1,13 @@
+// The conversion kernels for the baseline instruction set of the build
+#define PYVXL_VIL_KERNEL_ISA sse2
+#include "pyvil_convert_kernels.h"
+
+namespace pyvxl { namespace vil {
+
+convert_table const& convert_table_sse2()
+{
+  static const convert_table table = sse2::make_convert_table();
+  return table;
+}
+
+}}
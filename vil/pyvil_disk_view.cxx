@@ -0,0 +1,120 @@
+#include "pyvil_disk_view.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <vil/vil_copy.h>
+#include <vil/vil_image_view.h>
+
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+namespace {
+
+// Rows read from a resource at a time by disk_copy, at most
+const std::size_t copy_band_bytes = std::size_t(64) << 20;
+
+template <class T>
+struct copy_rows_op {
+  static void run(vil_image_resource_sptr const& resource, vil_image_view_base& dest)
+  {
+    vil_image_view<T> d(dest);
+    const unsigned ni = d.ni(), nj = d.nj();
+    const std::size_t row_bytes = std::max<std::size_t>(std::size_t(ni) * d.nplanes() * sizeof(T), 1);
+    const unsigned band = static_cast<unsigned>(std::max<std::size_t>(1, copy_band_bytes / row_bytes));
+    for (unsigned j0 = 0; j0 < nj; j0 += band) {
+      const unsigned n_j = std::min(band, nj - j0);
+      vil_image_view_base_sptr rows = resource->get_view(0, ni, j0, n_j);
+      if (!rows) {
+        throw std::runtime_error("disk_copy: failed to read the image");
+      }
+      // compound pixels are copied as planes of their components
+      vil_copy_to_window(vil_image_view<T>(*rows), d, 0, j0);
+    }
+  }
+};
+
+}
+
+disk_mapping::disk_mapping(std::size_t size, std::string const& directory)
+  : directory_(directory), data_(nullptr), size_(size)
+{
+  if (directory_.empty()) {
+    char const* tmpdir = std::getenv("TMPDIR");
+    directory_ = tmpdir && *tmpdir ? tmpdir : "/tmp";
+  }
+  std::string name = directory_ + "/pyvxl-XXXXXX";
+  std::vector<char> path(name.begin(), name.end());
+  path.push_back('\0');
+  int fd = ::mkstemp(path.data());
+  if (fd < 0) {
+    throw std::runtime_error("Failed to create a file in " + directory_ + ": " + std::strerror(errno));
+  }
+  // nameless from now on, so the file goes when the mapping does
+  ::unlink(path.data());
+
+  // extending the file leaves a hole, which takes no space until written
+  if (::ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+    const int err = errno;
+    ::close(fd);
+    throw std::runtime_error("Failed to size a file in " + directory_ + ": " + std::strerror(err));
+  }
+  void* addr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error("Failed to map a file in " + directory_ + ": " + std::strerror(errno));
+  }
+  data_ = static_cast<unsigned char*>(addr);
+}
+
+disk_mapping::~disk_mapping()
+{
+  ::munmap(data_, size_);
+}
+
+vil_image_view_base_sptr new_disk_view(unsigned ni, unsigned nj, unsigned nplanes,
+                                       vil_pixel_format format, std::string const& directory)
+{
+  const std::size_t bytes = std::max<std::size_t>(pixel_format_sizeof(format) * ni * nj * nplanes, 1);
+  vil_memory_chunk_sptr chunk = new disk_memory_chunk(std::make_shared<disk_mapping>(bytes, directory), format);
+  return new_chunk_view(chunk, ni, nj, nplanes, format);
+}
+
+vil_image_view_base_sptr disk_copy(vil_image_resource_sptr const& resource, std::string const& directory)
+{
+  if (!resource) {
+    throw std::invalid_argument("disk_copy: null image resource");
+  }
+  const vil_pixel_format format = resource->pixel_format();
+  vil_image_view_base_sptr result = new_disk_view(resource->ni(), resource->nj(), resource->nplanes(),
+                                                  format, directory);
+  dispatch_component_type<copy_rows_op>(format, resource, *result);
+  return result;
+}
+
+disk_memory_chunk* disk_chunk_of(vil_image_view_base const& view)
+{
+  return dynamic_cast<disk_memory_chunk*>(memory_chunk_of(view));
+}
+
+vil_image_view_base_sptr new_view_like(vil_image_view_base const& like, unsigned ni, unsigned nj,
+                                       unsigned nplanes, vil_pixel_format format)
+{
+  if (disk_memory_chunk* chunk = disk_chunk_of(like)) {
+    return new_disk_view(ni, nj, nplanes, format, chunk->owner().directory());
+  }
+  // as vil_image_view would allocate it
+  vil_memory_chunk_sptr chunk = new vil_memory_chunk(pixel_format_sizeof(format) * ni * nj * nplanes,
+                                                     vil_pixel_format_component_format(format));
+  return new_chunk_view(chunk, ni, nj, nplanes, format);
+}
+
+}}
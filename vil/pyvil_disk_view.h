@@ -0,0 +1,65 @@
+#ifndef pyvil_disk_view_h_included_
+#define pyvil_disk_view_h_included_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <vil/vil_image_resource.h>
+#include <vil/vil_image_view_base.h>
+#include <vil/vil_memory_chunk.h>
+#include <vil/vil_pixel_format.h>
+
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+/* Image views bigger than memory. Their pixels live in a sparse temporary
+ * file mapped into memory, so the kernel pages them in as they are read and
+ * writes them back to the file, rather than to swap, when memory runs short.
+ * Pixels never written take no disk space. The file is deleted as soon as
+ * it is made, so it goes with the last view of it, even after a crash.
+ * Otherwise these are ordinary views, which every vil operation can use. */
+
+//: A new sparse temporary file of size bytes in directory, mapped shared
+class disk_mapping {
+public:
+  //: An empty directory means $TMPDIR, or /tmp without it
+  disk_mapping(std::size_t size, std::string const& directory);
+  ~disk_mapping();
+
+  disk_mapping(disk_mapping const&) = delete;
+  disk_mapping& operator=(disk_mapping const&) = delete;
+
+  unsigned char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  std::string const& directory() const { return directory_; }
+
+private:
+  std::string directory_;
+  unsigned char* data_;
+  std::size_t size_;
+};
+
+//: The memory of views over a disk_mapping
+typedef external_memory_chunk<disk_mapping> disk_memory_chunk;
+
+//: A new zero filled view on disk, laid out as vil_image_view
+vil_image_view_base_sptr new_disk_view(unsigned ni, unsigned nj, unsigned nplanes,
+                                       vil_pixel_format format, std::string const& directory);
+
+//: A copy on disk of all of resource, read a band of rows at a time so
+//  it need never fit in memory
+vil_image_view_base_sptr disk_copy(vil_image_resource_sptr const& resource, std::string const& directory);
+
+//: The disk chunk of view, or null if its pixels are in memory
+disk_memory_chunk* disk_chunk_of(vil_image_view_base const& view);
+
+//: A new view for the result of an operation on like: on disk, in the
+//  same directory, when like is on disk, otherwise in memory
+vil_image_view_base_sptr new_view_like(vil_image_view_base const& like, unsigned ni, unsigned nj,
+                                       unsigned nplanes, vil_pixel_format format);
+
+}}
+
+#endif
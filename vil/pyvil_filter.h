@@ -0,0 +1,199 @@
+#ifndef pyvil_filter_h_included_
+#define pyvil_filter_h_included_
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <vil/vil_image_view.h>
+
+#include "pyvil_parallel.h"
+#include "pyvil_pixel_types.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace pyvxl { namespace vil {
+
+/* Separable filtering. dest(i, j) is the sum over a and b of
+ * kernel_i[a] * kernel_j[b] * src(i + a - a0, j + b - b0), with a0 and b0
+ * the centres of the kernels (size / 2) and src clamped at the edges. That
+ * is a correlation, so kernels aren't flipped. The image is cut into tiles
+ * which are filtered in parallel; each tile runs a row pass over its rows
+ * plus the vertical halo into a buffer of sums small enough to stay in
+ * cache, then a column pass from that buffer into dest. Both passes are
+ * sums of scaled rows, done in SSE2 or AVX2. Sums are in double when src or
+ * dest is double, otherwise in float, so int pixels beyond 2^24 lose
+ * precision. Kernels are float either way. dest may be src itself. */
+
+namespace simd {
+
+//: acc[x] += w * in[x] for x in [0, n)
+inline void axpy(float* acc, float const* in, float w, std::size_t n)
+{
+  std::size_t x = 0;
+#if defined(__AVX2__)
+  const __m256 vw = _mm256_set1_ps(w);
+  for (; x + 8 <= n; x += 8) {
+    _mm256_storeu_ps(acc + x, _mm256_add_ps(_mm256_loadu_ps(acc + x),
+                                            _mm256_mul_ps(vw, _mm256_loadu_ps(in + x))));
+  }
+#elif defined(__SSE2__)
+  const __m128 vw = _mm_set1_ps(w);
+  for (; x + 4 <= n; x += 4) {
+    _mm_storeu_ps(acc + x, _mm_add_ps(_mm_loadu_ps(acc + x), _mm_mul_ps(vw, _mm_loadu_ps(in + x))));
+  }
+#endif
+  for (; x < n; ++x) {
+    acc[x] += w * in[x];
+  }
+}
+
+//: acc[x] += w * in[x] for x in [0, n)
+inline void axpy(double* acc, double const* in, double w, std::size_t n)
+{
+  std::size_t x = 0;
+#if defined(__AVX2__)
+  const __m256d vw = _mm256_set1_pd(w);
+  for (; x + 4 <= n; x += 4) {
+    _mm256_storeu_pd(acc + x, _mm256_add_pd(_mm256_loadu_pd(acc + x),
+                                            _mm256_mul_pd(vw, _mm256_loadu_pd(in + x))));
+  }
+#elif defined(__SSE2__)
+  const __m128d vw = _mm_set1_pd(w);
+  for (; x + 2 <= n; x += 2) {
+    _mm_storeu_pd(acc + x, _mm_add_pd(_mm_loadu_pd(acc + x), _mm_mul_pd(vw, _mm_loadu_pd(in + x))));
+  }
+#endif
+  for (; x < n; ++x) {
+    acc[x] += w * in[x];
+  }
+}
+
+} // namespace simd
+
+//: Type the sums of separable_filter are kept in
+template <class srcT, class destT>
+struct filter_sum {
+  typedef typename std::conditional<std::is_same<srcT, double>::value || std::is_same<destT, double>::value,
+                                    double, float>::type type;
+};
+
+const unsigned filter_tile_ni = 512;
+
+//: Rows in each tile, enough that the halo is a small part of the work
+inline unsigned filter_tile_nj(std::size_t kernel_size)
+{
+  return static_cast<unsigned>(std::max<std::size_t>(64, 4 * kernel_size));
+}
+
+//: First and one past the last byte touched by view
+template <class T>
+std::pair<char const*, char const*> view_extent(vil_image_view<T> const& view)
+{
+  char const* first = reinterpret_cast<char const*>(view.top_left_ptr());
+  char const* last = first;
+  const std::ptrdiff_t extents[3] = {
+    (static_cast<std::ptrdiff_t>(view.ni()) - 1) * view.istep(),
+    (static_cast<std::ptrdiff_t>(view.nj()) - 1) * view.jstep(),
+    (static_cast<std::ptrdiff_t>(view.nplanes()) - 1) * view.planestep()};
+  for (std::ptrdiff_t e : extents) {
+    (e < 0 ? first : last) += e * static_cast<std::ptrdiff_t>(sizeof(T));
+  }
+  return std::make_pair(first, last + sizeof(T));
+}
+
+template <class T, class U>
+bool views_overlap(vil_image_view<T> const& a, vil_image_view<U> const& b)
+{
+  if (a.size() == 0 || b.size() == 0) {
+    return false;
+  }
+  const std::pair<char const*, char const*> ea = view_extent(a), eb = view_extent(b);
+  return ea.first < eb.second && eb.first < ea.second;
+}
+
+template <class srcT, class destT>
+void separable_filter(vil_image_view<srcT> const& src, vil_image_view<destT>& dest,
+                      std::vector<float> const& kernel_i, std::vector<float> const& kernel_j)
+{
+  if (kernel_i.empty() || kernel_j.empty()) {
+    throw std::invalid_argument("separable_filter: empty kernel");
+  }
+  if (dest.ni() != src.ni() || dest.nj() != src.nj() || dest.nplanes() != src.nplanes()) {
+    throw std::invalid_argument("separable_filter: output view has the wrong size");
+  }
+  const unsigned ni = src.ni(), nj = src.nj(), nplanes = src.nplanes();
+  if (src.size() == 0) {
+    return;
+  }
+  if (views_overlap(src, dest)) {
+    // tiles read pixels around them which other tiles may have written
+    vil_image_view<srcT> copy;
+    copy.deep_copy(src);
+    separable_filter(copy, dest, kernel_i, kernel_j);
+    return;
+  }
+
+  typedef typename filter_sum<srcT, destT>::type sum_type;
+  const std::ptrdiff_t a0 = kernel_i.size() / 2, b0 = kernel_j.size() / 2;
+  const unsigned tile_ni = filter_tile_ni, tile_nj = filter_tile_nj(kernel_j.size());
+  const std::size_t n_tiles_i = (ni + tile_ni - 1) / tile_ni;
+  const std::size_t n_tiles_j = (nj + tile_nj - 1) / tile_nj;
+
+  srcT const* src_data = src.top_left_ptr();
+  const std::ptrdiff_t s_istep = src.istep(), s_jstep = src.jstep(), s_pstep = src.planestep();
+  destT* dest_data = dest.top_left_ptr();
+  const std::ptrdiff_t d_istep = dest.istep(), d_jstep = dest.jstep(), d_pstep = dest.planestep();
+
+  default_thread_pool()->run(n_tiles_i * n_tiles_j * nplanes, [&](std::size_t t) {
+    const unsigned p = static_cast<unsigned>(t / (n_tiles_i * n_tiles_j));
+    const std::size_t tile = t % (n_tiles_i * n_tiles_j);
+    const std::ptrdiff_t i0 = (tile % n_tiles_i) * tile_ni;
+    const std::ptrdiff_t j0 = (tile / n_tiles_i) * tile_nj;
+    const std::ptrdiff_t tni = std::min<std::ptrdiff_t>(tile_ni, ni - i0);
+    const std::ptrdiff_t tnj = std::min<std::ptrdiff_t>(tile_nj, nj - j0);
+    const std::ptrdiff_t halo_j = kernel_j.size() - 1;
+    auto clamp_i = [ni](std::ptrdiff_t i) { return std::min<std::ptrdiff_t>(std::max<std::ptrdiff_t>(i, 0), ni - 1); };
+    auto clamp_j = [nj](std::ptrdiff_t j) { return std::min<std::ptrdiff_t>(std::max<std::ptrdiff_t>(j, 0), nj - 1); };
+
+    // one source row of the tile with its horizontal halo, as sums
+    std::vector<sum_type> line(tni + kernel_i.size() - 1);
+    // the row pass of rows j0 - b0 ... of the tile, one row after another
+    std::vector<sum_type> rows((tnj + halo_j) * tni, sum_type(0));
+    std::vector<sum_type> acc(tni);
+
+    srcT const* plane = src_data + p * s_pstep;
+    for (std::ptrdiff_t r = 0; r < tnj + halo_j; ++r) {
+      srcT const* src_row = plane + clamp_j(j0 + r - b0) * s_jstep;
+      for (std::ptrdiff_t x = 0; x < static_cast<std::ptrdiff_t>(line.size()); ++x) {
+        line[x] = static_cast<sum_type>(src_row[clamp_i(i0 + x - a0) * s_istep]);
+      }
+      sum_type* out = &rows[r * tni];
+      for (std::size_t a = 0; a < kernel_i.size(); ++a) {
+        simd::axpy(out, &line[a], kernel_i[a], tni);
+      }
+    }
+
+    for (std::ptrdiff_t y = 0; y < tnj; ++y) {
+      std::fill(acc.begin(), acc.end(), sum_type(0));
+      for (std::size_t b = 0; b < kernel_j.size(); ++b) {
+        simd::axpy(acc.data(), &rows[(y + b) * tni], kernel_j[b], tni);
+      }
+      destT* dest_row = dest_data + p * d_pstep + (j0 + y) * d_jstep + i0 * d_istep;
+      for (std::ptrdiff_t x = 0; x < tni; ++x) {
+        dest_row[x * d_istep] = saturate_cast<destT>(acc[x]);
+      }
+    }
+  });
+}
+
+}}
+
+#endif
@@ -0,0 +1,74 @@
+#include "pyvil_integral.h"
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+namespace {
+
+// Boxes evaluated by each task of box_statistics
+const std::size_t boxes_per_task = 4096;
+
+template <class T>
+struct make_integral_op {
+  static std::unique_ptr<integral_image> run(vil_image_view_base const& view, bool squared)
+  {
+    // compound pixels (e.g. RGB) are seen as planes of their components
+    return std::unique_ptr<integral_image>(new typed_integral_image<T>(vil_image_view<T>(view), squared));
+  }
+};
+
+}
+
+std::unique_ptr<integral_image> make_integral_image(vil_image_view_base const& view, bool squared)
+{
+  return dispatch_component_type<make_integral_op>(view.pixel_format(), view, squared);
+}
+
+void box_statistics(integral_image const& image, std::vector<image_window> const& boxes,
+                    box_statistic statistic, double* out)
+{
+  for (std::size_t k = 0; k < boxes.size(); ++k) {
+    image_window const& b = boxes[k];
+    if (std::size_t(b.i0) + b.ni > image.ni() || std::size_t(b.j0) + b.nj > image.nj()) {
+      throw std::out_of_range("box " + std::to_string(k) + " is not within the image");
+    }
+  }
+  const bool variance = statistic == box_statistic::variance;
+  if (variance && !image.squares()) {
+    throw std::invalid_argument("box variances need an integral image with squares");
+  }
+
+  const unsigned np = image.nplanes();
+  const std::size_t n_tasks = (boxes.size() + boxes_per_task - 1) / boxes_per_task;
+  default_thread_pool()->run(n_tasks, [&](std::size_t t) {
+    const std::size_t b0 = t * boxes_per_task, b1 = std::min(b0 + boxes_per_task, boxes.size());
+    double* sums = out + b0 * np;
+    std::vector<double> squares(variance ? (b1 - b0) * np : 0);
+    image.box_sums(&boxes[b0], b1 - b0, sums, variance ? squares.data() : nullptr);
+    if (statistic == box_statistic::sum) {
+      return;
+    }
+
+    for (std::size_t k = b0; k < b1; ++k) {
+      const double n = double(boxes[k].ni) * boxes[k].nj;
+      for (unsigned p = 0; p < np; ++p) {
+        double& v = sums[(k - b0) * np + p];
+        if (n == 0) {
+          v = std::numeric_limits<double>::quiet_NaN();
+          continue;
+        }
+        const double mean = v / n;
+        // population variance, which rounding can't make negative
+        v = variance ? std::max(0.0, squares[(k - b0) * np + p] / n - mean * mean) : mean;
+      }
+    }
+  });
+}
+
+}}
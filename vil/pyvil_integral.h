@@ -0,0 +1,185 @@
+#ifndef pyvil_integral_h_included_
+#define pyvil_integral_h_included_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <vil/vil_image_view.h>
+
+#include "pyvil_parallel.h"
+#include "pyvil_window_reader.h"
+
+namespace pyvxl { namespace vil {
+
+/* Summed-area tables, of the pixels and optionally of their squares, and
+ * sums, means and variances over any number of boxes from them, each in
+ * constant time. A table is (ni+1) x (nj+1) with a zero first row and
+ * column, so table(i, j, p) is the sum of plane p over [0, i) x [0, j).
+ * It is built in two parallel passes: prefix sums along each row, in bands
+ * of rows, then down the columns, in strips of columns. Tables of integer
+ * pixels are exact: 64-bit sums, and 64-bit unsigned squares up to 16-bit
+ * pixels; anything else is summed in double. */
+
+//: Accumulator types of the tables of pixels of type T
+template <class T> struct integral_types {
+  typedef double sum_type;
+  typedef double square_type;
+  static square_type square(T v) { return double(v) * v; }
+};
+
+#if VXL_HAS_INT_64
+template <class T> struct small_integral_types {
+  typedef vxl_int_64 sum_type;
+  typedef vxl_uint_64 square_type;
+  static square_type square(T v) { return square_type(vxl_int_64(v) * v); }
+};
+
+template <> struct integral_types<bool> : small_integral_types<bool> {};
+template <> struct integral_types<vxl_byte> : small_integral_types<vxl_byte> {};
+template <> struct integral_types<vxl_sbyte> : small_integral_types<vxl_sbyte> {};
+template <> struct integral_types<vxl_uint_16> : small_integral_types<vxl_uint_16> {};
+template <> struct integral_types<vxl_int_16> : small_integral_types<vxl_int_16> {};
+
+// squares of 32-bit pixels may not fit 64 bits once summed
+template <class T> struct wide_integral_types {
+  typedef vxl_int_64 sum_type;
+  typedef double square_type;
+  static square_type square(T v) { return double(v) * v; }
+};
+
+template <> struct integral_types<vxl_uint_32> : wide_integral_types<vxl_uint_32> {};
+template <> struct integral_types<vxl_int_32> : wide_integral_types<vxl_int_32> {};
+#endif
+
+// Columns in each strip of the column pass
+const unsigned integral_strip_ni = 2048;
+
+//: The summed-area table of value(pixel) over src, in table
+template <class A, class T, class F>
+void integral_scan(vil_image_view<T> const& src, vil_image_view<A>& table, F value)
+{
+  const unsigned ni = src.ni(), nj = src.nj(), np = src.nplanes();
+  table.set_size(ni + 1, nj + 1, np);
+
+  // prefix sums along each row
+  const unsigned band = row_band_size(ni, nj);
+  const std::size_t n_bands = num_row_bands(ni, nj);
+  default_thread_pool()->run(np * n_bands, [&](std::size_t k) {
+    const unsigned p = static_cast<unsigned>(k / n_bands);
+    const unsigned j0 = static_cast<unsigned>(k % n_bands) * band, j1 = std::min(j0 + band, nj);
+    for (unsigned j = j0; j < j1; ++j) {
+      T const* in = src.top_left_ptr() + j * src.jstep() + p * src.planestep();
+      A* out = &table(0, j + 1, p);
+      A sum = 0;
+      out[0] = 0;
+      for (unsigned i = 0; i < ni; ++i) {
+        sum += value(in[i * src.istep()]);
+        out[i + 1] = sum;
+      }
+    }
+  });
+
+  // then down the columns, which a strip at a time runs over contiguous rows
+  const std::size_t n_strips = (ni + integral_strip_ni) / integral_strip_ni;
+  default_thread_pool()->run(np * n_strips, [&](std::size_t k) {
+    const unsigned p = static_cast<unsigned>(k / n_strips);
+    const unsigned i0 = static_cast<unsigned>(k % n_strips) * integral_strip_ni;
+    const unsigned i1 = std::min(i0 + integral_strip_ni, ni + 1);
+    A* above = &table(0, 0, p);
+    std::fill(above + i0, above + i1, A(0));
+    for (unsigned j = 1; j <= nj; ++j) {
+      A* row = &table(0, j, p);
+      for (unsigned i = i0; i < i1; ++i) {
+        row[i] += above[i];
+      }
+      above = row;
+    }
+  });
+}
+
+//: Sum of plane p of the pixels within box, from their table
+template <class A>
+A box_sum(vil_image_view<A> const& table, image_window const& box, unsigned p)
+{
+  const unsigned i1 = box.i0 + box.ni, j1 = box.j0 + box.nj;
+  // exact for unsigned tables too, wrapping around and back
+  return table(i1, j1, p) - table(box.i0, j1, p) - table(i1, box.j0, p) + table(box.i0, box.j0, p);
+}
+
+class integral_image {
+public:
+  virtual ~integral_image() {}
+
+  //: Size of the image the tables are of
+  virtual unsigned ni() const = 0;
+  virtual unsigned nj() const = 0;
+  virtual unsigned nplanes() const = 0;
+
+  //: The summed-area table of the pixels
+  virtual vil_image_view_base_sptr sums() const = 0;
+  //: The summed-area table of their squares, or null when not built
+  virtual vil_image_view_base_sptr squares() const = 0;
+
+  //: Sums over each of n boxes, nplanes values a box, of the pixels into
+  //  sums and, when it isn't null, of their squares into squares
+  virtual void box_sums(image_window const* boxes, std::size_t n, double* sums, double* squares) const = 0;
+};
+
+template <class T>
+class typed_integral_image : public integral_image {
+public:
+  typedef typename integral_types<T>::sum_type sum_type;
+  typedef typename integral_types<T>::square_type square_type;
+
+  typed_integral_image(vil_image_view<T> const& src, bool squared)
+  {
+    integral_scan(src, sums_, [](T v) { return sum_type(v); });
+    if (squared) {
+      integral_scan(src, squares_, [](T v) { return integral_types<T>::square(v); });
+    }
+  }
+
+  unsigned ni() const override { return sums_.ni() - 1; }
+  unsigned nj() const override { return sums_.nj() - 1; }
+  unsigned nplanes() const override { return sums_.nplanes(); }
+
+  vil_image_view_base_sptr sums() const override { return new vil_image_view<sum_type>(sums_); }
+  vil_image_view_base_sptr squares() const override
+  {
+    return squares_.size() ? new vil_image_view<square_type>(squares_) : nullptr;
+  }
+
+  void box_sums(image_window const* boxes, std::size_t n, double* sums, double* squares) const override
+  {
+    const unsigned np = nplanes();
+    for (std::size_t k = 0; k < n; ++k) {
+      for (unsigned p = 0; p < np; ++p) {
+        sums[k * np + p] = static_cast<double>(box_sum(sums_, boxes[k], p));
+        if (squares) {
+          squares[k * np + p] = static_cast<double>(box_sum(squares_, boxes[k], p));
+        }
+      }
+    }
+  }
+
+private:
+  vil_image_view<sum_type> sums_;
+  vil_image_view<square_type> squares_;
+};
+
+//: The tables of view, compound pixels (e.g. RGB) taken as planes of their
+//  components, with those of the squares when squared
+std::unique_ptr<integral_image> make_integral_image(vil_image_view_base const& view, bool squared);
+
+enum class box_statistic { sum, mean, variance };
+
+//: statistic of each plane over each box, nplanes values a box, into out.
+//  A mean or variance of an empty box is NaN, and a variance needs squares.
+void box_statistics(integral_image const& image, std::vector<image_window> const& boxes,
+                    box_statistic statistic, double* out);
+
+}}
+
+#endif
@@ -0,0 +1,374 @@
+#include "pyvil_mmap_resource.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vil/vil_image_view.h>
+#include <vil/vil_load.h>
+#include <vil/vil_memory_chunk.h>
+
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+file_mapping::file_mapping(std::string const& filename)
+  : filename_(filename), data_(nullptr), size_(0)
+{
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open " + filename + ": " + std::strerror(errno));
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    throw std::runtime_error("Failed to map empty or unreadable file " + filename);
+  }
+  size_ = static_cast<std::size_t>(st.st_size);
+
+  void* addr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error("Failed to map " + filename + ": " + std::strerror(errno));
+  }
+  data_ = static_cast<unsigned char*>(addr);
+}
+
+file_mapping::~file_mapping()
+{
+  ::munmap(data_, size_);
+}
+
+
+namespace {
+
+// Reads the values of a TIFF file in the file's byte order
+class tiff_reader {
+public:
+  explicit tiff_reader(file_mapping const& mapping)
+    : data_(mapping.data()), size_(mapping.size()), little_endian_(data_[0] == 'I') {}
+
+  bool little_endian() const { return little_endian_; }
+
+  std::uint64_t read(std::size_t offset, unsigned nbytes) const
+  {
+    if (offset + nbytes > size_) {
+      throw std::out_of_range("truncated TIFF");
+    }
+    std::uint64_t value = 0;
+    for (unsigned b = 0; b < nbytes; ++b) {
+      unsigned shift = little_endian_ ? 8*b : 8*(nbytes - 1 - b);
+      value |= static_cast<std::uint64_t>(data_[offset + b]) << shift;
+    }
+    return value;
+  }
+
+  //: All values of the IFD entry at offset, for the integer field types
+  std::vector<std::uint64_t> values(std::size_t entry) const
+  {
+    const unsigned type = static_cast<unsigned>(read(entry + 2, 2));
+    const std::uint64_t count = read(entry + 4, 4);
+    unsigned nbytes;
+    switch (type) {
+      case 1: nbytes = 1; break;  // BYTE
+      case 3: nbytes = 2; break;  // SHORT
+      case 4: nbytes = 4; break;  // LONG
+      default: throw std::runtime_error("unsupported TIFF field type");
+    }
+
+    if (count == 0) {
+      throw std::runtime_error("empty TIFF field");
+    }
+
+    // small values are stored in the entry itself
+    std::uint64_t offset = entry + 8;
+    if (count * nbytes > 4) {
+      offset = read(entry + 8, 4);
+    }
+    if (offset + count * nbytes > size_) {
+      throw std::out_of_range("truncated TIFF");
+    }
+    std::vector<std::uint64_t> result(static_cast<std::size_t>(count));
+    for (std::size_t k = 0; k < result.size(); ++k) {
+      result[k] = read(offset + k*nbytes, nbytes);
+    }
+    return result;
+  }
+
+private:
+  unsigned char const* data_;
+  std::size_t size_;
+  bool little_endian_;
+};
+
+//: a * b, or false if that doesn't fit in 64 bits
+bool checked_multiply(std::uint64_t a, std::uint64_t b, std::uint64_t& product)
+{
+  if (a != 0 && b > UINT64_MAX / a) {
+    return false;
+  }
+  product = a * b;
+  return true;
+}
+
+bool host_little_endian()
+{
+  const std::uint16_t one = 1;
+  return *reinterpret_cast<unsigned char const*>(&one) == 1;
+}
+
+vil_pixel_format tiff_pixel_format(std::uint64_t sample_format, std::uint64_t bits)
+{
+  switch (sample_format) {
+    case 1:  // unsigned integer
+      if (bits == 8) return VIL_PIXEL_FORMAT_BYTE;
+      if (bits == 16) return VIL_PIXEL_FORMAT_UINT_16;
+      if (bits == 32) return VIL_PIXEL_FORMAT_UINT_32;
+      break;
+    case 2:  // signed integer
+      if (bits == 8) return VIL_PIXEL_FORMAT_SBYTE;
+      if (bits == 16) return VIL_PIXEL_FORMAT_INT_16;
+      if (bits == 32) return VIL_PIXEL_FORMAT_INT_32;
+      break;
+    case 3:  // IEEE floating point
+      if (bits == 32) return VIL_PIXEL_FORMAT_FLOAT;
+      if (bits == 64) return VIL_PIXEL_FORMAT_DOUBLE;
+      break;
+  }
+  return VIL_PIXEL_FORMAT_UNKNOWN;
+}
+
+}
+
+
+bool uncompressed_tiff_layout(file_mapping const& mapping, raster_layout& layout)
+{
+  unsigned char const* data = mapping.data();
+  if (mapping.size() < 8 ||
+      !((data[0] == 'I' && data[1] == 'I') || (data[0] == 'M' && data[1] == 'M'))) {
+    return false;
+  }
+
+  tiff_reader tiff(mapping);
+  // classic TIFF only, BigTIFF goes through vil
+  if (tiff.read(2, 2) != 42 || tiff.little_endian() != host_little_endian()) {
+    return false;
+  }
+
+  try {
+    std::uint64_t width = 0, height = 0, compression = 1, samples = 1;
+    std::uint64_t rows_per_strip = 0xFFFFFFFF, planar = 1, sample_format = 1, photometric = 0xFFFF;
+    std::vector<std::uint64_t> bits(1, 1), strip_offsets, strip_byte_counts;
+    bool tiled = false, extra_samples = false;
+
+    const std::size_t ifd = static_cast<std::size_t>(tiff.read(4, 4));
+    const std::size_t n_entries = static_cast<std::size_t>(tiff.read(ifd, 2));
+    for (std::size_t e = 0; e < n_entries; ++e) {
+      const std::size_t entry = ifd + 2 + 12*e;
+      switch (tiff.read(entry, 2)) {
+        case 256: width = tiff.values(entry)[0]; break;
+        case 257: height = tiff.values(entry)[0]; break;
+        case 258: bits = tiff.values(entry); break;
+        case 259: compression = tiff.values(entry)[0]; break;
+        case 262: photometric = tiff.values(entry)[0]; break;
+        case 273: strip_offsets = tiff.values(entry); break;
+        case 277: samples = tiff.values(entry)[0]; break;
+        case 278: rows_per_strip = tiff.values(entry)[0]; break;
+        case 279: strip_byte_counts = tiff.values(entry); break;
+        case 284: planar = tiff.values(entry)[0]; break;
+        case 322: case 323: case 324: case 325: tiled = true; break;
+        case 338: extra_samples = true; break;
+        case 339: sample_format = tiff.values(entry)[0]; break;
+        default: break;
+      }
+    }
+
+    if (compression != 1 || tiled || width == 0 || height == 0 || samples == 0 ||
+        strip_offsets.empty() || strip_offsets.size() != strip_byte_counts.size()) {
+      return false;
+    }
+    // only samples vil would load as they are: grey planes (MinIsBlack) or
+    // RGB, without alpha or other extra samples, palettes or inverted grey
+    if (extra_samples || !(photometric == 1 || (photometric == 2 && samples == 3))) {
+      return false;
+    }
+    for (auto b : bits) {
+      if (b != bits[0]) {
+        return false;
+      }
+    }
+    // bit packed or otherwise unusual samples can't be viewed in place
+    const vil_pixel_format format = tiff_pixel_format(sample_format, bits[0]);
+    if (format == VIL_PIXEL_FORMAT_UNKNOWN) {
+      return false;
+    }
+    const std::size_t pixel_size = pixel_format_sizeof(format);
+
+    // the strips must follow each other, so the whole raster is one block
+    const std::size_t offset = static_cast<std::size_t>(strip_offsets[0]);
+    for (std::size_t k = 1; k < strip_offsets.size(); ++k) {
+      if (strip_offsets[k] != strip_offsets[k-1] + strip_byte_counts[k-1]) {
+        return false;
+      }
+    }
+    std::uint64_t pixels, raster_bytes;
+    if (!checked_multiply(width, height, pixels) || !checked_multiply(pixels, samples, pixels) ||
+        !checked_multiply(pixels, pixel_size, raster_bytes)) {
+      return false;
+    }
+    if (offset % pixel_size != 0 || offset > mapping.size() || raster_bytes > mapping.size() - offset ||
+        (rows_per_strip < height && strip_offsets.size() < (height + rows_per_strip - 1) / rows_per_strip)) {
+      return false;
+    }
+
+    layout.ni = static_cast<unsigned>(width);
+    layout.nj = static_cast<unsigned>(height);
+    layout.nplanes = static_cast<unsigned>(samples);
+    layout.pixel_format = format;
+    layout.offset = offset;
+    if (planar == 1) {
+      layout.istep = samples;
+      layout.jstep = width * samples;
+      layout.planestep = 1;
+    }
+    else {
+      layout.istep = 1;
+      layout.jstep = width;
+      layout.planestep = width * height;
+    }
+    return true;
+  }
+  catch (std::exception const&) {
+    // a malformed header, let vil deal with it
+    return false;
+  }
+}
+
+
+mmap_image_resource::mmap_image_resource(std::shared_ptr<file_mapping> const& mapping,
+                                         raster_layout const& layout)
+  : mapping_(mapping), layout_(layout)
+{
+}
+
+template <class T>
+struct mmap_image_resource::view_op {
+  static vil_image_view_base_sptr run(mmap_image_resource const& r,
+                                      unsigned i0, unsigned n_i, unsigned j0, unsigned n_j)
+  {
+    raster_layout const& l = r.layout_;
+    vil_memory_chunk_sptr chunk = new external_memory_chunk<file_mapping>(r.mapping_, vil_pixel_format_of(T()));
+    T const* top_left = reinterpret_cast<T const*>(r.mapping_->data() + l.offset) +
+                        i0*l.istep + j0*l.jstep;
+    return new vil_image_view<T>(chunk, top_left, n_i, n_j, l.nplanes,
+                                 l.istep, l.jstep, l.planestep);
+  }
+};
+
+vil_image_view_base_sptr mmap_image_resource::get_view(unsigned i0, unsigned n_i,
+                                                       unsigned j0, unsigned n_j) const
+{
+  if (n_i == 0 || n_j == 0 || std::size_t(i0) + n_i > ni() || std::size_t(j0) + n_j > nj()) {
+    return nullptr;
+  }
+  return dispatch_component_type<view_op>(pixel_format(), *this, i0, n_i, j0, n_j);
+}
+
+namespace {
+
+template <class T>
+struct deep_copy_op {
+  static vil_image_view_base_sptr run(vil_image_view_base const& view)
+  {
+    vil_image_view<T>* copy = new vil_image_view<T>;
+    copy->deep_copy(vil_image_view<T>(view));
+    return copy;
+  }
+};
+
+}
+
+vil_image_view_base_sptr mmap_image_resource::get_copy_view(unsigned i0, unsigned n_i,
+                                                            unsigned j0, unsigned n_j) const
+{
+  vil_image_view_base_sptr view = get_view(i0, n_i, j0, n_j);
+  if (!view) {
+    return view;
+  }
+  return dispatch_component_type<deep_copy_op>(pixel_format(), *view);
+}
+
+bool mmap_image_resource::put_view(vil_image_view_base const& /*im*/, unsigned /*i0*/, unsigned /*j0*/)
+{
+  // the mapping is copy-on-write, so nothing could ever reach the file
+  return false;
+}
+
+bool mmap_image_resource::get_property(char const* /*tag*/, void* /*property_value*/) const
+{
+  return false;
+}
+
+
+vil_image_resource_sptr load_mmap_image_resource(std::string const& filename)
+{
+  auto mapping = std::make_shared<file_mapping>(filename);
+  raster_layout layout;
+  if (uncompressed_tiff_layout(*mapping, layout)) {
+    return new mmap_image_resource(mapping, layout);
+  }
+
+  // compressed, tiled or bit packed data has to be decoded anyway
+  return vil_load_image_resource(filename.c_str());
+}
+
+vil_image_resource_sptr mmap_raw_image_resource(std::string const& filename,
+                                                unsigned ni, unsigned nj, unsigned nplanes,
+                                                vil_pixel_format pixel_format,
+                                                std::size_t offset, bool interleaved)
+{
+  const std::size_t pixel_size = pixel_format_sizeof(pixel_format);
+  if (pixel_size == 0 || vil_pixel_format_num_components(pixel_format) != 1) {
+    throw std::invalid_argument("mmap_raw_image_resource: pixel format must be a scalar type");
+  }
+
+  auto mapping = std::make_shared<file_mapping>(filename);
+  std::uint64_t pixels, raster_bytes;
+  if (!checked_multiply(ni, nj, pixels) || !checked_multiply(pixels, nplanes, pixels) ||
+      !checked_multiply(pixels, pixel_size, raster_bytes) ||
+      offset % pixel_size != 0 || offset > mapping->size() || raster_bytes > mapping->size() - offset) {
+    std::ostringstream buffer;
+    buffer << "mmap_raw_image_resource: " << filename << " is too small for a "
+           << ni << " x " << nj << " x " << nplanes << " image at offset " << offset;
+    throw std::invalid_argument(buffer.str());
+  }
+
+  raster_layout layout;
+  layout.ni = ni;
+  layout.nj = nj;
+  layout.nplanes = nplanes;
+  layout.pixel_format = pixel_format;
+  layout.offset = offset;
+  if (interleaved) {
+    layout.istep = nplanes;
+    layout.jstep = std::ptrdiff_t(ni) * nplanes;
+    layout.planestep = 1;
+  }
+  else {
+    layout.istep = 1;
+    layout.jstep = ni;
+    layout.planestep = std::ptrdiff_t(ni) * nj;
+  }
+  return new mmap_image_resource(mapping, layout);
+}
+
+}}
@@ -0,0 +1,97 @@
+#ifndef pyvil_mmap_resource_h_included_
+#define pyvil_mmap_resource_h_included_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <vil/vil_image_resource.h>
+#include <vil/vil_image_view_base.h>
+#include <vil/vil_pixel_format.h>
+#include <vil/vil_smart_ptr.h>
+
+namespace pyvxl { namespace vil {
+
+//: A file mapped copy-on-write into memory. Unmodified pages stay shared
+//  with the page cache, and so with every other process mapping the file.
+class file_mapping {
+public:
+  explicit file_mapping(std::string const& filename);
+  ~file_mapping();
+
+  file_mapping(file_mapping const&) = delete;
+  file_mapping& operator=(file_mapping const&) = delete;
+
+  unsigned char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  std::string const& filename() const { return filename_; }
+
+private:
+  std::string filename_;
+  unsigned char* data_;
+  std::size_t size_;
+};
+
+//: Where the pixels of an uncompressed raster sit within its file
+struct raster_layout {
+  unsigned ni, nj, nplanes;
+  vil_pixel_format pixel_format;
+  std::size_t offset;  // bytes from the start of the file to pixel (0,0,0)
+  std::ptrdiff_t istep, jstep, planestep;  // in pixels
+};
+
+//: Layout of the first image of a TIFF file, if it is stored uncompressed,
+//  in host byte order, with whole-byte grey or RGB samples and contiguous
+//  strips
+bool uncompressed_tiff_layout(file_mapping const& mapping, raster_layout& layout);
+
+/* A read-only image resource over a memory mapped uncompressed raster.
+ * get_view returns views straight into the mapping (writes to them are
+ * private to this process and never reach the file), get_copy_view copies. */
+class mmap_image_resource : public vil_image_resource {
+public:
+  mmap_image_resource(std::shared_ptr<file_mapping> const& mapping, raster_layout const& layout);
+
+  unsigned nplanes() const override { return layout_.nplanes; }
+  unsigned ni() const override { return layout_.ni; }
+  unsigned nj() const override { return layout_.nj; }
+  enum vil_pixel_format pixel_format() const override { return layout_.pixel_format; }
+
+  vil_image_view_base_sptr get_view(unsigned i0, unsigned n_i,
+                                    unsigned j0, unsigned n_j) const override;
+  using vil_image_resource::get_view;
+  vil_image_view_base_sptr get_copy_view(unsigned i0, unsigned n_i,
+                                         unsigned j0, unsigned n_j) const override;
+  using vil_image_resource::get_copy_view;
+
+  bool put_view(vil_image_view_base const& im, unsigned i0, unsigned j0) override;
+  using vil_image_resource::put_view;
+
+  char const* file_format() const override { return "mmap"; }
+  bool get_property(char const* tag, void* property_value = nullptr) const override;
+
+  std::string const& filename() const { return mapping_->filename(); }
+
+private:
+  template <class T> struct view_op;
+
+  std::shared_ptr<file_mapping> mapping_;
+  raster_layout layout_;
+};
+
+typedef vil_smart_ptr<mmap_image_resource> mmap_image_resource_sptr;
+
+//: Memory map filename if it is an uncompressed TIFF whose layout a view
+//  can represent, otherwise load it the usual way with vil_load_image_resource
+vil_image_resource_sptr load_mmap_image_resource(std::string const& filename);
+
+//: Memory map a headerless raw raster. Planes are interleaved per pixel
+//  when interleaved is true, otherwise stored one after the other.
+vil_image_resource_sptr mmap_raw_image_resource(std::string const& filename,
+                                                unsigned ni, unsigned nj, unsigned nplanes,
+                                                vil_pixel_format pixel_format,
+                                                std::size_t offset, bool interleaved);
+
+}}
+
+#endif
@@ -0,0 +1,152 @@
+#include "pyvil_parallel.h"
+
+namespace pyvxl { namespace vil {
+
+namespace {
+
+// set on pool workers, so nested jobs don't wait on their own pool
+thread_local bool in_worker = false;
+
+unsigned default_num_threads()
+{
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::mutex default_pool_mutex;
+std::shared_ptr<thread_pool> default_pool;
+
+}
+
+struct thread_pool::job {
+  std::function<void(std::size_t)> const* task;
+  std::size_t n_tasks;
+  std::size_t next;
+  std::size_t finished;
+  std::exception_ptr error;
+  std::condition_variable done;
+};
+
+thread_pool::thread_pool(unsigned num_threads)
+  : stop_(false)
+{
+  for (unsigned t = 1; t < num_threads; ++t) {
+    workers_.emplace_back(&thread_pool::worker_loop, this);
+  }
+}
+
+thread_pool::~thread_pool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+// Run task k of j. Called and returns with lock held.
+void thread_pool::execute(job& j, std::size_t k, std::unique_lock<std::mutex>& lock)
+{
+  lock.unlock();
+  std::exception_ptr error;
+  try {
+    (*j.task)(k);
+  }
+  catch (...) {
+    error = std::current_exception();
+  }
+  lock.lock();
+
+  if (error && !j.error) {
+    j.error = error;
+  }
+  if (++j.finished == j.n_tasks) {
+    j.done.notify_all();
+  }
+}
+
+void thread_pool::worker_loop()
+{
+  in_worker = true;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+    if (jobs_.empty()) {
+      return;
+    }
+    job* j = jobs_.front();
+    std::size_t k = j->next++;
+    if (j->next == j->n_tasks) {
+      jobs_.pop_front();
+    }
+    execute(*j, k, lock);
+  }
+}
+
+void thread_pool::run(std::size_t n_tasks, std::function<void(std::size_t)> const& task)
+{
+  if (n_tasks == 0) {
+    return;
+  }
+  if (n_tasks == 1 || workers_.empty() || in_worker) {
+    for (std::size_t k = 0; k < n_tasks; ++k) {
+      task(k);
+    }
+    return;
+  }
+
+  job j;
+  j.task = &task;
+  j.n_tasks = n_tasks;
+  j.next = 0;
+  j.finished = 0;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  jobs_.push_back(&j);
+  cv_.notify_all();
+
+  // work on our own job until every task has been handed out
+  while (j.next < n_tasks) {
+    std::size_t k = j.next++;
+    if (j.next == n_tasks) {
+      jobs_.erase(std::find(jobs_.begin(), jobs_.end(), &j));
+    }
+    execute(j, k, lock);
+  }
+  j.done.wait(lock, [&j] { return j.finished == j.n_tasks; });
+  lock.unlock();
+
+  if (j.error) {
+    std::rethrow_exception(j.error);
+  }
+}
+
+std::shared_ptr<thread_pool> default_thread_pool()
+{
+  std::lock_guard<std::mutex> lock(default_pool_mutex);
+  if (!default_pool) {
+    default_pool = std::make_shared<thread_pool>(default_num_threads());
+  }
+  return default_pool;
+}
+
+unsigned get_num_threads()
+{
+  return default_thread_pool()->size();
+}
+
+void set_num_threads(unsigned num_threads)
+{
+  if (num_threads == 0) {
+    num_threads = default_num_threads();
+  }
+  auto pool = std::make_shared<thread_pool>(num_threads);
+
+  // jobs still running on the old pool keep it alive until they finish
+  std::lock_guard<std::mutex> lock(default_pool_mutex);
+  default_pool = pool;
+}
+
+}}
@@ -0,0 +1,154 @@
+#ifndef pyvil_parallel_h_included_
+#define pyvil_parallel_h_included_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace pyvxl { namespace vil {
+
+/* A fixed size pool of worker threads. run() splits a job into n_tasks
+ * independent tasks, and the calling thread works on its own job alongside
+ * the workers, so a pool of size 1 has no workers at all and simply runs
+ * everything on the caller. Several threads may run jobs concurrently.
+ * Jobs started from inside a worker run serially on that worker. */
+class thread_pool {
+public:
+  explicit thread_pool(unsigned num_threads);
+  ~thread_pool();
+
+  thread_pool(thread_pool const&) = delete;
+  thread_pool& operator=(thread_pool const&) = delete;
+
+  //: Number of threads working on a job, including the caller
+  unsigned size() const { return static_cast<unsigned>(workers_.size()) + 1; }
+
+  //: Run task(k) for every k in [0, n_tasks) and wait for all of them.
+  //  The first exception thrown by a task is rethrown here.
+  void run(std::size_t n_tasks, std::function<void(std::size_t)> const& task);
+
+private:
+  struct job;
+
+  void worker_loop();
+  void execute(job& j, std::size_t k, std::unique_lock<std::mutex>& lock);
+
+  std::vector<std::thread> workers_;
+  std::deque<job*> jobs_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_;
+};
+
+//: The pool shared by all vil bindings
+std::shared_ptr<thread_pool> default_thread_pool();
+
+//: Number of threads used by the vil bindings, defaults to the number of cores
+unsigned get_num_threads();
+
+//: Resize the shared pool. 0 selects the number of cores.
+void set_num_threads(unsigned num_threads);
+
+
+//: Number of rows in each band when an image of ni x nj pixels is split up.
+//  This depends only on the image size, never on the number of threads, so
+//  the partition (and anything reduced over it) is always the same.
+inline unsigned row_band_size(unsigned ni, unsigned nj)
+{
+  const std::size_t band_pixels = std::size_t(1) << 18;
+  std::size_t rows = band_pixels / std::max(ni, 1u);
+  return static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(rows, nj)));
+}
+
+inline std::size_t num_row_bands(unsigned ni, unsigned nj)
+{
+  if (nj == 0) {
+    return 0;
+  }
+  unsigned band = row_band_size(ni, nj);
+  return (nj + band - 1) / band;
+}
+
+//: Call f(j0, j1) for consecutive bands of rows [j0, j1) covering [0, nj)
+template <class F>
+void parallel_for_rows(unsigned ni, unsigned nj, F f)
+{
+  const unsigned band = row_band_size(ni, nj);
+  default_thread_pool()->run(num_row_bands(ni, nj), [&](std::size_t k) {
+    unsigned j0 = static_cast<unsigned>(k * band);
+    f(j0, std::min(j0 + band, nj));
+  });
+}
+
+//: Compute f(j0, j1) -> T for every band of rows, then fold the partial
+//  results with result = combine(result, partial) in band order, starting
+//  from init. Partials are folded as soon as every earlier band is done,
+//  and a band isn't started while too many later ones are waiting on an
+//  earlier band, so only a few partials are ever held at once.
+template <class T, class F, class Combine>
+T parallel_reduce_rows(unsigned ni, unsigned nj, T init, F f, Combine combine)
+{
+  const unsigned band = row_band_size(ni, nj);
+  const std::size_t n_bands = num_row_bands(ni, nj);
+  const std::size_t max_pending = 2 * std::size_t(get_num_threads());
+
+  T result = std::move(init);
+  std::map<std::size_t, T> pending;
+  std::size_t next = 0;
+  bool folding = false, failed = false;
+  std::mutex mutex;
+  std::condition_variable folded;
+  default_thread_pool()->run(n_bands, [&](std::size_t k) {
+    std::unique_lock<std::mutex> lock(mutex);
+    // bands are handed out in order, so band next is already running
+    folded.wait(lock, [&] { return failed || k < next + max_pending; });
+    if (failed) {
+      return;
+    }
+    lock.unlock();
+    try {
+      unsigned j0 = static_cast<unsigned>(k * band);
+      T partial = f(j0, std::min(j0 + band, nj));
+
+      lock.lock();
+      pending.emplace(k, std::move(partial));
+      if (folding) {
+        return;
+      }
+      folding = true;
+      for (auto it = pending.find(next); it != pending.end(); it = pending.find(next)) {
+        T ready = std::move(it->second);
+        pending.erase(it);
+        lock.unlock();
+        result = combine(result, ready);
+        lock.lock();
+        ++next;
+        folded.notify_all();
+      }
+      folding = false;
+    }
+    catch (...) {
+      // nothing after this band can be folded, so don't leave anyone waiting
+      if (!lock.owns_lock()) {
+        lock.lock();
+      }
+      failed = true;
+      folded.notify_all();
+      throw;
+    }
+  });
+  return result;
+}
+
+}}
+
+#endif
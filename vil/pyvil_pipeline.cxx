@@ -0,0 +1,360 @@
+#include "pyvil_pipeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+#include <vil/vil_blocked_image_resource.h>
+#include <vil/vil_copy.h>
+#include <vil/vil_crop.h>
+#include <vil/vil_image_view.h>
+
+#include "pyvil_filter.h"
+#include "pyvil_parallel.h"
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+namespace {
+
+inline unsigned component_planes(vil_image_resource const& r)
+{
+  return r.nplanes() * vil_pixel_format_num_components(r.pixel_format());
+}
+
+inline vil_pixel_format component_format(vil_image_resource const& r)
+{
+  return vil_pixel_format_component_format(r.pixel_format());
+}
+
+// Reads or writes row j of plane p of a window as doubles
+typedef std::function<void(unsigned j, unsigned p, double* row)> row_function;
+
+template <class T>
+struct row_reader {
+  static row_function run(vil_image_view_base const& base)
+  {
+    // compound pixels (e.g. RGB) are seen as planes of their components
+    vil_image_view<T> view(base);
+    return [view](unsigned j, unsigned p, double* row) {
+      T const* src = view.top_left_ptr() + j * view.jstep() + p * view.planestep();
+      const std::ptrdiff_t istep = view.istep();
+      for (unsigned i = 0; i < view.ni(); ++i) {
+        row[i] = src[i * istep];
+      }
+    };
+  }
+};
+
+template <class T>
+struct row_writer {
+  static row_function run(unsigned ni, unsigned nj, unsigned nplanes, vil_image_view_base_sptr& out)
+  {
+    typedef typename pixel_component<T>::type C;
+    out = new vil_image_view<T>(ni, nj, nplanes);
+    // written as planes of its components, out keeping the memory alive
+    // for as long as the function is used
+    vil_image_view<C> view(*out);
+    C* const origin = view.top_left_ptr();
+    const std::ptrdiff_t istep = view.istep(), jstep = view.jstep(), planestep = view.planestep();
+    return [=](unsigned j, unsigned p, double* row) {
+      C* dest = origin + j * jstep + p * planestep;
+      for (unsigned i = 0; i < ni; ++i) {
+        dest[i * istep] = saturate_cast<C>(row[i]);
+      }
+    };
+  }
+};
+
+template <class T>
+struct saturate_row_op {
+  static void run(double* row, unsigned n)
+  {
+    for (unsigned i = 0; i < n; ++i) {
+      row[i] = saturate_cast<T>(row[i]);
+    }
+  }
+};
+
+template <class T>
+struct pad_op {
+  //: tile copied into the top left of a zeroed size x size block
+  static vil_image_view_base_sptr run(vil_image_view_base const& tile, unsigned size)
+  {
+    vil_image_view<T> typed(tile);
+    vil_image_view<T>* block = new vil_image_view<T>(size, size, typed.nplanes());
+    block->fill(T(0));
+    vil_copy_to_window(typed, *block, 0, 0);
+    return block;
+  }
+};
+
+}
+
+//---------------------------------------------------------------------------
+
+pipeline_source::pipeline_source(vil_image_resource_sptr const& source)
+  : pipeline_node(source ? source->ni() : 0, source ? source->nj() : 0,
+                  source ? source->nplanes() : 0, source ? source->pixel_format() : VIL_PIXEL_FORMAT_UNKNOWN),
+    source_(source)
+{
+  if (!source) {
+    throw std::invalid_argument("pipeline: null image resource");
+  }
+}
+
+vil_image_view_base_sptr pipeline_source::get_copy_view(unsigned i0, unsigned n_i,
+                                                        unsigned j0, unsigned n_j) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return source_->get_copy_view(i0, n_i, j0, n_j);
+}
+
+//---------------------------------------------------------------------------
+
+pipeline_crop::pipeline_crop(pipeline_node_sptr const& input, unsigned i0, unsigned n_i,
+                             unsigned j0, unsigned n_j)
+  : pipeline_node(n_i, n_j, input->nplanes(), input->pixel_format()),
+    input_(input), i0_(i0), j0_(j0)
+{
+  if (std::size_t(i0) + n_i > input->ni() || std::size_t(j0) + n_j > input->nj()) {
+    throw std::out_of_range("pipeline: crop window outside the image");
+  }
+}
+
+vil_image_view_base_sptr pipeline_crop::get_copy_view(unsigned i0, unsigned n_i,
+                                                      unsigned j0, unsigned n_j) const
+{
+  if (std::size_t(i0) + n_i > ni() || std::size_t(j0) + n_j > nj()) {
+    return nullptr;
+  }
+  return input_->get_copy_view(i0_ + i0, n_i, j0_ + j0, n_j);
+}
+
+//---------------------------------------------------------------------------
+
+pipeline_pointwise::pipeline_pointwise(std::vector<pipeline_node_sptr> const& inputs, pointwise_combine how,
+                                       std::vector<pointwise_op> const& ops, vil_pixel_format format)
+  : pipeline_node(inputs[0]->ni(), inputs[0]->nj(),
+                  component_planes(*inputs[0]) / vil_pixel_format_num_components(format), format),
+    inputs_(inputs), how_(how), ops_(ops)
+{
+}
+
+std::vector<pointwise_op> pipeline_pointwise::fused_ops(std::vector<pointwise_op> const& next) const
+{
+  std::vector<pointwise_op> ops = ops_;
+  // what writing this node would have done, which is nothing for double
+  if (pixel_format() != VIL_PIXEL_FORMAT_DOUBLE) {
+    ops.push_back(pointwise_op{pointwise_op::saturate, {}, {}, pixel_format()});
+  }
+  ops.insert(ops.end(), next.begin(), next.end());
+  return ops;
+}
+
+pipeline_node_sptr pipeline_pointwise::append(pipeline_node_sptr const& input, std::vector<pointwise_op> const& ops,
+                                              vil_pixel_format format)
+{
+  const unsigned nplanes = component_planes(*input);
+  for (auto const& op : ops) {
+    if (op.a.empty() || op.b.empty() ||
+        (op.a.size() != 1 && op.a.size() != nplanes) || (op.b.size() != 1 && op.b.size() != nplanes)) {
+      throw std::invalid_argument("pipeline: need one parameter, or one per plane");
+    }
+  }
+  // steps after a pointwise node join it, so the window is only walked once
+  if (pipeline_pointwise const* p = dynamic_cast<pipeline_pointwise const*>(input.ptr())) {
+    return new pipeline_pointwise(p->inputs_, p->how_, p->fused_ops(ops), format);
+  }
+  return new pipeline_pointwise({input}, pointwise_combine::none, ops, format);
+}
+
+pipeline_node_sptr pipeline_pointwise::convert(pipeline_node_sptr const& input, vil_pixel_format format)
+{
+  if (format == VIL_PIXEL_FORMAT_RGB_BYTE && component_planes(*input) != 3) {
+    throw std::invalid_argument("pipeline: an RGB image needs 3 planes");
+  }
+  if (pipeline_pointwise const* p = dynamic_cast<pipeline_pointwise const*>(input.ptr())) {
+    if (p->pixel_format() == format) {
+      return input;
+    }
+    return new pipeline_pointwise(p->inputs_, p->how_, p->fused_ops({}), format);
+  }
+  return new pipeline_pointwise({input}, pointwise_combine::none, {}, format);
+}
+
+pipeline_node_sptr pipeline_pointwise::combine(pipeline_node_sptr const& a, pipeline_node_sptr const& b,
+                                               pointwise_combine how, vil_pixel_format format)
+{
+  if (a->ni() != b->ni() || a->nj() != b->nj() || component_planes(*a) != component_planes(*b)) {
+    throw std::invalid_argument("pipeline: images must have the same size and planes");
+  }
+  return new pipeline_pointwise({a, b}, how, {}, format);
+}
+
+vil_image_view_base_sptr pipeline_pointwise::get_copy_view(unsigned i0, unsigned n_i,
+                                                           unsigned j0, unsigned n_j) const
+{
+  std::vector<row_function> readers;
+  for (auto const& input : inputs_) {
+    vil_image_view_base_sptr base = input->get_copy_view(i0, n_i, j0, n_j);
+    if (!base) {
+      return nullptr;
+    }
+    readers.push_back(dispatch_component_type<row_reader>(base->pixel_format(), *base));
+  }
+  vil_image_view_base_sptr out;
+  row_function writer = dispatch_pixel_type<row_writer>(pixel_format(), n_i, n_j, nplanes(), out);
+
+  // one row at a time through every step, so it stays in cache
+  std::vector<double> row(n_i), other(inputs_.size() > 1 ? n_i : 0);
+  const unsigned planes = component_planes(*this);
+  for (unsigned p = 0; p < planes; ++p) {
+    for (unsigned j = 0; j < n_j; ++j) {
+      readers[0](j, p, row.data());
+      if (how_ != pointwise_combine::none) {
+        readers[1](j, p, other.data());
+        for (unsigned i = 0; i < n_i; ++i) {
+          switch (how_) {
+            case pointwise_combine::add: row[i] += other[i]; break;
+            case pointwise_combine::subtract: row[i] -= other[i]; break;
+            case pointwise_combine::multiply: row[i] *= other[i]; break;
+            case pointwise_combine::none: break;
+          }
+        }
+      }
+      for (auto const& op : ops_) {
+        switch (op.kind) {
+          case pointwise_op::affine: {
+            const double a = op.a_of(p), b = op.b_of(p);
+            for (unsigned i = 0; i < n_i; ++i) {
+              row[i] = a * row[i] + b;
+            }
+            break;
+          }
+          case pointwise_op::clamp: {
+            const double a = op.a_of(p), b = op.b_of(p);
+            for (unsigned i = 0; i < n_i; ++i) {
+              row[i] = std::min(std::max(row[i], a), b);
+            }
+            break;
+          }
+          case pointwise_op::floor:
+            for (unsigned i = 0; i < n_i; ++i) {
+              row[i] = std::floor(row[i]);
+            }
+            break;
+          case pointwise_op::saturate:
+            dispatch_component_type<saturate_row_op>(op.format, row.data(), n_i);
+            break;
+        }
+      }
+      writer(j, p, row.data());
+    }
+  }
+  return out;
+}
+
+//---------------------------------------------------------------------------
+
+template <class T>
+struct pipeline_filter::filter_op {
+  static vil_image_view_base_sptr run(vil_image_view_base const& base, std::vector<float> const& kernel_i,
+                                      std::vector<float> const& kernel_j, unsigned di, unsigned dj,
+                                      unsigned n_i, unsigned n_j)
+  {
+    vil_image_view<T> in(base);
+    vil_image_view<T> out(in.ni(), in.nj(), in.nplanes());
+    separable_filter(in, out, kernel_i, kernel_j);
+    return new vil_image_view<T>(vil_crop(out, di, n_i, dj, n_j));
+  }
+};
+
+pipeline_filter::pipeline_filter(pipeline_node_sptr const& input, std::vector<float> const& kernel_i,
+                                 std::vector<float> const& kernel_j)
+  : pipeline_node(input->ni(), input->nj(), component_planes(*input), component_format(*input)),
+    input_(input), kernel_i_(kernel_i), kernel_j_(kernel_j)
+{
+  if (kernel_i.empty() || kernel_j.empty()) {
+    throw std::invalid_argument("pipeline: empty kernel");
+  }
+}
+
+vil_image_view_base_sptr pipeline_filter::get_copy_view(unsigned i0, unsigned n_i,
+                                                        unsigned j0, unsigned n_j) const
+{
+  if (std::size_t(i0) + n_i > ni() || std::size_t(j0) + n_j > nj()) {
+    return nullptr;
+  }
+  // the window and the halo the kernels reach, clipped to the image where
+  // separable_filter replicates the edge just as for the whole image
+  const unsigned a0 = static_cast<unsigned>(kernel_i_.size() / 2), b0 = static_cast<unsigned>(kernel_j_.size() / 2);
+  const unsigned in_i0 = i0 - std::min(i0, a0), in_j0 = j0 - std::min(j0, b0);
+  const unsigned in_i1 = std::min<unsigned>(ni(), i0 + n_i + static_cast<unsigned>(kernel_i_.size()) - 1 - a0);
+  const unsigned in_j1 = std::min<unsigned>(nj(), j0 + n_j + static_cast<unsigned>(kernel_j_.size()) - 1 - b0);
+  vil_image_view_base_sptr base = input_->get_copy_view(in_i0, in_i1 - in_i0, in_j0, in_j1 - in_j0);
+  if (!base) {
+    return nullptr;
+  }
+  return dispatch_component_type<filter_op>(pixel_format(), *base, kernel_i_, kernel_j_,
+                                            i0 - in_i0, j0 - in_j0, n_i, n_j);
+}
+
+//---------------------------------------------------------------------------
+
+void evaluate_pipeline(vil_image_resource_sptr const& pipeline, vil_image_resource_sptr const& output,
+                       unsigned tile_size)
+{
+  if (!pipeline || !output) {
+    throw std::invalid_argument("pipeline: null image resource");
+  }
+  if (tile_size == 0) {
+    throw std::invalid_argument("pipeline: tile_size must be positive");
+  }
+  if (output->ni() != pipeline->ni() || output->nj() != pipeline->nj() ||
+      component_planes(*output) != component_planes(*pipeline) ||
+      component_format(*output) != component_format(*pipeline)) {
+    throw std::invalid_argument("pipeline: output must have the size and pixel format of the pipeline");
+  }
+
+  vil_blocked_image_resource_sptr blocked = blocked_image_resource(output);
+  if (blocked && (blocked->size_block_i() != tile_size || blocked->size_block_j() != tile_size)) {
+    blocked = nullptr;
+  }
+
+  const unsigned ni = pipeline->ni(), nj = pipeline->nj();
+  const std::size_t n_tiles = (ni + tile_size - 1) / tile_size;
+  std::vector<vil_image_view_base_sptr> tiles(n_tiles);
+  for (unsigned j0 = 0; j0 < nj; j0 += tile_size) {
+    const unsigned n_j = std::min(tile_size, nj - j0);
+    // each task owns its slot, and the views are only shared once the job is done
+    default_thread_pool()->run(n_tiles, [&](std::size_t t) {
+      const unsigned i0 = static_cast<unsigned>(t * tile_size);
+      tiles[t] = pipeline->get_copy_view(i0, std::min(tile_size, ni - i0), j0, n_j);
+    });
+
+    for (std::size_t t = 0; t < n_tiles; ++t) {
+      if (!tiles[t]) {
+        throw std::runtime_error("pipeline: failed to compute a tile");
+      }
+      const unsigned i0 = static_cast<unsigned>(t * tile_size);
+      bool written;
+      if (blocked) {
+        // blocks are always written whole, edge blocks padded with zeros
+        vil_image_view_base_sptr block =
+          dispatch_component_type<pad_op>(tiles[t]->pixel_format(), *tiles[t], tile_size);
+        written = blocked->put_block(i0 / tile_size, j0 / tile_size, *block);
+      }
+      else {
+        written = output->put_view(*tiles[t], i0, j0);
+      }
+      if (!written) {
+        throw std::runtime_error("pipeline: failed to write a tile");
+      }
+      tiles[t] = nullptr;
+    }
+  }
+}
+
+}}
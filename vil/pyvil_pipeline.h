@@ -0,0 +1,152 @@
+#ifndef pyvil_pipeline_h_included_
+#define pyvil_pipeline_h_included_
+
+#include <mutex>
+#include <vector>
+
+#include <vil/vil_image_resource.h>
+#include <vil/vil_image_view_base.h>
+#include <vil/vil_pixel_format.h>
+#include <vil/vil_smart_ptr.h>
+
+namespace pyvxl { namespace vil {
+
+/* Lazy image pipelines. Each node is an image resource computing any
+ * window asked of it from the windows it needs of its inputs, so a chain
+ * of nodes only ever holds the pixels of the windows in flight. Runs of
+ * pointwise steps (type conversion, stretch, truncation, arithmetic) are
+ * fused into one node making a single pass over each window. Compound
+ * pixels are seen as planes of their components past the source node,
+ * until a conversion to VIL_PIXEL_FORMAT_RGB_BYTE puts them back together.
+ * evaluate_pipeline pulls a pipeline tile by tile on the shared pool. */
+
+class pipeline_node : public vil_image_resource {
+public:
+  unsigned nplanes() const override { return nplanes_; }
+  unsigned ni() const override { return ni_; }
+  unsigned nj() const override { return nj_; }
+  enum vil_pixel_format pixel_format() const override { return format_; }
+
+  using vil_image_resource::get_copy_view;
+
+  //: Pipelines are read only
+  bool put_view(vil_image_view_base const&, unsigned, unsigned) override { return false; }
+  using vil_image_resource::put_view;
+
+  bool get_property(char const*, void* = nullptr) const override { return false; }
+
+protected:
+  pipeline_node(unsigned ni, unsigned nj, unsigned nplanes, vil_pixel_format format)
+    : ni_(ni), nj_(nj), nplanes_(nplanes), format_(format) {}
+
+private:
+  unsigned ni_, nj_, nplanes_;
+  vil_pixel_format format_;
+};
+
+typedef vil_smart_ptr<pipeline_node> pipeline_node_sptr;
+
+//: The start of a pipeline. Reads of the source are serialised, so tiles
+//  can be pulled from several threads whatever the source.
+class pipeline_source : public pipeline_node {
+public:
+  explicit pipeline_source(vil_image_resource_sptr const& source);
+
+  vil_image_view_base_sptr get_copy_view(unsigned i0, unsigned n_i,
+                                         unsigned j0, unsigned n_j) const override;
+
+  vil_image_resource_sptr source() const { return source_; }
+
+private:
+  vil_image_resource_sptr source_;
+  mutable std::mutex mutex_;
+};
+
+class pipeline_crop : public pipeline_node {
+public:
+  pipeline_crop(pipeline_node_sptr const& input, unsigned i0, unsigned n_i, unsigned j0, unsigned n_j);
+
+  vil_image_view_base_sptr get_copy_view(unsigned i0, unsigned n_i,
+                                         unsigned j0, unsigned n_j) const override;
+
+private:
+  pipeline_node_sptr input_;
+  unsigned i0_, j0_;
+};
+
+//: v -> a * v + b, v -> clamp(v, a, b) or v -> floor(v), with a and b
+//  given once or per plane, or v rounded and saturated to format as a
+//  pixel of that format would be
+struct pointwise_op {
+  enum kind_t { affine, clamp, floor, saturate } kind;
+  std::vector<double> a, b;
+  vil_pixel_format format;
+
+  double a_of(unsigned p) const { return a.size() == 1 ? a[0] : a[p]; }
+  double b_of(unsigned p) const { return b.size() == 1 ? b[0] : b[p]; }
+};
+
+enum class pointwise_combine { none, add, subtract, multiply };
+
+/* One or two inputs of the same size, combined pixel by pixel and passed
+ * through a list of pointwise ops in double, then rounded and saturated
+ * to the output format. A step fused into a node whose format isn't double
+ * first rounds and saturates to that format, so each step keeps the pixel
+ * type it was given, just as if it were a node of its own. */
+class pipeline_pointwise : public pipeline_node {
+public:
+  //: input with ops applied, as one step into format, fused into input
+  //  when it is pointwise itself
+  static pipeline_node_sptr append(pipeline_node_sptr const& input, std::vector<pointwise_op> const& ops,
+                                   vil_pixel_format format);
+
+  //: Convert input to format, rounding and saturating. An RGB format
+  //  needs an input of 3 planes, and gives a single plane of RGB pixels.
+  static pipeline_node_sptr convert(pipeline_node_sptr const& input, vil_pixel_format format);
+
+  //: a combined with b pixel by pixel, into format
+  static pipeline_node_sptr combine(pipeline_node_sptr const& a, pipeline_node_sptr const& b,
+                                    pointwise_combine how, vil_pixel_format format);
+
+  vil_image_view_base_sptr get_copy_view(unsigned i0, unsigned n_i,
+                                         unsigned j0, unsigned n_j) const override;
+
+private:
+  pipeline_pointwise(std::vector<pipeline_node_sptr> const& inputs, pointwise_combine how,
+                     std::vector<pointwise_op> const& ops, vil_pixel_format format);
+
+  //: The ops of this node, then those of a step after it
+  std::vector<pointwise_op> fused_ops(std::vector<pointwise_op> const& next) const;
+
+  std::vector<pipeline_node_sptr> inputs_;
+  pointwise_combine how_;
+  std::vector<pointwise_op> ops_;
+};
+
+//: Separable filter of input as separable_filter, in the component format
+//  of input. Windows are read with a halo so tiles join up seamlessly.
+class pipeline_filter : public pipeline_node {
+public:
+  pipeline_filter(pipeline_node_sptr const& input, std::vector<float> const& kernel_i,
+                  std::vector<float> const& kernel_j);
+
+  vil_image_view_base_sptr get_copy_view(unsigned i0, unsigned n_i,
+                                         unsigned j0, unsigned n_j) const override;
+
+private:
+  template <class T> struct filter_op;
+
+  pipeline_node_sptr input_;
+  std::vector<float> kernel_i_, kernel_j_;
+};
+
+//: Compute every tile_size x tile_size tile of pipeline in parallel, a row
+//  of tiles at a time, and write them to output, which has the size and
+//  pixel format of pipeline. A blocked output with tile_size blocks gets
+//  whole blocks.
+void evaluate_pipeline(vil_image_resource_sptr const& pipeline, vil_image_resource_sptr const& output,
+                       unsigned tile_size);
+
+}}
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef pyvil_pixel_types_h_included_
+#define pyvil_pixel_types_h_included_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include <vil/vil_image_view.h>
+#include <vil/vil_memory_chunk.h>
+#include <vil/vil_pixel_format.h>
+#include <vil/vil_rgb.h>
+
+namespace pyvxl { namespace vil {
+
+//: Number of bytes in one pixel of the given format
+inline std::size_t pixel_format_sizeof(vil_pixel_format format)
+{
+  return vil_pixel_format_sizeof_components(format) *
+         vil_pixel_format_num_components(format);
+}
+
+//: Type of one component of a pixel of type T, e.g. vxl_byte for vil_rgb<vxl_byte>
+template <class T> struct pixel_component { typedef T type; };
+template <class T> struct pixel_component<vil_rgb<T> > { typedef T type; };
+
+namespace detail {
+
+template <class T>
+T saturate_cast(double v, std::true_type /* integral */)
+{
+  v = std::floor(v + 0.5);
+  v = std::min(std::max(v, double(std::numeric_limits<T>::lowest())), double(std::numeric_limits<T>::max()));
+  return static_cast<T>(v);
+}
+
+template <class T>
+T saturate_cast(double v, std::false_type /* integral */)
+{
+  return static_cast<T>(v);
+}
+
+}
+
+//: v as a pixel of type T, rounded to nearest and clamped to the range of
+//  T for integer types
+template <class T>
+T saturate_cast(double v)
+{
+  return detail::saturate_cast<T>(v, std::is_integral<T>());
+}
+
+template <>
+inline bool saturate_cast<bool>(double v)
+{
+  return v >= 0.5;
+}
+
+#define PYVXL_VIL_COMPONENT_CASE(FORMAT) \
+  case FORMAT: \
+    return Op<typename vil_pixel_format_type_of<FORMAT>::component_type>::run(std::forward<Args>(args)...);
+
+/* Call Op<T>::run(args...) with T the component type of format, e.g.
+ * vxl_byte for both VIL_PIXEL_FORMAT_BYTE and VIL_PIXEL_FORMAT_RGB_BYTE.
+ * Lets code which works on any resource or view pick the typed
+ * vil_image_view<T> to use at run time. */
+template <template <class> class Op, class... Args>
+auto dispatch_component_type(vil_pixel_format format, Args&&... args)
+  -> decltype(Op<vxl_byte>::run(std::forward<Args>(args)...))
+{
+  switch (vil_pixel_format_component_format(format)) {
+#if VXL_HAS_INT_64
+    PYVXL_VIL_COMPONENT_CASE(VIL_PIXEL_FORMAT_UINT_64)
+    PYVXL_VIL_COMPONENT_CASE(VIL_PIXEL_FORMAT_INT_64)
+#endif
+    PYVXL_VIL_COMPONENT_CASE(VIL_PIXEL_FORMAT_UINT_32)
+    PYVXL_VIL_COMPONENT_CASE(VIL_PIXEL_FORMAT_INT_32)
+    PYVXL_VIL_COMPONENT_CASE(VIL_PIXEL_FORMAT_UINT_16)
+    PYVXL_VIL_COMPONENT_CASE(VIL_PIXEL_FORMAT_INT_16)
+    PYVXL_VIL_COMPONENT_CASE(VIL_PIXEL_FORMAT_BYTE)
+    PYVXL_VIL_COMPONENT_CASE(VIL_PIXEL_FORMAT_SBYTE)
+    PYVXL_VIL_COMPONENT_CASE(VIL_PIXEL_FORMAT_FLOAT)
+    PYVXL_VIL_COMPONENT_CASE(VIL_PIXEL_FORMAT_DOUBLE)
+    PYVXL_VIL_COMPONENT_CASE(VIL_PIXEL_FORMAT_BOOL)
+    default:
+      throw std::runtime_error("Unsupported vil pixel format");
+  }
+}
+
+#undef PYVXL_VIL_COMPONENT_CASE
+
+/* As dispatch_component_type, but with T the whole pixel type: vil_rgb<vxl_byte>
+ * for VIL_PIXEL_FORMAT_RGB_BYTE, the only compound format with a wrapped view.
+ * Other compound formats are refused. */
+template <template <class> class Op, class... Args>
+auto dispatch_pixel_type(vil_pixel_format format, Args&&... args)
+  -> decltype(Op<vxl_byte>::run(std::forward<Args>(args)...))
+{
+  if (format == VIL_PIXEL_FORMAT_RGB_BYTE) {
+    return Op<vil_rgb<vxl_byte> >::run(std::forward<Args>(args)...);
+  }
+  if (vil_pixel_format_num_components(format) != 1) {
+    throw std::invalid_argument("Unsupported compound vil pixel format");
+  }
+  return dispatch_component_type<Op>(format, std::forward<Args>(args)...);
+}
+
+/* A vil_memory_chunk over memory belonging to something else, such as a
+ * file mapping or a shared memory segment, with data() and size(). The
+ * chunk keeps its owner alive for as long as any view refers to it. */
+template <class Owner>
+class external_memory_chunk : public vil_memory_chunk {
+public:
+  external_memory_chunk(std::shared_ptr<Owner> const& owner, vil_pixel_format pixel_format)
+    : vil_memory_chunk(), owner_(owner)
+  {
+    data_ = owner_->data();
+    size_ = owner_->size();
+    pixel_format_ = pixel_format;
+  }
+
+  ~external_memory_chunk() override
+  {
+    // the memory belongs to the owner, don't let the base class delete it
+    data_ = nullptr;
+  }
+
+  Owner& owner() const { return *owner_; }
+
+private:
+  std::shared_ptr<Owner> owner_;
+};
+
+namespace detail {
+
+template <class T>
+struct memory_chunk_op {
+  static vil_memory_chunk* run(vil_image_view_base const& view)
+  {
+    vil_image_view<T> v(view);
+    return v.memory_chunk().ptr();
+  }
+};
+
+template <class T>
+struct chunk_view_op {
+  static vil_image_view_base_sptr run(vil_memory_chunk_sptr const& chunk, unsigned ni, unsigned nj,
+                                      unsigned nplanes)
+  {
+    T* data = static_cast<T*>(chunk->data());
+    return new vil_image_view<T>(chunk, data, ni, nj, nplanes, 1, ni, std::ptrdiff_t(ni) * nj);
+  }
+};
+
+}
+
+//: The memory chunk holding the pixels of view, null if it has none
+inline vil_memory_chunk* memory_chunk_of(vil_image_view_base const& view)
+{
+  return dispatch_component_type<detail::memory_chunk_op>(view.pixel_format(), view);
+}
+
+//: A view of format laid out as vil_image_view from the start of chunk,
+//  which must hold at least ni*nj*nplanes pixels
+inline vil_image_view_base_sptr new_chunk_view(vil_memory_chunk_sptr const& chunk, unsigned ni, unsigned nj,
+                                               unsigned nplanes, vil_pixel_format format)
+{
+  return dispatch_pixel_type<detail::chunk_view_op>(format, chunk, ni, nj, nplanes);
+}
+
+}}
+
+#endif
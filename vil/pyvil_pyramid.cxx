@@ -0,0 +1,337 @@
+#include "pyvil_pyramid.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vil/vil_blocked_image_resource.h>
+#include <vil/vil_copy.h>
+#include <vil/vil_crop.h>
+#include <vil/vil_image_view.h>
+#include <vil/vil_new.h>
+
+#include "pyvil_parallel.h"
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+namespace {
+
+// 1D decimation filter. Output pixel i of a level is the weighted sum of
+// input pixels 2i + first_offset + k of the level below, edges replicated.
+struct decimation_filter {
+  int first_offset;
+  std::vector<double> weights;
+
+  int last_offset() const { return first_offset + static_cast<int>(weights.size()) - 1; }
+};
+
+decimation_filter make_filter(pyramid_kernel kernel)
+{
+  switch (kernel) {
+    case pyramid_kernel::box:
+      return decimation_filter{0, {0.5, 0.5}};
+    case pyramid_kernel::gaussian:
+      return decimation_filter{-2, {1/16.0, 4/16.0, 6/16.0, 4/16.0, 1/16.0}};
+  }
+  throw std::invalid_argument("build_pyramid: unknown kernel");
+}
+
+std::string level_filename(std::string const& directory, unsigned level, std::string const& file_format)
+{
+  std::string extension = file_format == "tiff" ? "tif" : file_format;
+  return directory + "/level_" + std::to_string(level) + "." + extension;
+}
+
+//: Remove the level_<k>.* files of an earlier build, which would otherwise
+//  be loaded as extra levels of a shallower pyramid
+void remove_old_levels(std::string const& directory)
+{
+  DIR* dir = ::opendir(directory.c_str());
+  if (!dir) {
+    throw std::runtime_error("build_pyramid: can't read " + directory + ": " + std::strerror(errno));
+  }
+  std::vector<std::string> old_levels;
+  while (dirent const* entry = ::readdir(dir)) {
+    const std::string name = entry->d_name;
+    const std::size_t digits = name.find_first_not_of("0123456789", 6);
+    if (name.compare(0, 6, "level_") == 0 && digits > 6 && digits != std::string::npos && name[digits] == '.') {
+      old_levels.push_back(directory + "/" + name);
+    }
+  }
+  ::closedir(dir);
+
+  for (auto const& filename : old_levels) {
+    if (::unlink(filename.c_str()) != 0) {
+      throw std::runtime_error("build_pyramid: can't remove " + filename + ": " + std::strerror(errno));
+    }
+  }
+}
+
+/* One level of the pyramid, produced top to bottom in strips of one row of
+ * tiles and written to its file as each strip is made. The level above asks
+ * for windows of rows which only ever move down the image, so strips wholly
+ * above the last request are dropped. */
+template <class T>
+class pyramid_level {
+public:
+  pyramid_level(unsigned ni, unsigned nj, unsigned nplanes, unsigned tile_size,
+                vil_blocked_image_resource_sptr const& output)
+    : ni_(ni), nj_(nj), nplanes_(nplanes), tile_size_(tile_size),
+      n_strips_((nj + tile_size - 1) / tile_size), next_strip_(0), output_(output) {}
+  virtual ~pyramid_level() {}
+
+  unsigned ni() const { return ni_; }
+  unsigned nj() const { return nj_; }
+  unsigned nplanes() const { return nplanes_; }
+
+  //: Rows [j0, j1) of every plane, j0 never going back up between calls
+  vil_image_view<T> rows(unsigned j0, unsigned j1)
+  {
+    while (strips_end() < j1) {
+      next_strip();
+    }
+    while (!strips_.empty() && strips_.front().j0 + strips_.front().view.nj() <= j0) {
+      strips_.pop_front();
+    }
+
+    if (j1 <= strips_.front().j0 + strips_.front().view.nj()) {
+      return vil_crop(strips_.front().view, 0, ni_, j0 - strips_.front().j0, j1 - j0);
+    }
+    vil_image_view<T> window(ni_, j1 - j0, nplanes_);
+    for (auto const& s : strips_) {
+      const unsigned s1 = s.j0 + s.view.nj();
+      const unsigned c0 = std::max(j0, s.j0), c1 = std::min(j1, s1);
+      if (c0 < c1) {
+        vil_copy_to_window(vil_crop(s.view, 0, ni_, c0 - s.j0, c1 - c0), window, 0, c0 - j0);
+      }
+    }
+    return window;
+  }
+
+  //: Produce and write every strip not asked for yet
+  void finish()
+  {
+    while (next_strip_ < n_strips_) {
+      next_strip();
+    }
+    strips_.clear();
+  }
+
+protected:
+  //: Make n rows of this level starting at row j0
+  virtual vil_image_view<T> produce(unsigned j0, unsigned n) = 0;
+
+  unsigned tile_size() const { return tile_size_; }
+
+private:
+  struct strip {
+    unsigned j0;
+    vil_image_view<T> view;
+  };
+
+  unsigned strips_end() const
+  {
+    return strips_.empty() ? 0 : strips_.back().j0 + strips_.back().view.nj();
+  }
+
+  void next_strip()
+  {
+    if (next_strip_ >= n_strips_) {
+      throw std::logic_error("build_pyramid: read past the end of a level");
+    }
+    const unsigned bj = next_strip_++;
+    const unsigned j0 = bj * tile_size_;
+    vil_image_view<T> view = produce(j0, std::min(tile_size_, nj_ - j0));
+    write(bj, view);
+    strips_.push_back(strip{j0, view});
+  }
+
+  void write(unsigned bj, vil_image_view<T> const& view)
+  {
+    // blocks are always written whole, edge blocks padded with zeros
+    vil_image_view<T> block(tile_size_, tile_size_, nplanes_);
+    for (unsigned bi = 0; bi * tile_size_ < ni_; ++bi) {
+      const unsigned i0 = bi * tile_size_;
+      const unsigned n_i = std::min(tile_size_, ni_ - i0);
+      block.fill(T(0));
+      vil_copy_to_window(vil_crop(view, i0, n_i, 0, view.nj()), block, 0, 0);
+      if (!output_->put_block(bi, bj, block)) {
+        throw std::runtime_error("build_pyramid: failed to write a block");
+      }
+    }
+  }
+
+  unsigned ni_, nj_, nplanes_, tile_size_;
+  unsigned n_strips_, next_strip_;
+  vil_blocked_image_resource_sptr output_;
+  std::deque<strip> strips_;
+};
+
+// Level 0, read straight from the source
+template <class T>
+class source_level : public pyramid_level<T> {
+public:
+  source_level(vil_image_resource_sptr const& source, unsigned nplanes, unsigned tile_size,
+               vil_blocked_image_resource_sptr const& output)
+    : pyramid_level<T>(source->ni(), source->nj(), nplanes, tile_size, output), source_(source) {}
+
+protected:
+  vil_image_view<T> produce(unsigned j0, unsigned n) override
+  {
+    vil_image_view_base_sptr base = source_->get_copy_view(0, this->ni(), j0, n);
+    if (!base) {
+      throw std::runtime_error("build_pyramid: failed to read the source image");
+    }
+    // compound pixels (e.g. RGB) are seen as planes of their components
+    return vil_image_view<T>(*base);
+  }
+
+private:
+  vil_image_resource_sptr source_;
+};
+
+// Every later level, filtered and decimated from the one below
+template <class T>
+class reduced_level : public pyramid_level<T> {
+public:
+  reduced_level(pyramid_level<T>& below, decimation_filter const& filter, unsigned tile_size,
+                vil_blocked_image_resource_sptr const& output)
+    : pyramid_level<T>((below.ni() + 1) / 2, (below.nj() + 1) / 2, below.nplanes(), tile_size, output),
+      below_(below), filter_(filter) {}
+
+protected:
+  vil_image_view<T> produce(unsigned j0, unsigned n) override
+  {
+    const int below_nj = static_cast<int>(below_.nj());
+    const int below_ni = static_cast<int>(below_.ni());
+    const int in_j0 = std::max(0, 2 * static_cast<int>(j0) + filter_.first_offset);
+    const int in_j1 = std::min(below_nj, 2 * static_cast<int>(j0 + n - 1) + filter_.last_offset() + 1);
+    vil_image_view<T> in = below_.rows(in_j0, in_j1);
+    vil_image_view<T> out(this->ni(), n, this->nplanes());
+
+    // each task filters one tile of the strip, using only raw pointers
+    T const* in_data = in.top_left_ptr();
+    const std::ptrdiff_t in_istep = in.istep(), in_jstep = in.jstep(), in_pstep = in.planestep();
+    T* out_data = out.top_left_ptr();
+    const std::ptrdiff_t out_istep = out.istep(), out_jstep = out.jstep(), out_pstep = out.planestep();
+    const unsigned ni = this->ni(), nplanes = this->nplanes(), tile = this->tile_size();
+    const std::size_t n_tiles = (ni + tile - 1) / tile;
+    const decimation_filter& f = filter_;
+    const int n_taps = static_cast<int>(f.weights.size());
+
+    default_thread_pool()->run(n_tiles, [&](std::size_t t) {
+      const int i0 = static_cast<int>(t * tile);
+      const int i1 = static_cast<int>(std::min<std::size_t>(ni, (t + 1) * tile));
+      // input columns needed by the tile, and one row of them filtered vertically
+      const int c0 = std::max(0, 2 * i0 + f.first_offset);
+      const int c1 = std::min(below_ni, 2 * (i1 - 1) + f.last_offset() + 1);
+      std::vector<double> column_sums(c1 - c0);
+
+      for (unsigned p = 0; p < nplanes; ++p) {
+        for (unsigned r = 0; r < n; ++r) {
+          std::fill(column_sums.begin(), column_sums.end(), 0.0);
+          for (int k = 0; k < n_taps; ++k) {
+            const int y = std::min(std::max(2 * static_cast<int>(j0 + r) + f.first_offset + k, 0), below_nj - 1);
+            T const* row = in_data + (y - in_j0) * in_jstep + p * in_pstep;
+            for (int x = c0; x < c1; ++x) {
+              column_sums[x - c0] += f.weights[k] * row[x * in_istep];
+            }
+          }
+
+          T* out_row = out_data + r * out_jstep + p * out_pstep;
+          for (int i = i0; i < i1; ++i) {
+            double v = 0.0;
+            for (int k = 0; k < n_taps; ++k) {
+              const int x = std::min(std::max(2 * i + f.first_offset + k, 0), below_ni - 1);
+              v += f.weights[k] * column_sums[x - c0];
+            }
+            out_row[i * out_istep] = saturate_cast<T>(v);
+          }
+        }
+      }
+    });
+    return out;
+  }
+
+private:
+  pyramid_level<T>& below_;
+  decimation_filter filter_;
+};
+
+template <class T>
+struct build_op {
+  static void run(vil_image_resource_sptr const& source, std::string const& directory,
+                  unsigned n_levels, decimation_filter const& filter, unsigned tile_size,
+                  std::string const& file_format)
+  {
+    const unsigned nplanes = source->nplanes() * vil_pixel_format_num_components(source->pixel_format());
+    const vil_pixel_format format = vil_pixel_format_component_format(source->pixel_format());
+
+    if (n_levels == 0) {
+      unsigned size = std::max(source->ni(), source->nj());
+      for (n_levels = 1; size > tile_size; size = (size + 1) / 2) {
+        ++n_levels;
+      }
+    }
+
+    std::vector<std::unique_ptr<pyramid_level<T> > > levels;
+    unsigned ni = source->ni(), nj = source->nj();
+    for (unsigned k = 0; k < n_levels; ++k) {
+      const std::string filename = level_filename(directory, k, file_format);
+      vil_blocked_image_resource_sptr output =
+        vil_new_blocked_image_resource(filename.c_str(), ni, nj, nplanes, format,
+                                       tile_size, tile_size, file_format.c_str());
+      if (!output) {
+        throw std::runtime_error("build_pyramid: failed to create " + filename);
+      }
+      if (k == 0) {
+        levels.emplace_back(new source_level<T>(source, nplanes, tile_size, output));
+      }
+      else {
+        levels.emplace_back(new reduced_level<T>(*levels.back(), filter, tile_size, output));
+      }
+      ni = (ni + 1) / 2;
+      nj = (nj + 1) / 2;
+    }
+
+    // pulling the smallest level through pulls every level below it
+    for (auto it = levels.rbegin(); it != levels.rend(); ++it) {
+      (*it)->finish();
+    }
+  }
+};
+
+}
+
+void build_pyramid(vil_image_resource_sptr const& source, std::string const& directory,
+                   unsigned n_levels, pyramid_kernel kernel, unsigned tile_size,
+                   std::string const& file_format)
+{
+  if (!source) {
+    throw std::invalid_argument("build_pyramid: null image resource");
+  }
+  if (source->ni() == 0 || source->nj() == 0) {
+    throw std::invalid_argument("build_pyramid: empty image");
+  }
+  if (tile_size == 0 || tile_size % 16 != 0) {
+    throw std::invalid_argument("build_pyramid: tile_size must be a positive multiple of 16");
+  }
+  if (::mkdir(directory.c_str(), 0777) != 0 && errno != EEXIST) {
+    throw std::runtime_error("build_pyramid: can't create " + directory + ": " + std::strerror(errno));
+  }
+  remove_old_levels(directory);
+
+  dispatch_component_type<build_op>(source->pixel_format(), source, directory, n_levels,
+                                    make_filter(kernel), tile_size, file_format);
+}
+
+}}
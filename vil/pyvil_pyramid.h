@@ -0,0 +1,32 @@
+#ifndef pyvil_pyramid_h_included_
+#define pyvil_pyramid_h_included_
+
+#include <string>
+
+#include <vil/vil_image_resource.h>
+
+namespace pyvxl { namespace vil {
+
+//: Filter applied before each 2x decimation
+enum class pyramid_kernel {
+  box,      // mean of each 2x2 block of pixels
+  gaussian  // separable 5 tap binomial [1 4 6 4 1]/16
+};
+
+/* Write a pyramid of source into directory, one tiled file per level named
+ * level_<k>.<extension>, level 0 being a tiled copy of source and each level
+ * after it half the size of the one before (rounded up). The source is read
+ * once, top to bottom in strips of one row of tiles; every level is reduced
+ * from strips of the level below as soon as enough of them exist, so only a
+ * few strips per level are ever in memory. The tiles of each strip are
+ * filtered in parallel on the shared thread pool. n_levels of 0 adds levels
+ * until one fits in a single tile. level_* files of an earlier build in the
+ * directory are removed first. The directory can be opened with
+ * vil_load_pyramid_resource. */
+void build_pyramid(vil_image_resource_sptr const& source, std::string const& directory,
+                   unsigned n_levels, pyramid_kernel kernel, unsigned tile_size,
+                   std::string const& file_format);
+
+}}
+
+#endif
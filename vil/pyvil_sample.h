@@ -0,0 +1,200 @@
+#ifndef pyvil_sample_h_included_
+#define pyvil_sample_h_included_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vil/vil_image_view.h>
+
+#include "pyvil_parallel.h"
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+/* Gather and scatter of pixel values at lists of points. Points are (i, j)
+ * pairs in pixel coordinates, pixel centres being at whole numbers. A point
+ * is inside the image when its nearest pixel is; neighbours of interpolated
+ * points near the border are clamped to the edge. Points are split into
+ * chunks over the shared thread pool. */
+
+enum class interpolation { nearest, bilinear, bicubic };
+
+inline interpolation interpolation_from_name(std::string const& name)
+{
+  if (name == "nearest") {
+    return interpolation::nearest;
+  }
+  else if (name == "bilinear") {
+    return interpolation::bilinear;
+  }
+  else if (name == "bicubic") {
+    return interpolation::bicubic;
+  }
+  throw std::invalid_argument("Unknown interpolation <" + name + ">");
+}
+
+// Pixels and weights along one axis for interpolating at x, which must be
+// within [-0.5, n - 0.5). Returns the number of taps.
+inline unsigned interpolation_taps(double x, unsigned n, interpolation interp,
+                                   std::ptrdiff_t index[4], double weight[4])
+{
+  const std::ptrdiff_t last = static_cast<std::ptrdiff_t>(n) - 1;
+  auto clamp = [last](std::ptrdiff_t i) { return std::min(std::max(i, std::ptrdiff_t(0)), last); };
+
+  switch (interp) {
+    case interpolation::nearest:
+      index[0] = clamp(static_cast<std::ptrdiff_t>(std::floor(x + 0.5)));
+      weight[0] = 1.0;
+      return 1;
+
+    case interpolation::bilinear: {
+      const double x0 = std::floor(x);
+      const double f = x - x0;
+      index[0] = clamp(static_cast<std::ptrdiff_t>(x0));
+      index[1] = clamp(static_cast<std::ptrdiff_t>(x0) + 1);
+      weight[0] = 1.0 - f;
+      weight[1] = f;
+      return 2;
+    }
+
+    case interpolation::bicubic: {
+      // Catmull-Rom, as vil_bicub_interp
+      const double x0 = std::floor(x);
+      const double f = x - x0, f2 = f * f, f3 = f2 * f;
+      for (int k = 0; k < 4; ++k) {
+        index[k] = clamp(static_cast<std::ptrdiff_t>(x0) + k - 1);
+      }
+      weight[0] = 0.5 * (-f3 + 2.0 * f2 - f);
+      weight[1] = 0.5 * (3.0 * f3 - 5.0 * f2 + 2.0);
+      weight[2] = 0.5 * (-3.0 * f3 + 4.0 * f2 + f);
+      weight[3] = 0.5 * (f3 - f2);
+      return 4;
+    }
+  }
+  return 0;
+}
+
+inline bool point_inside(double x, double y, unsigned ni, unsigned nj)
+{
+  // written so that NaN coordinates are outside
+  return x >= -0.5 && x < ni - 0.5 && y >= -0.5 && y < nj - 0.5;
+}
+
+const std::size_t sample_chunk_size = 4096;
+
+//: Sample every plane of img at n points (x0, y0, x1, y1, ...) into
+//  out[k * nplanes + p], writing fill for points outside the image
+template <class T>
+void sample_points(vil_image_view<T> const& img, double const* points, std::size_t n,
+                   interpolation interp, double fill, double* out)
+{
+  const unsigned ni = img.ni(), nj = img.nj(), nplanes = img.nplanes();
+  T const* data = img.top_left_ptr();
+  const std::ptrdiff_t istep = img.istep(), jstep = img.jstep(), planestep = img.planestep();
+
+  const std::size_t n_chunks = (n + sample_chunk_size - 1) / sample_chunk_size;
+  default_thread_pool()->run(n_chunks, [&](std::size_t c) {
+    const std::size_t k1 = std::min(n, (c + 1) * sample_chunk_size);
+    std::ptrdiff_t ii[4], jj[4];
+    double wi[4], wj[4];
+    for (std::size_t k = c * sample_chunk_size; k < k1; ++k) {
+      const double x = points[2*k], y = points[2*k + 1];
+      double* dest = out + k * nplanes;
+      if (!point_inside(x, y, ni, nj)) {
+        std::fill(dest, dest + nplanes, fill);
+        continue;
+      }
+
+      const unsigned n_i = interpolation_taps(x, ni, interp, ii, wi);
+      const unsigned n_j = interpolation_taps(y, nj, interp, jj, wj);
+      for (unsigned p = 0; p < nplanes; ++p) {
+        T const* plane = data + p * planestep;
+        double v = 0.0;
+        for (unsigned b = 0; b < n_j; ++b) {
+          T const* row = plane + jj[b] * jstep;
+          double r = 0.0;
+          for (unsigned a = 0; a < n_i; ++a) {
+            r += wi[a] * row[ii[a] * istep];
+          }
+          v += wj[b] * r;
+        }
+        dest[p] = v;
+      }
+    }
+  });
+}
+
+enum class scatter_mode { set, add };
+
+inline scatter_mode scatter_mode_from_name(std::string const& name)
+{
+  if (name == "set") {
+    return scatter_mode::set;
+  }
+  else if (name == "add") {
+    return scatter_mode::add;
+  }
+  throw std::invalid_argument("Unknown scatter mode <" + name + ">");
+}
+
+//: Write (or add) values at the pixels nearest n points. values holds
+//  value_planes values per point, either 1 (used for every plane) or
+//  nplanes. Points outside the image are skipped. Points are bucketed by
+//  band of rows and each band is written by one task in point order, so
+//  later points win for "set" and the result never depends on threads.
+template <class T>
+void scatter_points(vil_image_view<T>& img, double const* points, std::size_t n,
+                    double const* values, unsigned value_planes, scatter_mode mode)
+{
+  const unsigned ni = img.ni(), nj = img.nj(), nplanes = img.nplanes();
+  if (n == 0 || img.size() == 0) {
+    return;
+  }
+  const unsigned band = row_band_size(ni, nj);
+  const std::size_t n_bands = num_row_bands(ni, nj);
+
+  // counting sort of the points inside the image by band, keeping order
+  std::vector<std::size_t> band_start(n_bands + 1, 0);
+  std::vector<unsigned> point_band(n, static_cast<unsigned>(n_bands));
+  for (std::size_t k = 0; k < n; ++k) {
+    if (point_inside(points[2*k], points[2*k + 1], ni, nj)) {
+      const unsigned j = static_cast<unsigned>(std::floor(points[2*k + 1] + 0.5));
+      point_band[k] = std::min(j, nj - 1) / band;
+      ++band_start[point_band[k] + 1];
+    }
+  }
+  for (std::size_t b = 0; b < n_bands; ++b) {
+    band_start[b + 1] += band_start[b];
+  }
+  std::vector<std::size_t> order(band_start[n_bands]);
+  std::vector<std::size_t> next(band_start.begin(), band_start.end() - 1);
+  for (std::size_t k = 0; k < n; ++k) {
+    if (point_band[k] < n_bands) {
+      order[next[point_band[k]]++] = k;
+    }
+  }
+
+  T* data = img.top_left_ptr();
+  const std::ptrdiff_t istep = img.istep(), jstep = img.jstep(), planestep = img.planestep();
+  default_thread_pool()->run(n_bands, [&](std::size_t b) {
+    for (std::size_t o = band_start[b]; o < band_start[b + 1]; ++o) {
+      const std::size_t k = order[o];
+      const std::ptrdiff_t i = std::min<std::ptrdiff_t>(static_cast<std::ptrdiff_t>(std::floor(points[2*k] + 0.5)), ni - 1);
+      const std::ptrdiff_t j = std::min<std::ptrdiff_t>(static_cast<std::ptrdiff_t>(std::floor(points[2*k + 1] + 0.5)), nj - 1);
+      T* pixel = data + i * istep + j * jstep;
+      for (unsigned p = 0; p < nplanes; ++p) {
+        const double v = values[k * value_planes + (value_planes == 1 ? 0 : p)];
+        T& dest = pixel[p * planestep];
+        dest = saturate_cast<T>(mode == scatter_mode::add ? dest + v : v);
+      }
+    }
+  });
+}
+
+}}
+
+#endif
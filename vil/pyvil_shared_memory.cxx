@@ -0,0 +1,207 @@
+#include "pyvil_shared_memory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vil/vil_copy.h>
+#include <vil/vil_image_view.h>
+#include <vil/vil_rgb.h>
+
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+namespace {
+
+std::runtime_error shm_error(std::string const& what, std::string const& name)
+{
+  return std::runtime_error(what + " shared memory " + name + ": " + std::strerror(errno));
+}
+
+unsigned char* map_segment(int fd, std::size_t size, std::string const& name)
+{
+  void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    throw shm_error("Failed to map", name);
+  }
+  return static_cast<unsigned char*>(addr);
+}
+
+template <class T>
+struct copy_op {
+  static void run(vil_image_view_base const& src, vil_image_view_base& dest)
+  {
+    vil_image_view<T> s(src), d(dest);
+    vil_copy_to_window(s, d, 0, 0);
+  }
+};
+
+template <class T>
+struct state_op {
+  static bool run(vil_image_view_base const& view, shared_view_state& state)
+  {
+    vil_image_view<T> v(view);
+    shared_memory_chunk* chunk = dynamic_cast<shared_memory_chunk*>(v.memory_chunk().ptr());
+    if (!chunk) {
+      return false;
+    }
+    state.name = chunk->owner().name();
+    state.offset = reinterpret_cast<unsigned char const*>(v.top_left_ptr()) - chunk->owner().data();
+    state.ni = v.ni();
+    state.nj = v.nj();
+    state.nplanes = v.nplanes();
+    state.istep = v.istep();
+    state.jstep = v.jstep();
+    state.planestep = v.planestep();
+    return true;
+  }
+};
+
+template <class T>
+struct open_op {
+  static vil_image_view_base_sptr run(shared_view_state const& s)
+  {
+    std::shared_ptr<shared_memory_segment> segment = shared_memory_segment::open(s.name);
+
+    // the first and last bytes the view reaches must lie within the segment
+    std::ptrdiff_t lo = 0, hi = 0;
+    const std::ptrdiff_t steps[3] = {s.istep, s.jstep, s.planestep};
+    const unsigned sizes[3] = {s.ni, s.nj, s.nplanes};
+    for (int d = 0; d < 3; ++d) {
+      if (sizes[d] == 0) {
+        lo = hi = 0;
+        break;
+      }
+      const std::ptrdiff_t reach = steps[d] * std::ptrdiff_t(sizes[d] - 1);
+      (reach < 0 ? lo : hi) += reach;
+    }
+    const std::ptrdiff_t first = std::ptrdiff_t(s.offset) + lo * std::ptrdiff_t(sizeof(T));
+    const std::ptrdiff_t last = std::ptrdiff_t(s.offset) + (hi + 1) * std::ptrdiff_t(sizeof(T));
+    if (s.offset > segment->size() || first < 0 || last > std::ptrdiff_t(segment->size())) {
+      throw std::invalid_argument("The view doesn't fit in shared memory " + s.name);
+    }
+
+    vil_memory_chunk_sptr chunk = new shared_memory_chunk(segment, vil_pixel_format_of(T()));
+    T* top_left = reinterpret_cast<T*>(segment->data() + s.offset);
+    return new vil_image_view<T>(chunk, top_left, s.ni, s.nj, s.nplanes, s.istep, s.jstep, s.planestep);
+  }
+};
+
+}
+
+shared_memory_segment::shared_memory_segment(std::string const& name, unsigned char* data,
+                                             std::size_t size, bool owner, bool persist)
+  : name_(name), data_(data), size_(size), owner_pid_(owner ? ::getpid() : 0), linked_(owner),
+    persist_(persist)
+{
+}
+
+std::shared_ptr<shared_memory_segment> shared_memory_segment::create(std::size_t size, bool persist)
+{
+  static std::atomic<unsigned> counter(0);
+  for (int attempt = 0; attempt < 100; ++attempt) {
+    // short, as some systems limit names to 31 characters
+    char name[32];
+    std::snprintf(name, sizeof(name), "/pyvxl.%x.%x", unsigned(::getpid()), counter++);
+    int fd = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+      if (errno == EEXIST) {
+        continue;
+      }
+      throw shm_error("Failed to create", name);
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      const int err = errno;
+      ::close(fd);
+      ::shm_unlink(name);
+      errno = err;
+      throw shm_error("Failed to size", name);
+    }
+    unsigned char* data;
+    try {
+      data = map_segment(fd, size, name);
+    }
+    catch (...) {
+      ::shm_unlink(name);
+      throw;
+    }
+    return std::shared_ptr<shared_memory_segment>(new shared_memory_segment(name, data, size, true, persist));
+  }
+  throw std::runtime_error("Failed to find a free shared memory name");
+}
+
+std::shared_ptr<shared_memory_segment> shared_memory_segment::open(std::string const& name)
+{
+  int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    throw shm_error("Failed to open", name);
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    throw shm_error("Failed to size", name);
+  }
+  const std::size_t size = static_cast<std::size_t>(st.st_size);
+  unsigned char* data = map_segment(fd, size, name);
+  return std::shared_ptr<shared_memory_segment>(new shared_memory_segment(name, data, size, false, false));
+}
+
+shared_memory_segment::~shared_memory_segment()
+{
+  ::munmap(data_, size_);
+  if (owner_pid_ == ::getpid() && !persist_) {
+    unlink();
+  }
+}
+
+void shared_memory_segment::unlink()
+{
+  if (linked_ || owner_pid_ != ::getpid()) {
+    // another process may have unlinked it already, which is fine
+    ::shm_unlink(name_.c_str());
+  }
+  linked_ = false;
+}
+
+vil_image_view_base_sptr new_shared_view(unsigned ni, unsigned nj, unsigned nplanes, vil_pixel_format format,
+                                         bool persist)
+{
+  const std::size_t bytes = std::max<std::size_t>(pixel_format_sizeof(format) * ni * nj * nplanes, 1);
+  vil_memory_chunk_sptr chunk = new shared_memory_chunk(shared_memory_segment::create(bytes, persist), format);
+  return new_chunk_view(chunk, ni, nj, nplanes, format);
+}
+
+vil_image_view_base_sptr shared_copy(vil_image_view_base const& view, bool persist)
+{
+  vil_image_view_base_sptr result = new_shared_view(view.ni(), view.nj(), view.nplanes(), view.pixel_format(),
+                                                    persist);
+  dispatch_component_type<copy_op>(view.pixel_format(), view, *result);
+  return result;
+}
+
+shared_memory_chunk* shared_chunk_of(vil_image_view_base const& view)
+{
+  return dynamic_cast<shared_memory_chunk*>(memory_chunk_of(view));
+}
+
+bool shared_view_state_of(vil_image_view_base const& view, shared_view_state& state)
+{
+  return dispatch_pixel_type<state_op>(view.pixel_format(), view, state);
+}
+
+vil_image_view_base_sptr open_shared_view(shared_view_state const& state, vil_pixel_format format)
+{
+  return dispatch_pixel_type<open_op>(format, state);
+}
+
+}}
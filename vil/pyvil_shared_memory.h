@@ -0,0 +1,92 @@
+#ifndef pyvil_shared_memory_h_included_
+#define pyvil_shared_memory_h_included_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <sys/types.h>
+
+#include <vil/vil_image_view_base.h>
+#include <vil/vil_memory_chunk.h>
+#include <vil/vil_pixel_format.h>
+
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+/* Image views in POSIX shared memory, so other processes can map the same
+ * pixels by name instead of being sent a copy. The process creating a
+ * segment owns its name, which is unlinked when the last view of it in that
+ * process goes, or earlier through unlink(). A persistent segment keeps its
+ * name until unlink(), for views pickled after the creator's views have
+ * gone. Processes which opened it keep their mapping until their own views
+ * go, whatever happens to the name. */
+
+class shared_memory_segment {
+public:
+  //: A new zero filled segment of size bytes, under a name of its own.
+  //  A persistent segment's name is only removed by unlink().
+  static std::shared_ptr<shared_memory_segment> create(std::size_t size, bool persist = false);
+
+  //: Map the existing segment called name
+  static std::shared_ptr<shared_memory_segment> open(std::string const& name);
+
+  ~shared_memory_segment();
+
+  shared_memory_segment(shared_memory_segment const&) = delete;
+  shared_memory_segment& operator=(shared_memory_segment const&) = delete;
+
+  //: Remove the name, so nothing else can open the segment. Mappings,
+  //  here and in other processes, stay valid.
+  void unlink();
+
+  unsigned char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  std::string const& name() const { return name_; }
+
+private:
+  shared_memory_segment(std::string const& name, unsigned char* data, std::size_t size, bool owner,
+                        bool persist);
+
+  std::string name_;
+  unsigned char* data_;
+  std::size_t size_;
+  // only the creating process unlinks, not children forked from it
+  pid_t owner_pid_;
+  bool linked_;
+  bool persist_;
+};
+
+//: The memory of views over a shared memory segment
+typedef external_memory_chunk<shared_memory_segment> shared_memory_chunk;
+
+//: Where a view's pixels sit in a shared memory segment, steps in pixels
+struct shared_view_state {
+  std::string name;
+  std::size_t offset;  // bytes from the start of the segment to pixel (0,0,0)
+  unsigned ni, nj, nplanes;
+  std::ptrdiff_t istep, jstep, planestep;
+};
+
+//: A new zero filled view in shared memory, laid out as vil_image_view,
+//  in a persistent segment if persist
+vil_image_view_base_sptr new_shared_view(unsigned ni, unsigned nj, unsigned nplanes, vil_pixel_format format,
+                                         bool persist = false);
+
+//: A copy of view in shared memory, in a persistent segment if persist
+vil_image_view_base_sptr shared_copy(vil_image_view_base const& view, bool persist = false);
+
+//: The segment of view, or null if its pixels aren't in shared memory
+shared_memory_chunk* shared_chunk_of(vil_image_view_base const& view);
+
+//: The state of a view in shared memory, false for any other view
+bool shared_view_state_of(vil_image_view_base const& view, shared_view_state& state);
+
+//: Open the view state describes, of pixel format, checking it lies
+//  within the segment
+vil_image_view_base_sptr open_shared_view(shared_view_state const& state, vil_pixel_format format);
+
+}}
+
+#endif
@@ -0,0 +1,102 @@
+#include "pyvil_stats.h"
+
+#include "pyvil_block_iterator.h"
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+namespace {
+
+// The pixels of view at image positions which are multiples of step, given
+// that view starts at (i0, j0) in the image. Shares the memory of view.
+template <class T>
+vil_image_view<T> subsample(vil_image_view<T> const& view, unsigned i0, unsigned j0, unsigned step)
+{
+  const unsigned oi = (step - i0 % step) % step, oj = (step - j0 % step) % step;
+  if (oi >= view.ni() || oj >= view.nj()) {
+    return vil_image_view<T>();
+  }
+  return vil_image_view<T>(view.memory_chunk(), view.top_left_ptr() + oi*view.istep() + oj*view.jstep(),
+                           (view.ni() - oi + step - 1) / step, (view.nj() - oj + step - 1) / step,
+                           view.nplanes(), view.istep() * step, view.jstep() * step, view.planestep());
+}
+
+template <class T>
+struct resource_stats_op {
+  static std::vector<plane_stats> run(vil_image_resource_sptr const& resource,
+                                      std::vector<unsigned> const& planes,
+                                      vil_image_resource_sptr const& mask,
+                                      histogram_bins const& bins,
+                                      unsigned block_ni, unsigned block_nj,
+                                      unsigned sample_step)
+  {
+    const unsigned n_planes = resource->nplanes() *
+                              vil_pixel_format_num_components(resource->pixel_format());
+    for (unsigned p : planes) {
+      if (p >= n_planes) {
+        throw std::out_of_range("image_stats: plane index out of range");
+      }
+    }
+    std::vector<plane_stats> result(planes.empty() ? n_planes : planes.size(), plane_stats(bins));
+
+    // the next blocks are decoded in the background while one is reduced
+    image_block_iterator blocks(resource, block_ni, block_nj, 0, 2);
+    image_block_iterator::block b;
+    while (blocks.next(b)) {
+      vil_image_view<T> tile(*b.view);
+      vil_image_view<unsigned char> mask_tile;
+      if (mask) {
+        vil_image_view_base_sptr base = mask->get_copy_view(b.i0, tile.ni(), b.j0, tile.nj());
+        if (!base) {
+          throw std::runtime_error("image_stats: failed to read the mask");
+        }
+        mask_tile = *base;
+      }
+
+      if (sample_step > 1) {
+        tile = subsample(tile, b.i0, b.j0, sample_step);
+        if (mask) {
+          mask_tile = subsample(mask_tile, b.i0, b.j0, sample_step);
+        }
+        if (tile.size() == 0) {
+          continue;
+        }
+      }
+
+      std::vector<plane_stats> partial = image_stats(tile, planes, mask ? &mask_tile : nullptr, bins);
+      for (std::size_t k = 0; k < result.size(); ++k) {
+        result[k].merge(partial[k]);
+      }
+    }
+    return result;
+  }
+};
+
+}
+
+std::vector<plane_stats> resource_stats(vil_image_resource_sptr const& resource,
+                                        std::vector<unsigned> const& planes,
+                                        vil_image_resource_sptr const& mask,
+                                        histogram_bins const& bins,
+                                        unsigned block_ni, unsigned block_nj,
+                                        unsigned sample_step)
+{
+  if (!resource) {
+    throw std::invalid_argument("image_stats: null image resource");
+  }
+  if (mask) {
+    if (mask->ni() != resource->ni() || mask->nj() != resource->nj()) {
+      throw std::invalid_argument("image_stats: mask doesn't match the image size");
+    }
+    if (mask->pixel_format() != VIL_PIXEL_FORMAT_BYTE) {
+      throw std::invalid_argument("image_stats: mask must be a byte image");
+    }
+  }
+  if (sample_step == 0) {
+    throw std::invalid_argument("image_stats: sample_step must be at least 1");
+  }
+  return dispatch_component_type<resource_stats_op>(resource->pixel_format(), resource, planes,
+                                                    mask, bins, block_ni, block_nj, sample_step);
+}
+
+}}
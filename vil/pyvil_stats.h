@@ -0,0 +1,284 @@
+#ifndef pyvil_stats_h_included_
+#define pyvil_stats_h_included_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <vil/vil_image_resource.h>
+#include <vil/vil_image_view.h>
+
+#include "pyvil_parallel.h"
+
+namespace pyvxl { namespace vil {
+
+/* One-pass image statistics. Count, sum, sum of squares, min, max and an
+ * optional histogram of every requested plane are accumulated together, so
+ * each pixel is read once, over bands of rows on the shared thread pool.
+ * Pixels outside a mask (where it is 0) and NaN pixels are skipped. Partial
+ * results are merged in band order, so the results don't depend on the
+ * number of threads. The variance comes from the squared deviations of
+ * each row chunk from its own first pixel, merged by the pairwise formula
+ * of Chan, Golub and LeVeque, rather than from sum_sq, which would cancel
+ * catastrophically when the spread is small next to the mean. */
+
+//: n_bins equal bins spanning [min, max], the last bin including max.
+//  n_bins 0 means no histogram.
+struct histogram_bins {
+  unsigned n_bins;
+  double min, max;
+
+  histogram_bins(unsigned n = 0, double lo = 0.0, double hi = 0.0)
+    : n_bins(n), min(lo), max(hi) {}
+};
+
+struct plane_stats {
+  std::uint64_t count;
+  double sum, sum_sq;
+  double m2;  // sum of squared deviations from the mean
+  double min, max;  // inf and -inf while count is 0
+  histogram_bins bins;
+  std::vector<std::uint64_t> histogram;
+
+  explicit plane_stats(histogram_bins const& b = histogram_bins())
+    : count(0), sum(0.0), sum_sq(0.0), m2(0.0),
+      min(std::numeric_limits<double>::infinity()),
+      max(-std::numeric_limits<double>::infinity()),
+      bins(b), histogram(b.n_bins, 0) {}
+
+  double mean() const
+  {
+    return count ? sum / count : std::numeric_limits<double>::quiet_NaN();
+  }
+
+  //: Population variance
+  double variance() const
+  {
+    return count ? m2 / count : std::numeric_limits<double>::quiet_NaN();
+  }
+
+  //: Add n values with sums s and s_sq, and squared deviations d2 from
+  //  their own mean
+  void add_moments(std::uint64_t n, double s, double s_sq, double d2)
+  {
+    if (n == 0) {
+      return;
+    }
+    if (count) {
+      const double delta = s / n - sum / count;
+      m2 += d2 + delta * delta * (static_cast<double>(count) * n / static_cast<double>(count + n));
+    }
+    else {
+      m2 = d2;
+    }
+    count += n;
+    sum += s;
+    sum_sq += s_sq;
+  }
+
+  //: Value below which pct percent of the histogrammed pixels fall,
+  //  assuming values are spread evenly within each bin
+  double percentile(double pct) const
+  {
+    if (histogram.empty()) {
+      throw std::runtime_error("plane_stats: percentile needs a histogram");
+    }
+    std::uint64_t total = 0;
+    for (auto n : histogram) {
+      total += n;
+    }
+    if (total == 0) {
+      return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    const double target = std::min(std::max(pct, 0.0), 100.0) / 100.0 * total;
+    const double width = (bins.max - bins.min) / bins.n_bins;
+    double below = 0.0;
+    for (std::size_t b = 0; b < histogram.size(); ++b) {
+      if (histogram[b] > 0 && below + histogram[b] >= target) {
+        const double v = bins.min + (b + (target - below) / histogram[b]) * width;
+        return std::min(std::max(v, min), max);
+      }
+      below += histogram[b];
+    }
+    return max;
+  }
+
+  void merge(plane_stats const& other)
+  {
+    add_moments(other.count, other.sum, other.sum_sq, other.m2);
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    for (std::size_t b = 0; b < histogram.size(); ++b) {
+      histogram[b] += other.histogram[b];
+    }
+  }
+};
+
+// Small integers are summed exactly in 64 bits within a row chunk, which
+// also lets the compiler vectorise the contiguous loop
+template <class T> struct stats_sum_type { typedef double type; };
+template <> struct stats_sum_type<unsigned char> { typedef std::int64_t type; };
+template <> struct stats_sum_type<signed char> { typedef std::int64_t type; };
+template <> struct stats_sum_type<unsigned short int> { typedef std::int64_t type; };
+template <> struct stats_sum_type<short int> { typedef std::int64_t type; };
+
+template <class T>
+inline bool stats_is_nan(T v) { return v != v; }
+template <> inline bool stats_is_nan(unsigned char) { return false; }
+template <> inline bool stats_is_nan(signed char) { return false; }
+template <> inline bool stats_is_nan(unsigned short int) { return false; }
+template <> inline bool stats_is_nan(short int) { return false; }
+template <> inline bool stats_is_nan(unsigned int) { return false; }
+template <> inline bool stats_is_nan(int) { return false; }
+
+// Add n pixels of one row to s. mask is null or has one entry per pixel.
+template <class T>
+void accumulate_row(T const* row, std::ptrdiff_t istep,
+                    unsigned char const* mask, std::ptrdiff_t mask_step,
+                    unsigned n, plane_stats& s)
+{
+  typedef typename stats_sum_type<T>::type sum_t;
+  // keeps 64 bit sums of squares of 16 bit values from overflowing
+  const unsigned chunk = 1u << 16;
+
+  for (unsigned c0 = 0; c0 < n; c0 += std::min(chunk, n - c0)) {
+    const unsigned c1 = c0 + std::min(chunk, n - c0);
+    // d and d_sq are the sums of v - k and its square, k being the chunk's
+    // first pixel, which keeps the squares small next to those of v
+    sum_t sum = 0, sum_sq = 0, d = 0, d_sq = 0, k = 0;
+    std::uint64_t count = 0;
+    T lo = std::numeric_limits<T>::max(), hi = std::numeric_limits<T>::lowest();
+
+    if (!mask && istep == 1 && !std::numeric_limits<T>::has_quiet_NaN) {
+      k = row[c0];
+      for (unsigned i = c0; i < c1; ++i) {
+        const T t = row[i];
+        const sum_t v = t;
+        sum += v;
+        sum_sq += v * v;
+        d += v - k;
+        d_sq += (v - k) * (v - k);
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+      }
+      count = c1 - c0;
+    }
+    else {
+      for (unsigned i = c0; i < c1; ++i) {
+        const T t = row[i*istep];
+        if ((mask && !mask[i*mask_step]) || stats_is_nan(t)) {
+          continue;
+        }
+        const sum_t v = t;
+        if (count == 0) {
+          k = v;
+        }
+        sum += v;
+        sum_sq += v * v;
+        d += v - k;
+        d_sq += (v - k) * (v - k);
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+        ++count;
+      }
+    }
+
+    if (count) {
+      const double dd = static_cast<double>(d);
+      s.add_moments(count, static_cast<double>(sum), static_cast<double>(sum_sq),
+                    std::max(0.0, static_cast<double>(d_sq) - dd * dd / count));
+      s.min = std::min(s.min, static_cast<double>(lo));
+      s.max = std::max(s.max, static_cast<double>(hi));
+    }
+  }
+
+  const unsigned n_bins = s.bins.n_bins;
+  if (n_bins) {
+    const double lo = s.bins.min, hi = s.bins.max;
+    const double scale = hi > lo ? n_bins / (hi - lo) : 0.0;
+    for (unsigned i = 0; i < n; ++i) {
+      const T t = row[i*istep];
+      if ((mask && !mask[i*mask_step]) || stats_is_nan(t)) {
+        continue;
+      }
+      const double v = t;
+      if (v < lo || v > hi) {
+        continue;
+      }
+      const unsigned b = static_cast<unsigned>((v - lo) * scale);
+      ++s.histogram[std::min(b, n_bins - 1)];
+    }
+  }
+}
+
+//: Statistics of the given planes of view (all of them when planes is
+//  empty). mask is null, or a byte image of the same size with either one
+//  plane or one plane per plane of view.
+template <class T>
+std::vector<plane_stats> image_stats(vil_image_view<T> const& view,
+                                     std::vector<unsigned> planes,
+                                     vil_image_view<unsigned char> const* mask,
+                                     histogram_bins const& bins)
+{
+  if (planes.empty()) {
+    for (unsigned p = 0; p < view.nplanes(); ++p) {
+      planes.push_back(p);
+    }
+  }
+  for (unsigned p : planes) {
+    if (p >= view.nplanes()) {
+      throw std::out_of_range("image_stats: plane index out of range");
+    }
+  }
+  if (mask && (mask->ni() != view.ni() || mask->nj() != view.nj() ||
+               (mask->nplanes() != 1 && mask->nplanes() != view.nplanes()))) {
+    throw std::invalid_argument("image_stats: mask doesn't match the image size");
+  }
+
+  using stats = std::vector<plane_stats>;
+  return parallel_reduce_rows(view.ni(), view.nj(), stats(planes.size(), plane_stats(bins)),
+    [&](unsigned j0, unsigned j1) {
+      stats partial(planes.size(), plane_stats(bins));
+      for (std::size_t k = 0; k < planes.size(); ++k) {
+        const unsigned p = planes[k];
+        for (unsigned j = j0; j < j1; ++j) {
+          unsigned char const* mask_row = nullptr;
+          std::ptrdiff_t mask_step = 0;
+          if (mask) {
+            mask_row = &(*mask)(0, j, mask->nplanes() == 1 ? 0 : p);
+            mask_step = mask->istep();
+          }
+          accumulate_row(&view(0, j, p), view.istep(), mask_row, mask_step, view.ni(), partial[k]);
+        }
+      }
+      return partial;
+    },
+    [](stats const& a, stats const& b) {
+      stats merged = a;
+      for (std::size_t k = 0; k < merged.size(); ++k) {
+        merged[k].merge(b[k]);
+      }
+      return merged;
+    });
+}
+
+//: Statistics of a whole resource, read block by block so the full image
+//  is never in memory. mask is null or a byte resource of the same size.
+//  Compound pixels (e.g. RGB) are treated as planes of their components.
+//  With sample_step s > 1 only pixels (i, j) with i and j multiples of s
+//  are counted.
+std::vector<plane_stats> resource_stats(vil_image_resource_sptr const& resource,
+                                        std::vector<unsigned> const& planes,
+                                        vil_image_resource_sptr const& mask,
+                                        histogram_bins const& bins,
+                                        unsigned block_ni, unsigned block_nj,
+                                        unsigned sample_step = 1);
+
+}}
+
+#endif
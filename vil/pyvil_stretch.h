@@ -0,0 +1,218 @@
+#ifndef pyvil_stretch_h_included_
+#define pyvil_stretch_h_included_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <vil/vil_image_view.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace pyvxl { namespace vil {
+
+/* Fused linear stretch of an image of type srcT into an image of type destT.
+ * Each pixel is read once, mapped to scale*(v - min_limit), clamped to the
+ * output range and written straight to the destination, so there is no
+ * intermediate float image. Contiguous rows are processed with SSE2 or AVX2
+ * (whichever the module was compiled for), everything else falls back to
+ * the scalar loop. */
+
+// Output range of the stretch for each destination type
+template <class destT> struct stretch_traits;
+
+template <> struct stretch_traits<unsigned char> {
+  static constexpr float scale = 255.0f;
+  static constexpr float max_value = 255.0f;
+};
+
+// The stretch maps the input range onto [0,65536], but 65536 itself is not
+// representable, so the top of the range saturates instead of wrapping to 0
+template <> struct stretch_traits<unsigned short int> {
+  static constexpr float scale = 65536.0f;
+  static constexpr float max_value = 65535.0f;
+};
+
+template <> struct stretch_traits<float> {
+  static constexpr float scale = 1.0f;
+  static constexpr float max_value = 1.0f;
+};
+
+
+namespace simd {
+
+#if defined(__AVX2__)
+
+inline __m256 load8(unsigned char const* p) {
+  return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(p))));
+}
+inline __m256 load8(unsigned short int const* p) {
+  return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p))));
+}
+inline __m256 load8(int const* p) {
+  return _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(p)));
+}
+inline __m256 load8(float const* p) {
+  return _mm256_loadu_ps(p);
+}
+
+// values are already clamped to the output range, so truncation matches a static_cast
+inline void store8(unsigned char* p, __m256 v) {
+  __m256i i = _mm256_cvttps_epi32(v);
+  __m128i w = _mm_packs_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(w, w));
+}
+inline void store8(unsigned short int* p, __m256 v) {
+  __m256i i = _mm256_cvttps_epi32(v);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(p),
+                   _mm_packus_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1)));
+}
+inline void store8(float* p, __m256 v) {
+  _mm256_storeu_ps(p, v);
+}
+
+#elif defined(__SSE2__)
+
+inline void load8(unsigned char const* p, __m128& lo, __m128& hi) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i w = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(p)), zero);
+  lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(w, zero));
+  hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(w, zero));
+}
+inline void load8(unsigned short int const* p, __m128& lo, __m128& hi) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i w = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+  lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(w, zero));
+  hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(w, zero));
+}
+inline void load8(int const* p, __m128& lo, __m128& hi) {
+  lo = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p)));
+  hi = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p + 4)));
+}
+inline void load8(float const* p, __m128& lo, __m128& hi) {
+  lo = _mm_loadu_ps(p);
+  hi = _mm_loadu_ps(p + 4);
+}
+
+// values are already clamped to the output range, so truncation matches a static_cast
+inline void store8(unsigned char* p, __m128 lo, __m128 hi) {
+  __m128i w = _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(w, w));
+}
+inline void store8(unsigned short int* p, __m128 lo, __m128 hi) {
+  // SSE2 has no unsigned 32->16 pack, so bias into the signed range and back
+  const __m128i bias32 = _mm_set1_epi32(32768);
+  const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+  __m128i w = _mm_packs_epi32(_mm_sub_epi32(_mm_cvttps_epi32(lo), bias32),
+                              _mm_sub_epi32(_mm_cvttps_epi32(hi), bias32));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_xor_si128(w, bias16));
+}
+inline void store8(float* p, __m128 lo, __m128 hi) {
+  _mm_storeu_ps(p, lo);
+  _mm_storeu_ps(p + 4, hi);
+}
+
+#endif
+
+} // namespace simd
+
+
+// Stretch n pixels of one row. src and dest are contiguous when their steps are 1.
+template <class srcT, class destT>
+void stretch_row(srcT const* src, std::ptrdiff_t src_step,
+                 destT* dest, std::ptrdiff_t dest_step,
+                 unsigned n, float min_limit, float scale)
+{
+  const float max_value = stretch_traits<destT>::max_value;
+  unsigned i = 0;
+
+  if (src_step == 1 && dest_step == 1) {
+#if defined(__AVX2__)
+    const __m256 vmin = _mm256_set1_ps(min_limit);
+    const __m256 vscale = _mm256_set1_ps(scale);
+    const __m256 vzero = _mm256_setzero_ps();
+    const __m256 vmax = _mm256_set1_ps(max_value);
+    for (; i + 8 <= n; i += 8) {
+      __m256 v = _mm256_mul_ps(vscale, _mm256_sub_ps(simd::load8(src + i), vmin));
+      v = _mm256_min_ps(_mm256_max_ps(v, vzero), vmax);
+      simd::store8(dest + i, v);
+    }
+#elif defined(__SSE2__)
+    const __m128 vmin = _mm_set1_ps(min_limit);
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 vzero = _mm_setzero_ps();
+    const __m128 vmax = _mm_set1_ps(max_value);
+    for (; i + 8 <= n; i += 8) {
+      __m128 lo, hi;
+      simd::load8(src + i, lo, hi);
+      lo = _mm_mul_ps(vscale, _mm_sub_ps(lo, vmin));
+      hi = _mm_mul_ps(vscale, _mm_sub_ps(hi, vmin));
+      lo = _mm_min_ps(_mm_max_ps(lo, vzero), vmax);
+      hi = _mm_min_ps(_mm_max_ps(hi, vzero), vmax);
+      simd::store8(dest + i, lo, hi);
+    }
+#endif
+  }
+
+  for (; i < n; ++i) {
+    float v = scale * (static_cast<float>(src[i*src_step]) - min_limit);
+    // written so that NaN maps to 0, the same as the vector max
+    v = v > 0.0f ? v : 0.0f;
+    v = std::min(v, max_value);
+    dest[i*dest_step] = static_cast<destT>(v);
+  }
+}
+
+// Stretch rows [j0, j1) of plane p of src into dest, which must already
+// be allocated with the same size
+template <class srcT, class destT>
+void stretch_plane_rows(vil_image_view<srcT> const& src, vil_image_view<destT>& dest,
+                        unsigned p, unsigned j0, unsigned j1, float min_limit, float max_limit)
+{
+  const float scale = stretch_traits<destT>::scale / (max_limit - min_limit);
+  for (unsigned j = j0; j < j1; ++j) {
+    stretch_row(&src(0, j, p), src.istep(), &dest(0, j, p), dest.istep(),
+                src.ni(), min_limit, scale);
+  }
+}
+
+// Stretch rows [j0, j1) of every plane of src into dest
+template <class srcT, class destT>
+void stretch_rows(vil_image_view<srcT> const& src, vil_image_view<destT>& dest,
+                  unsigned j0, unsigned j1, float min_limit, float max_limit)
+{
+  for (unsigned p = 0; p < src.nplanes(); ++p) {
+    stretch_plane_rows(src, dest, p, j0, j1, min_limit, max_limit);
+  }
+}
+
+// As above with limits for each plane, or a single pair for all of them
+template <class srcT, class destT>
+void stretch_rows(vil_image_view<srcT> const& src, vil_image_view<destT>& dest,
+                  unsigned j0, unsigned j1,
+                  std::vector<float> const& min_limits, std::vector<float> const& max_limits)
+{
+  for (unsigned p = 0; p < src.nplanes(); ++p) {
+    const std::size_t k = min_limits.size() == 1 ? 0 : p;
+    stretch_plane_rows(src, dest, p, j0, j1, min_limits[k], max_limits[k]);
+  }
+}
+
+template <class destT, class srcT>
+vil_image_view<destT> stretch_image(vil_image_view<srcT> const& src,
+                                    float min_limit, float max_limit)
+{
+  vil_image_view<destT> dest(src.ni(), src.nj(), src.nplanes());
+  if (src.size() > 0) {
+    stretch_rows(src, dest, 0, src.nj(), min_limit, max_limit);
+  }
+  return dest;
+}
+
+}}
+
+#endif
@@ -0,0 +1,81 @@
+#include "pyvil_tile_resource.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <vil/vil_image_view.h>
+#include <vil/vil_property.h>
+
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+tile_image_resource::tile_image_resource(unsigned ni, unsigned nj, unsigned nplanes, vil_pixel_format format,
+                                         unsigned block_ni, unsigned block_nj, std::string const& file_format)
+  : ni_(ni), nj_(nj), nplanes_(nplanes), format_(format),
+    block_ni_(block_ni), block_nj_(block_nj), file_format_(file_format)
+{
+  if (format == VIL_PIXEL_FORMAT_UNKNOWN) {
+    throw std::invalid_argument("tile_image_resource: unknown pixel format");
+  }
+  if ((block_ni == 0) != (block_nj == 0)) {
+    throw std::invalid_argument("tile_image_resource: give both block_ni and block_nj, or neither");
+  }
+}
+
+vil_image_view_base_sptr tile_image_resource::get_view(unsigned i0, unsigned n_i,
+                                                       unsigned j0, unsigned n_j) const
+{
+  if (n_i == 0 || n_j == 0 || std::size_t(i0) + n_i > ni() || std::size_t(j0) + n_j > nj()) {
+    return nullptr;
+  }
+  std::vector<vil_image_view_base_sptr> tiles = read_tiles(std::vector<image_window>(1, image_window{i0, n_i, j0, n_j}));
+  return tiles.size() == 1 ? tiles[0] : nullptr;
+}
+
+namespace {
+
+template <class T>
+struct deep_copy_op {
+  static vil_image_view_base_sptr run(vil_image_view_base const& view)
+  {
+    vil_image_view<T>* copy = new vil_image_view<T>;
+    copy->deep_copy(vil_image_view<T>(view));
+    return copy;
+  }
+};
+
+}
+
+vil_image_view_base_sptr tile_image_resource::get_copy_view(unsigned i0, unsigned n_i,
+                                                            unsigned j0, unsigned n_j) const
+{
+  // the tile may be the source's own memory, e.g. a numpy array
+  vil_image_view_base_sptr view = get_view(i0, n_i, j0, n_j);
+  if (!view) {
+    return view;
+  }
+  return dispatch_component_type<deep_copy_op>(view->pixel_format(), *view);
+}
+
+bool tile_image_resource::get_property(char const* tag, void* property_value) const
+{
+  if (block_ni_ == 0) {
+    return false;
+  }
+  if (std::strcmp(tag, vil_property_size_block_i) == 0) {
+    if (property_value) {
+      *static_cast<unsigned*>(property_value) = block_ni_;
+    }
+    return true;
+  }
+  if (std::strcmp(tag, vil_property_size_block_j) == 0) {
+    if (property_value) {
+      *static_cast<unsigned*>(property_value) = block_nj_;
+    }
+    return true;
+  }
+  return false;
+}
+
+}}
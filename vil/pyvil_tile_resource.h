@@ -0,0 +1,68 @@
+#ifndef pyvil_tile_resource_h_included_
+#define pyvil_tile_resource_h_included_
+
+#include <string>
+#include <vector>
+
+#include <vil/vil_image_resource.h>
+#include <vil/vil_image_view_base.h>
+#include <vil/vil_pixel_format.h>
+#include <vil/vil_smart_ptr.h>
+
+#include "pyvil_window_reader.h"
+
+namespace pyvxl { namespace vil {
+
+/* An image resource for sources which fetch pixels best in bulk, such as a
+ * tile server. Its size, pixel format and tiling are fixed when it is made,
+ * so asking for them is an ordinary function call, and the only way to its
+ * pixels is read_tiles, which fetches any number of windows at once.
+ * read_windows (and so get_views) asks for the blocks it needs in a few
+ * large calls; get_view asks for one window and returns the view read_tiles
+ * gave, which may share memory with the source, while get_copy_view copies
+ * it. Read only. */
+class tile_image_resource : public vil_image_resource {
+public:
+  //: block_ni/block_nj give the tiling of the source, 0 when it has none
+  tile_image_resource(unsigned ni, unsigned nj, unsigned nplanes, vil_pixel_format format,
+                      unsigned block_ni, unsigned block_nj, std::string const& file_format);
+
+  unsigned nplanes() const override { return nplanes_; }
+  unsigned ni() const override { return ni_; }
+  unsigned nj() const override { return nj_; }
+  enum vil_pixel_format pixel_format() const override { return format_; }
+
+  vil_image_view_base_sptr get_view(unsigned i0, unsigned n_i,
+                                    unsigned j0, unsigned n_j) const override;
+  using vil_image_resource::get_view;
+  vil_image_view_base_sptr get_copy_view(unsigned i0, unsigned n_i,
+                                         unsigned j0, unsigned n_j) const override;
+  using vil_image_resource::get_copy_view;
+
+  //: Read only
+  bool put_view(vil_image_view_base const&, unsigned, unsigned) override { return false; }
+  using vil_image_resource::put_view;
+
+  char const* file_format() const override { return file_format_.c_str(); }
+  //: The tiling, as vil_property_size_block_i/j
+  bool get_property(char const* tag, void* property_value = nullptr) const override;
+
+  unsigned block_ni() const { return block_ni_; }
+  unsigned block_nj() const { return block_nj_; }
+
+  //: A view of each of windows, of its size, with the component format of
+  //  the image and one plane per component of its pixels
+  virtual std::vector<vil_image_view_base_sptr> read_tiles(std::vector<image_window> const& windows) const = 0;
+
+private:
+  unsigned ni_, nj_, nplanes_;
+  vil_pixel_format format_;
+  unsigned block_ni_, block_nj_;
+  std::string file_format_;
+};
+
+typedef vil_smart_ptr<tile_image_resource> tile_image_resource_sptr;
+
+}}
+
+#endif
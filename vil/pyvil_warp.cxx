@@ -0,0 +1,267 @@
+#include "pyvil_warp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <vil/vil_blocked_image_resource.h>
+#include <vil/vil_copy.h>
+#include <vil/vil_crop.h>
+#include <vil/vil_image_view.h>
+
+#include "pyvil_parallel.h"
+#include "pyvil_pixel_types.h"
+
+namespace pyvxl { namespace vil {
+
+namespace {
+
+// Source pixels read past the positions of a tile on each side, enough for
+// the taps of every interpolation
+const int warp_margin = 3;
+
+struct source_window {
+  unsigned i0, ni, j0, nj;
+  bool empty() const { return ni == 0 || nj == 0; }
+};
+
+// Last node used for pixels up to and including i
+inline unsigned last_node(unsigned i, unsigned step, unsigned n_nodes)
+{
+  return std::min((i + step - 1) / step, n_nodes - 1);
+}
+
+// Cell of the grid pixel i is interpolated in
+inline unsigned cell_of(unsigned i, unsigned step, unsigned n_nodes)
+{
+  return std::min(i / step, n_nodes > 1 ? n_nodes - 2 : 0);
+}
+
+//: The window of source the destination pixels [i0, i1) x [j0, j1) read
+source_window tile_window(warp_grid const& grid, unsigned i0, unsigned i1, unsigned j0, unsigned j1,
+                          unsigned src_ni, unsigned src_nj)
+{
+  double min_i = std::numeric_limits<double>::infinity(), max_i = -min_i;
+  double min_j = min_i, max_j = -min_i;
+  auto include = [&](double const* n) {
+    if (std::isfinite(n[0]) && std::isfinite(n[1])) {
+      min_i = std::min(min_i, n[0]);
+      max_i = std::max(max_i, n[0]);
+      min_j = std::min(min_j, n[1]);
+      max_j = std::max(max_j, n[1]);
+    }
+  };
+  // positions between nodes are blends of the nodes, so lie within their range
+  const std::size_t cell_points = std::size_t(grid.step + 1) * (grid.step + 1);
+  for (unsigned gj = j0 / grid.step; gj <= last_node(j1 - 1, grid.step, grid.nj); ++gj) {
+    for (unsigned gi = i0 / grid.step; gi <= last_node(i1 - 1, grid.step, grid.ni); ++gi) {
+      include(grid.node(gi, gj));
+    }
+  }
+  // apart from cells known exactly, which may lie anywhere
+  if (!grid.exact_cells.empty()) {
+    for (unsigned gj = cell_of(j0, grid.step, grid.nj); gj <= cell_of(j1 - 1, grid.step, grid.nj); ++gj) {
+      for (unsigned gi = cell_of(i0, grid.step, grid.ni); gi <= cell_of(i1 - 1, grid.step, grid.ni); ++gi) {
+        if (double const* cell = grid.exact_cell(gi, gj)) {
+          for (std::size_t k = 0; k < cell_points; ++k) {
+            include(cell + 2 * k);
+          }
+        }
+      }
+    }
+  }
+
+  source_window w{0, 0, 0, 0};
+  if (!(min_i <= max_i)) {
+    return w;
+  }
+  auto range = [](double lo, double hi, unsigned n, unsigned& start, unsigned& size) {
+    const double first = std::max(std::floor(lo) - warp_margin, 0.0);
+    const double last = std::min(std::floor(hi) + warp_margin + 1, double(n));
+    start = first < last ? static_cast<unsigned>(first) : 0;
+    size = first < last ? static_cast<unsigned>(last - first) : 0;
+  };
+  range(min_i, max_i, src_ni, w.i0, w.ni);
+  range(min_j, max_j, src_nj, w.j0, w.nj);
+  return w;
+}
+
+//: Source positions (xs, ys) of destination pixels [i0, i1) of row j
+void row_positions(warp_grid const& grid, unsigned i0, unsigned i1, unsigned j,
+                   std::vector<double>& xs, std::vector<double>& ys)
+{
+  const unsigned step = grid.step;
+  const unsigned gj = cell_of(j, step, grid.nj);
+  const double fj = grid.nj > 1 ? double(j) / step - gj : 0.0;
+  const unsigned gj1 = std::min(gj + 1, grid.nj - 1);
+
+  for (unsigned i = i0; i < i1; ++i) {
+    const unsigned gi = cell_of(i, step, grid.ni);
+    const double fi = grid.ni > 1 ? double(i) / step - gi : 0.0;
+    const unsigned gi1 = std::min(gi + 1, grid.ni - 1);
+    const unsigned di = i - gi * step, dj = j - gj * step;
+    if (double const* cell = grid.exact_cell(gi, gj)) {
+      double const* p = cell + 2 * (std::size_t(dj) * (step + 1) + di);
+      xs[i - i0] = p[0];
+      ys[i - i0] = p[1];
+      continue;
+    }
+    double const* n00 = grid.node(gi, gj);
+    double const* n10 = grid.node(gi1, gj);
+    double const* n01 = grid.node(gi, gj1);
+    double const* n11 = grid.node(gi1, gj1);
+    for (int c = 0; c < 2; ++c) {
+      const double top = n00[c] + fi * (n10[c] - n00[c]);
+      const double bottom = n01[c] + fi * (n11[c] - n01[c]);
+      (c == 0 ? xs : ys)[i - i0] = top + fj * (bottom - top);
+    }
+  }
+}
+
+template <class T>
+struct warp_op {
+  static void run(vil_image_resource_sptr const& source, warp_grid const& grid, interpolation interp,
+                  double fill, vil_image_resource_sptr const& output, unsigned tile_size)
+  {
+    const unsigned src_ni = source->ni(), src_nj = source->nj();
+    const unsigned ni = output->ni(), nj = output->nj(), nplanes = output->nplanes();
+    const std::size_t n_tiles = (ni + tile_size - 1) / tile_size;
+    const T fill_value = saturate_cast<T>(fill);
+
+    vil_blocked_image_resource_sptr blocked = blocked_image_resource(output);
+    if (blocked && (blocked->size_block_i() != tile_size || blocked->size_block_j() != tile_size)) {
+      blocked = nullptr;
+    }
+
+    for (unsigned j0 = 0; j0 < nj; j0 += tile_size) {
+      const unsigned strip_nj = std::min(tile_size, nj - j0);
+
+      // read what every tile of the strip needs, on this thread
+      std::vector<source_window> windows(n_tiles);
+      std::vector<vil_image_view<T> > inputs(n_tiles);
+      for (std::size_t t = 0; t < n_tiles; ++t) {
+        const unsigned i0 = static_cast<unsigned>(t * tile_size);
+        windows[t] = tile_window(grid, i0, std::min(ni, i0 + tile_size), j0, j0 + strip_nj, src_ni, src_nj);
+        if (!windows[t].empty()) {
+          vil_image_view_base_sptr base =
+            source->get_copy_view(windows[t].i0, windows[t].ni, windows[t].j0, windows[t].nj);
+          if (!base) {
+            throw std::runtime_error("warp: failed to read the source image");
+          }
+          // compound pixels (e.g. RGB) are seen as planes of their components
+          inputs[t] = vil_image_view<T>(*base);
+        }
+      }
+
+      vil_image_view<T> strip(ni, strip_nj, nplanes);
+      T* out_data = strip.top_left_ptr();
+      const std::ptrdiff_t out_istep = strip.istep(), out_jstep = strip.jstep(), out_pstep = strip.planestep();
+
+      default_thread_pool()->run(n_tiles, [&](std::size_t t) {
+        const unsigned i0 = static_cast<unsigned>(t * tile_size);
+        const unsigned i1 = std::min(ni, i0 + tile_size);
+        source_window const& w = windows[t];
+        T const* in_data = inputs[t].top_left_ptr();
+        const std::ptrdiff_t in_istep = inputs[t].istep(), in_jstep = inputs[t].jstep(),
+                             in_pstep = inputs[t].planestep();
+        std::vector<double> xs(i1 - i0), ys(i1 - i0);
+        std::ptrdiff_t ii[4], jj[4];
+        double wi[4], wj[4];
+
+        for (unsigned r = 0; r < strip_nj; ++r) {
+          row_positions(grid, i0, i1, j0 + r, xs, ys);
+          T* out_row = out_data + r * out_jstep;
+          for (unsigned i = i0; i < i1; ++i) {
+            const double x = xs[i - i0], y = ys[i - i0];
+            T* dest = out_row + i * out_istep;
+            if (w.empty() || !point_inside(x, y, src_ni, src_nj)) {
+              for (unsigned p = 0; p < nplanes; ++p) {
+                dest[p * out_pstep] = fill_value;
+              }
+              continue;
+            }
+
+            // taps are clamped to the source, which the window holds around x, y
+            const unsigned n_i = interpolation_taps(x, src_ni, interp, ii, wi);
+            const unsigned n_j = interpolation_taps(y, src_nj, interp, jj, wj);
+            for (unsigned p = 0; p < nplanes; ++p) {
+              T const* plane = in_data + p * in_pstep;
+              double v = 0.0;
+              for (unsigned b = 0; b < n_j; ++b) {
+                T const* row = plane + (jj[b] - w.j0) * in_jstep;
+                double s = 0.0;
+                for (unsigned a = 0; a < n_i; ++a) {
+                  s += wi[a] * row[(ii[a] - w.i0) * in_istep];
+                }
+                v += wj[b] * s;
+              }
+              dest[p * out_pstep] = saturate_cast<T>(v);
+            }
+          }
+        }
+      });
+
+      write_strip(output, blocked, strip, j0, tile_size);
+    }
+  }
+
+  static void write_strip(vil_image_resource_sptr const& output, vil_blocked_image_resource_sptr const& blocked,
+                          vil_image_view<T> const& strip, unsigned j0, unsigned tile_size)
+  {
+    if (!blocked) {
+      if (!output->put_view(strip, 0, j0)) {
+        throw std::runtime_error("warp: failed to write the output image");
+      }
+      return;
+    }
+    // blocks are always written whole, edge blocks padded with zeros
+    vil_image_view<T> block(tile_size, tile_size, strip.nplanes());
+    for (unsigned bi = 0; bi * tile_size < strip.ni(); ++bi) {
+      const unsigned i0 = bi * tile_size;
+      block.fill(T(0));
+      vil_copy_to_window(vil_crop(strip, i0, std::min(tile_size, strip.ni() - i0), 0, strip.nj()), block, 0, 0);
+      if (!blocked->put_block(bi, j0 / tile_size, block)) {
+        throw std::runtime_error("warp: failed to write a block");
+      }
+    }
+  }
+};
+
+}
+
+void warp_resource(vil_image_resource_sptr const& source, warp_grid const& grid,
+                   interpolation interp, double fill, vil_image_resource_sptr const& output,
+                   unsigned tile_size)
+{
+  if (!source || !output) {
+    throw std::invalid_argument("warp: null image resource");
+  }
+  if (tile_size == 0) {
+    throw std::invalid_argument("warp: tile_size must be positive");
+  }
+  const vil_pixel_format format = source->pixel_format();
+  if (output->pixel_format() != vil_pixel_format_component_format(format) ||
+      output->nplanes() != source->nplanes() * vil_pixel_format_num_components(format)) {
+    throw std::invalid_argument("warp: output must have the component format and planes of the source");
+  }
+  if (grid.step == 0 || grid.ni == 0 || grid.nj == 0 ||
+      !grid.coords ||
+      std::size_t(grid.ni - 1) * grid.step + 1 < output->ni() ||
+      std::size_t(grid.nj - 1) * grid.step + 1 < output->nj()) {
+    throw std::invalid_argument("warp: the grid doesn't cover the output image");
+  }
+  for (auto const& cell : grid.exact_cells) {
+    if (!cell.second || cell.first % grid.ni + 1 >= grid.ni || cell.first / grid.ni + 1 >= grid.nj) {
+      throw std::invalid_argument("warp: exact cell outside the grid");
+    }
+  }
+  if (output->ni() == 0 || output->nj() == 0) {
+    return;
+  }
+
+  dispatch_component_type<warp_op>(format, source, grid, interp, fill, output, tile_size);
+}
+
+}}
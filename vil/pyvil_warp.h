@@ -0,0 +1,59 @@
+#ifndef pyvil_warp_h_included_
+#define pyvil_warp_h_included_
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include <vil/vil_image_resource.h>
+
+#include "pyvil_sample.h"
+
+namespace pyvxl { namespace vil {
+
+/* Source positions of the pixels of a warped image, known at every step-th
+ * pixel along i and j and bilinearly interpolated in between. Node (gi, gj)
+ * is destination pixel (gi * step, gj * step) and holds the (i, j) position
+ * of that pixel in the source, NaN where the mapping has no answer. The
+ * last row and column of nodes may lie past the end of the image. Cells
+ * whose nodes are only partly NaN can't be interpolated across, so such
+ * cells may be given the exact position of each of their pixels instead.
+ * Both are borrowed, and must outlive the grid. */
+struct warp_grid {
+  unsigned ni, nj;    // number of nodes along i and j
+  unsigned step;
+  double const* coords;  // (i, j) of each node, node (gi, gj) at 2 * (gj * ni + gi)
+  // cell (gi, gj) between nodes gi, gi + 1 and gj, gj + 1, keyed by
+  // gj * ni + gi, with pixel (gi * step + di, gj * step + dj) at
+  // 2 * (dj * (step + 1) + di) for di, dj in [0, step]
+  std::unordered_map<std::size_t, double const*> exact_cells;
+
+  double const* node(unsigned gi, unsigned gj) const { return &coords[2 * (std::size_t(gj) * ni + gi)]; }
+
+  //: The exact positions of cell (gi, gj), or null where it is interpolated
+  double const* exact_cell(unsigned gi, unsigned gj) const
+  {
+    if (exact_cells.empty()) {
+      return nullptr;
+    }
+    auto it = exact_cells.find(std::size_t(gj) * ni + gi);
+    return it == exact_cells.end() ? nullptr : it->second;
+  }
+};
+
+/* Resample source into output, pixel (i, j) of output taking the value of
+ * source at grid's position for it, and fill where that falls outside the
+ * source. Compound pixels are warped as planes of their components, so
+ * output has the component format of source and a plane per component. Output is made in strips of one row of
+ * tile_size tiles. For each tile the window of source it needs is read
+ * from the grid nodes around it, then the tiles of a strip are resampled
+ * in parallel and the strip is written to output before the next is read,
+ * so neither image is ever wholly in memory. A blocked output with
+ * tile_size blocks gets whole blocks. */
+void warp_resource(vil_image_resource_sptr const& source, warp_grid const& grid,
+                   interpolation interp, double fill, vil_image_resource_sptr const& output,
+                   unsigned tile_size);
+
+}}
+
+#endif
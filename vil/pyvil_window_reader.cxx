@@ -0,0 +1,257 @@
+#include "pyvil_window_reader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include <vil/vil_image_view.h>
+
+#include "pyvil_block_iterator.h"
+#include "pyvil_concurrent_resource.h"
+#include "pyvil_parallel.h"
+#include "pyvil_pixel_types.h"
+#include "pyvil_tile_resource.h"
+
+namespace pyvxl { namespace vil {
+
+namespace {
+
+// Pixel bytes of the tiles fetched by each read_tiles call, at most
+const std::size_t tile_batch_bytes = std::size_t(64) << 20;
+
+// A window of the image decoded in one read, and the windows within it
+struct read_region {
+  image_window area;
+  std::vector<std::size_t> windows;
+};
+
+void check_windows(vil_image_resource const& resource, std::vector<image_window> const& windows)
+{
+  for (std::size_t k = 0; k < windows.size(); ++k) {
+    image_window const& w = windows[k];
+    if (w.ni == 0 || w.nj == 0 ||
+        std::size_t(w.i0) + w.ni > resource.ni() || std::size_t(w.j0) + w.nj > resource.nj()) {
+      throw std::out_of_range("get_views: window " + std::to_string(k) + " is not within the image");
+    }
+  }
+}
+
+// The native blocks the windows touch, in raster order
+std::vector<read_region> plan_blocks(vil_image_resource const& resource, std::vector<image_window> const& windows,
+                                     unsigned block_ni, unsigned block_nj)
+{
+  // keyed by (bj, bi)
+  std::map<std::uint64_t, std::vector<std::size_t> > blocks;
+  for (std::size_t k = 0; k < windows.size(); ++k) {
+    image_window const& w = windows[k];
+    for (unsigned bj = w.j0 / block_nj; bj <= (w.j0 + w.nj - 1) / block_nj; ++bj) {
+      for (unsigned bi = w.i0 / block_ni; bi <= (w.i0 + w.ni - 1) / block_ni; ++bi) {
+        blocks[(std::uint64_t(bj) << 32) | bi].push_back(k);
+      }
+    }
+  }
+
+  std::vector<read_region> regions;
+  regions.reserve(blocks.size());
+  for (auto& block : blocks) {
+    const unsigned i0 = static_cast<unsigned>(block.first & 0xffffffffu) * block_ni;
+    const unsigned j0 = static_cast<unsigned>(block.first >> 32) * block_nj;
+    regions.push_back(read_region{image_window{i0, std::min(block_ni, resource.ni() - i0),
+                                               j0, std::min(block_nj, resource.nj() - j0)},
+                                  std::move(block.second)});
+  }
+  return regions;
+}
+
+std::uint64_t area_of(image_window const& w)
+{
+  return std::uint64_t(w.ni) * w.nj;
+}
+
+image_window bounding_window(image_window const& a, image_window const& b)
+{
+  const unsigned i0 = std::min(a.i0, b.i0), j0 = std::min(a.j0, b.j0);
+  return image_window{i0, std::max(a.i0 + a.ni, b.i0 + b.ni) - i0,
+                      j0, std::max(a.j0 + a.nj, b.j0 + b.nj) - j0};
+}
+
+// Without native blocks each window is read on its own, except that
+// windows are read together when their bounding box has no more pixels
+// than reading them separately, e.g. when they overlap heavily
+std::vector<read_region> plan_windows(std::vector<image_window> const& windows)
+{
+  std::vector<read_region> regions;
+  regions.reserve(windows.size());
+  for (std::size_t k = 0; k < windows.size(); ++k) {
+    regions.push_back(read_region{windows[k], {k}});
+  }
+
+  // a grown region may now join one before it, so repeat until stable
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    std::sort(regions.begin(), regions.end(), [](read_region const& a, read_region const& b) {
+      return a.area.j0 < b.area.j0;
+    });
+    for (std::size_t a = 0; a < regions.size(); ++a) {
+      // regions whose rows don't meet a's never pay off
+      for (std::size_t b = a + 1; b < regions.size() &&
+           regions[b].area.j0 <= regions[a].area.j0 + regions[a].area.nj; ) {
+        const image_window both = bounding_window(regions[a].area, regions[b].area);
+        if (area_of(both) > area_of(regions[a].area) + area_of(regions[b].area)) {
+          ++b;
+          continue;
+        }
+        regions[a].area = both;
+        regions[a].windows.insert(regions[a].windows.end(),
+                                  regions[b].windows.begin(), regions[b].windows.end());
+        regions.erase(regions.begin() + b);
+        merged = true;
+        b = a + 1;
+      }
+    }
+  }
+  return regions;
+}
+
+std::vector<read_region> plan_reads(vil_image_resource const& resource, std::vector<image_window> const& windows)
+{
+  check_windows(resource, windows);
+  unsigned block_ni, block_nj;
+  if (native_block_size(resource, block_ni, block_nj)) {
+    return plan_blocks(resource, windows, block_ni, block_nj);
+  }
+  return plan_windows(windows);
+}
+
+//: Where the pixels of a window go
+template <class T>
+struct window_memory {
+  T* top_left;
+  std::ptrdiff_t istep, jstep, planestep;
+};
+
+template <class T>
+struct read_windows_op {
+  static void run(vil_image_resource const& resource, std::vector<image_window> const& windows,
+                  std::vector<vil_image_view_base_sptr> const& dest)
+  {
+    if (dest.size() != windows.size()) {
+      throw std::invalid_argument("get_views: one view is needed per window");
+    }
+    const unsigned nplanes = resource.nplanes() * vil_pixel_format_num_components(resource.pixel_format());
+
+    // raw pointers, so the workers never touch the reference counts of dest
+    std::vector<window_memory<T> > out(windows.size());
+    for (std::size_t k = 0; k < windows.size(); ++k) {
+      vil_image_view<T> d = dest[k] ? vil_image_view<T>(*dest[k]) : vil_image_view<T>();
+      if (d.ni() != windows[k].ni || d.nj() != windows[k].nj || d.nplanes() != nplanes) {
+        throw std::invalid_argument("get_views: view " + std::to_string(k) + " doesn't fit its window");
+      }
+      out[k] = window_memory<T>{d.top_left_ptr(), d.istep(), d.jstep(), d.planestep()};
+    }
+
+    const std::vector<read_region> regions = plan_reads(resource, windows);
+
+    auto copy_region = [&](read_region const& region, vil_image_view_base_sptr const& base) {
+      image_window const& rw = region.area;
+      // compound pixels (e.g. RGB) are seen as planes of their components
+      vil_image_view<T> src = base ? vil_image_view<T>(*base) : vil_image_view<T>();
+      if (src.ni() != rw.ni || src.nj() != rw.nj || src.nplanes() != nplanes) {
+        throw std::runtime_error("get_views: failed to read the image");
+      }
+
+      for (std::size_t k : region.windows) {
+        image_window const& w = windows[k];
+        window_memory<T> const& m = out[k];
+        const unsigned ci0 = std::max(w.i0, rw.i0), ci1 = std::min(w.i0 + w.ni, rw.i0 + rw.ni);
+        const unsigned cj0 = std::max(w.j0, rw.j0), cj1 = std::min(w.j0 + w.nj, rw.j0 + rw.nj);
+        for (unsigned p = 0; p < nplanes; ++p) {
+          for (unsigned j = cj0; j < cj1; ++j) {
+            T* row = m.top_left + p * m.planestep + std::ptrdiff_t(j - w.j0) * m.jstep;
+            for (unsigned i = ci0; i < ci1; ++i) {
+              row[std::ptrdiff_t(i - w.i0) * m.istep] = src(i - rw.i0, j - rw.j0, p);
+            }
+          }
+        }
+      }
+    };
+
+    // sources which fetch in bulk get the blocks a batch at a time
+    if (tile_image_resource const* tiles = dynamic_cast<tile_image_resource const*>(&resource)) {
+      const std::size_t pixel_bytes = std::size_t(nplanes) * sizeof(T);
+      std::size_t first = 0;
+      while (first < regions.size()) {
+        std::vector<image_window> batch;
+        std::size_t batch_bytes = 0;
+        for (std::size_t b = first; b < regions.size() && (batch.empty() || batch_bytes < tile_batch_bytes); ++b) {
+          batch.push_back(regions[b].area);
+          batch_bytes += area_of(regions[b].area) * pixel_bytes;
+        }
+        std::vector<vil_image_view_base_sptr> views = tiles->read_tiles(batch);
+        if (views.size() != batch.size()) {
+          throw std::runtime_error("get_views: read_tiles returned the wrong number of tiles");
+        }
+        for (std::size_t b = 0; b < batch.size(); ++b) {
+          copy_region(regions[first + b], views[b]);
+        }
+        first += batch.size();
+      }
+      return;
+    }
+
+    auto decode = [&](std::size_t r) {
+      image_window const& rw = regions[r].area;
+      copy_region(regions[r], resource.get_view(rw.i0, rw.ni, rw.j0, rw.nj));
+    };
+
+    if (reads_concurrently(resource)) {
+      default_thread_pool()->run(regions.size(), decode);
+    }
+    else {
+      for (std::size_t r = 0; r < regions.size(); ++r) {
+        decode(r);
+      }
+    }
+  }
+};
+
+template <class T>
+struct new_windows_op {
+  static std::vector<vil_image_view_base_sptr> run(std::vector<image_window> const& windows, unsigned nplanes)
+  {
+    std::vector<vil_image_view_base_sptr> views;
+    views.reserve(windows.size());
+    for (image_window const& w : windows) {
+      views.push_back(new vil_image_view<T>(w.ni, w.nj, nplanes));
+    }
+    return views;
+  }
+};
+
+}
+
+void read_windows(vil_image_resource const& resource, std::vector<image_window> const& windows,
+                  std::vector<vil_image_view_base_sptr> const& dest)
+{
+  dispatch_component_type<read_windows_op>(resource.pixel_format(), resource, windows, dest);
+}
+
+std::vector<vil_image_view_base_sptr> read_windows(vil_image_resource const& resource,
+                                                   std::vector<image_window> const& windows)
+{
+  const unsigned nplanes = resource.nplanes() * vil_pixel_format_num_components(resource.pixel_format());
+  std::vector<vil_image_view_base_sptr> views = dispatch_component_type<new_windows_op>(
+    vil_pixel_format_component_format(resource.pixel_format()), windows, nplanes);
+  read_windows(resource, windows, views);
+  return views;
+}
+
+std::size_t n_window_blocks(vil_image_resource const& resource, std::vector<image_window> const& windows)
+{
+  return plan_reads(resource, windows).size();
+}
+
+}}
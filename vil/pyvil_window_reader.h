@@ -0,0 +1,40 @@
+#ifndef pyvil_window_reader_h_included_
+#define pyvil_window_reader_h_included_
+
+#include <cstddef>
+#include <vector>
+
+#include <vil/vil_image_resource.h>
+#include <vil/vil_image_view_base.h>
+
+namespace pyvxl { namespace vil {
+
+/* Reads many windows of one resource at once, e.g. chips around detections.
+ * The reads are planned up front: a tiled resource decodes each native block
+ * the windows touch only once, however many windows overlap it, and copies
+ * it into every one of them. Other resources read each window directly,
+ * except that windows are read together when their bounding box has no more
+ * pixels than the windows themselves. Reads run in parallel when the
+ * resource can be read from several threads at once, otherwise one after
+ * another; a tile_image_resource is asked for its blocks in batches of
+ * read_tiles calls. */
+struct image_window {
+  unsigned i0, ni, j0, nj;
+};
+
+//: Read windows[k] into dest[k], which must be of its size, with the
+//  component format of resource and one plane per component of its pixels.
+//  Throws std::out_of_range for a window outside the image.
+void read_windows(vil_image_resource const& resource, std::vector<image_window> const& windows,
+                  std::vector<vil_image_view_base_sptr> const& dest);
+
+//: New views of each window, compound pixels read as planes of their components
+std::vector<vil_image_view_base_sptr> read_windows(vil_image_resource const& resource,
+                                                   std::vector<image_window> const& windows);
+
+//: Number of blocks or windows read_windows decodes for windows
+std::size_t n_window_blocks(vil_image_resource const& resource, std::vector<image_window> const& windows);
+
+}}
+
+#endif
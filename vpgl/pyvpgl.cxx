@@ -16,6 +16,7 @@
 #include <vgl/vgl_vector_2d.h>
 #include <vgl/vgl_homg_point_2d.h>
 #include <vgl/vgl_homg_point_3d.h>
+#include <vgl/vgl_ray_3d.h>
 
 #include <vpgl/file_formats/vpgl_geo_camera.h>
 #include <vpgl/file_formats/vpgl_nitf_rational_camera.h>
@@ -35,6 +36,8 @@
 #include <vector>
 #include <array>
 #include <cmath>
+#include <limits>
+#include <stdexcept>
 namespace py = pybind11;
 
 namespace pyvxl {
@@ -432,6 +435,68 @@ std::unique_ptr<vpgl_geo_camera> create_geocam_with_lvcs(vnl_matrix<double> cons
   return geocam;
 }
 
+/* Maps pixels of the image of dst_camera to pixels of the image of
+ * src_camera, through the plane z = elevation in world coordinates (those
+ * both cameras project from, e.g. longitude and latitude for geo and
+ * rational cameras). Used as the mapping of vxl.vil.warp, so takes and
+ * returns N x 2 arrays of (u, v), NaN where there is no answer. */
+class camera_mapping {
+public:
+  camera_mapping(vpgl_camera<double> const& src_camera, vpgl_camera<double> const& dst_camera,
+                 double elevation)
+    : src_(src_camera), geo_(dynamic_cast<vpgl_geo_camera const*>(&dst_camera)),
+      affine_(dynamic_cast<vpgl_affine_camera<double> const*>(&dst_camera)), elevation_(elevation)
+  {
+    if (!geo_ && !affine_) {
+      throw std::invalid_argument("camera_mapping: dst_camera must be a geo_camera or an affine_camera");
+    }
+  }
+
+  py::array_t<double> operator()(py::array_t<double, py::array::c_style | py::array::forcecast> const& points) const
+  {
+    if (points.ndim() != 2 || points.shape(1) != 2) {
+      throw std::invalid_argument("camera_mapping: points must be an N x 2 array of (u, v)");
+    }
+    const size_t n = points.shape(0);
+    py::array_t<double> out(std::vector<py::ssize_t>{static_cast<py::ssize_t>(n), 2});
+    double const* in_data = points.data();
+    double* out_data = out.mutable_data();
+
+    // the GIL is kept, src_camera may be a Python subclass
+    for (size_t k = 0; k < n; ++k) {
+      double x, y, z = elevation_;
+      if (!world_point(in_data[2*k], in_data[2*k + 1], x, y)) {
+        out_data[2*k] = out_data[2*k + 1] = std::numeric_limits<double>::quiet_NaN();
+        continue;
+      }
+      src_.project(x, y, z, out_data[2*k], out_data[2*k + 1]);
+    }
+    return out;
+  }
+
+private:
+  bool world_point(double u, double v, double& x, double& y) const
+  {
+    if (geo_) {
+      geo_->img_to_global(u, v, x, y);
+      return true;
+    }
+    vgl_ray_3d<double> ray = affine_->backproject_ray(vgl_homg_point_2d<double>(u, v));
+    if (ray.direction().z() == 0.0) {
+      return false;
+    }
+    const double t = (elevation_ - ray.origin().z()) / ray.direction().z();
+    x = ray.origin().x() + t * ray.direction().x();
+    y = ray.origin().y() + t * ray.direction().y();
+    return true;
+  }
+
+  vpgl_camera<double> const& src_;
+  vpgl_geo_camera const* geo_;
+  vpgl_affine_camera<double> const* affine_;
+  double elevation_;
+};
+
 void wrap_vpgl(py::module &m)
 {
 
@@ -826,6 +891,14 @@ void wrap_vpgl(py::module &m)
   );
 
 
+  py::class_<camera_mapping>(m, "camera_mapping")
+    .def(py::init<vpgl_camera<double> const&, vpgl_camera<double> const&, double>(),
+         py::arg("src_camera"), py::arg("dst_camera"), py::arg("elevation") = 0.0,
+         py::keep_alive<1, 2>(), py::keep_alive<1, 3>())
+    .def("__call__", &camera_mapping::operator(), py::arg("points"),
+         "Pixels (u, v) of src_camera seen at an N x 2 array of pixels (u, v) of dst_camera");
+
+
   // =====MISC=====
 
   // image cropping extents from 3D box and rational camera